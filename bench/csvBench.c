@@ -0,0 +1,353 @@
+/*************************************************************************************
+ *   -------------------------------------------                                     *
+ *   csv to markdown text converter (csv2mdText)                                     *
+ *   -------------------------------------------                                     *
+ *   Copyright 2023 Roberto Mameli                                                   *
+ *                                                                                   *
+ *   Licensed under the Apache License, Version 2.0 (the "License");                 *
+ *   you may not use this file except in compliance with the License.                *
+ *   You may obtain a copy of the License at                                         *
+ *                                                                                   *
+ *       http://www.apache.org/licenses/LICENSE-2.0                                  *
+ *                                                                                   *
+ *   Unless required by applicable law or agreed to in writing, software             *
+ *   distributed under the License is distributed on an "AS IS" BASIS,               *
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.        *
+ *   See the License for the specific language governing permissions and             *
+ *   limitations under the License.                                                  *
+ *   -----------------------------------------------------------------------------   *
+ *                                                                                   *
+ *   FILE:        csvBench source file                                               *
+ *   VERSION:     1.0.0                                                              *
+ *   AUTHOR(S):   Roberto Mameli                                                     *
+ *   PRODUCT:     csv2mdText tool (benchmark suite)                                  *
+ *   DESCRIPTION: Benchmark harness: it generates a set of synthetic CSV files with  *
+ *                csvGen, converts each of them with csv2mdText and reports rows/s,  *
+ *                MB/s, CPU time and peak memory (RSS) of the conversion             *
+ *   REV HISTORY: See updated Revision History in file Changelog.md                  *
+ *                                                                                   *
+ *************************************************************************************/
+
+
+/**********************
+ * Linux system files *
+ **********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+
+/*************
+ * Constants *
+ *************/
+#define MAXPATHLEN      4096    /* Maximum length for file names                             */
+#define MAXARGS           64    /* Maximum number of arguments of a command                  */
+#define DEFROWS       200000    /* Default number of rows of each scenario                   */
+#define DEFREPEAT          3    /* Default number of conversions per scenario (best is kept) */
+#define DEFTOOL      "./bin/csv2mdText"
+#define DEFGEN       "./bin/csvGen"
+#define DEFDIR       "/tmp"
+
+
+/********************
+ * Type Definitions *
+ ********************/
+typedef struct
+{
+    char   *name;           /* Name of the scenario                                       */
+    int     columns;        /* csvGen options (see csvGen -h)                             */
+    int     fieldLen;
+    int     quoted;
+    int     multiLine;
+    int     comments;
+    long    groupSize;
+    bool    chapters;       /* If true, a chapter template on column 1 is used (-c)       */
+    char   *toolArgs;       /* Additional csv2mdText options (may be NULL)                */
+} benchScenario;
+
+typedef struct
+{
+    double  wall;           /* Elapsed time (seconds)                                     */
+    double  user;           /* CPU time in user mode (seconds)                            */
+    double  sys;            /* CPU time in kernel mode (seconds)                          */
+    long    maxRss;         /* Peak resident set size (KB)                                */
+} benchResult;
+
+
+/********************
+ * Global Variables *
+ ********************/
+static benchScenario scenarios[] =
+{
+    /* name           cols  len  quoted  multi  comm  group  chapters  toolArgs */
+    { "plain",           8,  16,      0,     0,    0,     0,  false,    NULL    },
+    { "quoted-20%",      8,  16,     20,     0,    0,     0,  false,    NULL    },
+    { "multiline-5%",    8,  16,      0,     5,    0,     0,  false,    NULL    },
+    { "comments-10%",    8,  16,      0,     0,   10,     0,  false,    NULL    },
+    { "wide-100cols",  100,   8,      0,     0,    0,     0,  false,    NULL    },
+    { "long-fields",     4, 512,      5,     1,    0,     0,  false,    NULL    },
+    { "chapters-100",    8,  16,      0,     0,    0,   100,  true,     NULL    },
+    { "chapters-1",      8,  16,      0,     0,    0,     1,  true,     NULL    },
+    { "mixed-j4",        8,  16,     10,     2,    5,    50,  true,     "-j 4"  },
+    { "plain-rfc4180",   8,  16,      0,     0,    0,     0,  false, "--rfc4180" },
+    { "quoted-rfc4180",  8,  16,     20,     0,    0,     0,  false, "--rfc4180" },
+    { "multi-rfc4180",   8,  16,      0,     5,    0,     0,  false, "--rfc4180" },
+};
+
+
+/**********************
+ * Internal Functions *
+ **********************/
+/*********************************************/
+/* Print out the command format (short form) */
+/*********************************************/
+static void printUsage (void)
+{
+    printf ("Usage:\n\n");
+    printf ("    csvBench [-b <csv2mdText>] [-g <csvGen>] [-d <work_dir>] [-r <rows>]\n");
+    printf ("             [-x <repetitions>] [-f <scenario>]\n");
+    printf ("\n");
+    printf ("    Defaults: %s, %s, %s, %d rows, %d repetitions, all scenarios.\n",DEFTOOL,DEFGEN,DEFDIR,DEFROWS,DEFREPEAT);
+    printf ("\n");
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Return the current time (seconds, monotonic clock)                                    */
+/*****************************************************************************************/
+static double now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC,&ts);
+    return (ts.tv_sec + ts.tv_nsec/1e9);
+}
+
+
+/*****************************************************************************************/
+/* Run a command (argv[0] is the executable) with stdout redirected to the given file    */
+/* (or to /dev/null). It returns false if the command fails; res is filled with elapsed  */
+/* time, CPU time and peak memory of the command                                         */
+/*****************************************************************************************/
+static bool runCommand (char *argv[], char *stdoutFile, benchResult *res)
+{
+    /* Local Variables */
+    pid_t           pid;
+    int             status;
+    struct rusage   ru;
+    double          start;
+
+    fflush (stdout);
+    start = now();
+    if ( (pid=fork())<0 )
+        return (false);
+    if (pid==0)
+    {
+        if (freopen((stdoutFile!=NULL) ? stdoutFile : "/dev/null","w",stdout)==NULL)
+            _exit (127);
+        execv (argv[0],argv);
+        _exit (127);
+    }
+    if (wait4(pid,&status,0,&ru)<0)
+        return (false);
+
+    res->wall = now() - start;
+    res->user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec/1e6;
+    res->sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec/1e6;
+    res->maxRss = ru.ru_maxrss;
+
+    return ( WIFEXITED(status) && (WEXITSTATUS(status)==0) );
+}
+
+
+/*****************************************************************************************/
+/* Split a string of options (e.g. "-j 4") and append them to argv                       */
+/*****************************************************************************************/
+static int appendArgs (char *argv[], int argNo, char *args, char *storage)
+{
+    /* Local Variables */
+    char   *p;
+
+    if (args==NULL)
+        return (argNo);
+    strcpy (storage,args);
+    for (p=strtok(storage," "); (p!=NULL) && (argNo<MAXARGS-1); p=strtok(NULL," "))
+        argv[argNo++] = p;
+
+    return (argNo);
+}
+
+
+/*****************************************************************************************/
+/* Write the markdown templates used by the benchmark: one paragraph per row with all   */
+/* the columns, and a chapter heading on column 1                                        */
+/*****************************************************************************************/
+static void writeTemplates (char *rowTemplate, char *chapterTemplate, int columns)
+{
+    /* Local Variables */
+    FILE   *fd;
+    int     col;
+
+    if ( (fd=fopen(rowTemplate,"w"))==NULL )
+    {
+        printf ("Unable to write the markdown template %s... Aborting\n\n",rowTemplate);
+        exit (-1);
+    }
+    fprintf (fd,"### Row of $1\n\n");
+    for (col=2; col<=columns; col++)
+        fprintf (fd,"- Column %d: $%d \n",col,col);
+    fclose (fd);
+
+    if ( (fd=fopen(chapterTemplate,"w"))==NULL )
+    {
+        printf ("Unable to write the markdown template %s... Aborting\n\n",chapterTemplate);
+        exit (-1);
+    }
+    fprintf (fd,"## $1 \n");
+    fclose (fd);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Generate the input of a scenario, convert it repeat times and print the best result  */
+/*****************************************************************************************/
+static void runScenario (benchScenario *sc, char *tool, char *gen, char *dir, long rows, int repeat)
+{
+    /* Local Variables */
+    char        csvFile[MAXPATHLEN], mdFile[MAXPATHLEN], rowTemplate[MAXPATHLEN],
+                chapterTemplate[MAXPATHLEN], genArgs[MAXPATHLEN], toolArgs[MAXPATHLEN];
+    char       *argv[MAXARGS];
+    int         argNo, i;
+    benchResult genRes, res, best = {0};
+    struct stat st;
+    double      inMB, outMB;
+
+    snprintf (csvFile,MAXPATHLEN,"%s/csv2mdText-bench.csv",dir);
+    snprintf (mdFile,MAXPATHLEN,"%s/csv2mdText-bench.md",dir);
+    snprintf (rowTemplate,MAXPATHLEN,"%s/csv2mdText-bench-row.md",dir);
+    snprintf (chapterTemplate,MAXPATHLEN,"%s/csv2mdText-bench-chapter.md",dir);
+    writeTemplates (rowTemplate,chapterTemplate,sc->columns);
+
+    /* Generate the input CSV file */
+    snprintf (genArgs,MAXPATHLEN,"-r %ld -c %d -l %d -q %d -m %d -k %d -g %ld",
+              rows,sc->columns,sc->fieldLen,sc->quoted,sc->multiLine,sc->comments,sc->groupSize);
+    argv[0] = gen;
+    argNo = appendArgs (argv,1,genArgs,toolArgs);
+    argv[argNo++] = "-o";       /* Not split, the directory may contain spaces */
+    argv[argNo++] = csvFile;
+    argv[argNo] = NULL;
+    if (!runCommand(argv,NULL,&genRes))
+    {
+        printf ("Unable to run %s... Aborting\n\n",gen);
+        exit (-1);
+    }
+    stat (csvFile,&st);
+    inMB = st.st_size/1e6;
+
+    /* Convert it, keeping the fastest run */
+    argv[0] = tool;
+    argv[1] = "-i";     argv[2] = csvFile;
+    argv[3] = "-o";     argv[4] = mdFile;
+    argv[5] = "-t";     argv[6] = rowTemplate;
+    argNo = 7;
+    if (sc->chapters)
+    {
+        argv[argNo++] = "-c";
+        argv[argNo++] = chapterTemplate;
+    }
+    argNo = appendArgs (argv,argNo,sc->toolArgs,toolArgs);
+    argv[argNo] = NULL;
+    for (i=0; i<repeat; i++)
+    {
+        if (!runCommand(argv,NULL,&res))
+        {
+            printf ("%-14s conversion failed\n",sc->name);
+            return;
+        }
+        if ( (i==0) || (res.wall<best.wall) )
+            best = res;
+        if (res.maxRss>best.maxRss)
+            best.maxRss = res.maxRss;
+    }   /* for (i=0; i<repeat; i++) */
+    stat (mdFile,&st);
+    outMB = st.st_size/1e6;
+
+    printf ("%-14s %9ld %8.1f %8.1f %7.3f %11.0f %8.1f %7.3f %7.3f %8.1f %7.3f\n",
+            sc->name,rows,inMB,outMB,best.wall,rows/best.wall,inMB/best.wall,
+            best.user,best.sys,best.maxRss/1024.0,genRes.wall);
+
+    unlink (csvFile);
+    unlink (mdFile);
+    unlink (rowTemplate);
+    unlink (chapterTemplate);
+
+    return;
+}
+
+
+/*****************
+ * Main Function *
+ *****************/
+int main(int argc, char *argv[])
+{
+    /* Local Variables */
+    char   *tool = DEFTOOL,
+           *gen = DEFGEN,
+           *dir = DEFDIR,
+           *filter = NULL;
+    long    rows = DEFROWS;
+    int     repeat = DEFREPEAT,
+            i;
+
+    for (i=1; i<argc; i++)
+    {
+        if ( (argv[i][0]!='-') || (argv[i][1]=='\0') || (argv[i][2]!='\0') || (i+1>=argc) )
+        {
+            printUsage();
+            exit (-1);
+        }
+        i += 1;
+        switch (argv[i-1][1])
+        {
+            case 'b':   tool = argv[i];             break;
+            case 'g':   gen = argv[i];              break;
+            case 'd':   dir = argv[i];              break;
+            case 'r':   rows = atol(argv[i]);       break;
+            case 'x':   repeat = atoi(argv[i]);     break;
+            case 'f':   filter = argv[i];           break;
+            default:
+            {   /* Unexpected option */
+                printUsage();
+                exit (-1);
+            }   /* default */
+        }   /* switch (argv[i-1][1]) */
+    }   /* for (i=1; i<argc; i++) */
+    if ( (rows<=0) || (repeat<=0) )
+    {
+        printUsage();
+        exit (-1);
+    }
+
+    printf ("%-14s %9s %8s %8s %7s %11s %8s %7s %7s %8s %7s\n",
+            "scenario","rows","in MB","out MB","wall s","rows/s","MB/s","user s","sys s","RSS MB","gen s");
+    for (i=0; i<(int)(sizeof(scenarios)/sizeof(scenarios[0])); i++)
+    {
+        if ( (filter==NULL) || (strcmp(filter,scenarios[i].name)==0) )
+        {
+            runScenario (&scenarios[i],tool,gen,dir,rows,repeat);
+            fflush (stdout);
+        }
+    }   /* for (i=0; ... ) */
+
+    exit (0);
+}
@@ -0,0 +1,275 @@
+/*************************************************************************************
+ *   -------------------------------------------                                     *
+ *   csv to markdown text converter (csv2mdText)                                     *
+ *   -------------------------------------------                                     *
+ *   Copyright 2023 Roberto Mameli                                                   *
+ *                                                                                   *
+ *   Licensed under the Apache License, Version 2.0 (the "License");                 *
+ *   you may not use this file except in compliance with the License.                *
+ *   You may obtain a copy of the License at                                         *
+ *                                                                                   *
+ *       http://www.apache.org/licenses/LICENSE-2.0                                  *
+ *                                                                                   *
+ *   Unless required by applicable law or agreed to in writing, software             *
+ *   distributed under the License is distributed on an "AS IS" BASIS,               *
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.        *
+ *   See the License for the specific language governing permissions and             *
+ *   limitations under the License.                                                  *
+ *   -----------------------------------------------------------------------------   *
+ *                                                                                   *
+ *   FILE:        csvGen source file                                                 *
+ *   VERSION:     1.0.0                                                              *
+ *   AUTHOR(S):   Roberto Mameli                                                     *
+ *   PRODUCT:     csv2mdText tool (benchmark suite)                                  *
+ *   DESCRIPTION: Deterministic generator of synthetic CSV files, used to benchmark  *
+ *                csv2mdText. The same options (and seed) always produce exactly     *
+ *                the same file                                                      *
+ *   REV HISTORY: See updated Revision History in file Changelog.md                  *
+ *                                                                                   *
+ *************************************************************************************/
+
+
+/**********************
+ * Linux system files *
+ **********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*************
+ * Constants *
+ *************/
+#define DEFROWS       100000    /* Default number of rows                                    */
+#define DEFCOLUMNS         8    /* Default number of columns                                 */
+#define DEFFIELDLEN       16    /* Default average length of a field                         */
+#define DEFSEED            1    /* Default seed of the pseudo random generator               */
+#define SEPARATOR        ';'    /* Same defaults used by csv2mdText                          */
+#define MULTILINE        '"'
+#define COMMENT          '#'
+
+
+/********************
+ * Type Definitions *
+ ********************/
+typedef struct
+{
+    long        rows;           /* Number of rows (header excluded)                           */
+    int         columns;        /* Number of columns                                          */
+    int         fieldLen;       /* Average length of a field (actual lengths are 50%-150%)   */
+    int         quoted;         /* Percentage of fields enclosed by quotes                    */
+    int         multiLine;      /* Percentage of fields spanning several lines                */
+    int         comments;       /* Percentage of comment lines (with respect to rows)        */
+    long        groupSize;      /* Rows with the same value in column 1 (0 = all different)  */
+    bool        header;         /* If true, the first line contains column names             */
+    uint64_t    seed;           /* Seed of the pseudo random generator                       */
+} genOptions;
+
+
+/********************
+ * Global Variables *
+ ********************/
+static uint64_t rngState;
+
+
+/**********************
+ * Internal Functions *
+ **********************/
+/*********************************************/
+/* Print out the command format (short form) */
+/*********************************************/
+static void printUsage (void)
+{
+    printf ("Usage:\n\n");
+    printf ("    csvGen [-r <rows>] [-c <columns>] [-l <field_length>] [-q <quoted_%%>]\n");
+    printf ("           [-m <multiline_%%>] [-k <comment_%%>] [-g <chapter_group_size>]\n");
+    printf ("           [-s <seed>] [-n] [-o <csv_output_file>]\n");
+    printf ("\n");
+    printf ("    Defaults: %d rows, %d columns, fields of %d characters on average, no quoted or\n",DEFROWS,DEFCOLUMNS,DEFFIELDLEN);
+    printf ("    multi line fields, no comments, column 1 different in each row, seed %d, header\n",DEFSEED);
+    printf ("    line included (-n to omit it), output to stdout.\n");
+    printf ("\n");
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Pseudo random generator (xorshift64*): deterministic and independent from libc        */
+/*****************************************************************************************/
+static inline uint64_t nextRandom (void)
+{
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+
+    return (rngState * 0x2545F4914F6CDD1DULL);
+}
+
+
+/*****************************************************************************************/
+/* Return true with the given probability (percentage)                                   */
+/*****************************************************************************************/
+static inline bool randomPercent (int percent)
+{
+    return ( (percent>0) && ((int)(nextRandom()%100)<percent) );
+}
+
+
+/*****************************************************************************************/
+/* Write a field of random words. Quoted fields may also contain separators and (for     */
+/* multi line fields) newlines, to exercise the slow paths of the parser                 */
+/*****************************************************************************************/
+static void writeField (FILE *out, genOptions *opt, bool quoted, bool multiLine)
+{
+    /* Local Variables */
+    static const char   letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    int                 i, len, r;
+
+    len = opt->fieldLen/2 + (int)(nextRandom()%(opt->fieldLen+1));
+    if (len==0)
+        len = 1;
+    if (quoted || multiLine)
+        fputc (MULTILINE,out);
+    for (i=0; i<len; i++)
+    {
+        r = (int)(nextRandom()%64);
+        if ( (r<8) && (i>0) && (i<len-1) )
+            fputc (' ',out);
+        else if ( (r==8) && (quoted || multiLine) )
+            fputc (SEPARATOR,out);
+        else if ( (r==10) && multiLine )
+            fputc ('\n',out);
+        else
+            fputc (letters[r%(sizeof(letters)-1)],out);
+    }   /* for (i=0; i<len; i++) */
+    if (multiLine)
+    {   /* Make sure that the field actually spans over several lines */
+        fputc ('\n',out);
+        fputc (letters[nextRandom()%(sizeof(letters)-1)],out);
+    }
+    if (quoted || multiLine)
+        fputc (MULTILINE,out);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Generate the whole CSV file                                                           */
+/*****************************************************************************************/
+static void generateCsv (FILE *out, genOptions *opt)
+{
+    /* Local Variables */
+    long    row;
+    int     col;
+    bool    multiLine;
+
+    if (opt->header)
+    {
+        for (col=1; col<=opt->columns; col++)
+            fprintf (out,"%sColumn %d",(col>1)?";":"",col);
+        fputc ('\n',out);
+    }
+
+    for (row=0; row<opt->rows; row++)
+    {
+        if (randomPercent(opt->comments))
+            fprintf (out,"%c comment line before row %ld\n",COMMENT,row+1);
+        for (col=1; col<=opt->columns; col++)
+        {
+            if (col>1)
+                fputc (SEPARATOR,out);
+            if (col==1)
+            {   /* Column 1 is the one used for chapters */
+                fprintf (out,"Chapter %ld",(opt->groupSize>0) ? row/opt->groupSize+1 : row+1);
+                continue;
+            }
+            multiLine = randomPercent (opt->multiLine);
+            writeField (out,opt,!multiLine && randomPercent(opt->quoted),multiLine);
+        }   /* for (col=1; col<=opt->columns; col++) */
+        fputc ('\n',out);
+    }   /* for (row=0; row<opt->rows; row++) */
+
+    return;
+}
+
+
+/*****************
+ * Main Function *
+ *****************/
+int main(int argc, char *argv[])
+{
+    /* Local Variables */
+    genOptions  opt;
+    FILE       *out = stdout;
+    char       *outputFile = NULL;
+    int         i;
+
+    opt.rows = DEFROWS;
+    opt.columns = DEFCOLUMNS;
+    opt.fieldLen = DEFFIELDLEN;
+    opt.quoted = 0;
+    opt.multiLine = 0;
+    opt.comments = 0;
+    opt.groupSize = 0;
+    opt.header = true;
+    opt.seed = DEFSEED;
+
+    for (i=1; i<argc; i++)
+    {
+        if ( (argv[i][0]!='-') || (argv[i][1]=='\0') || (argv[i][2]!='\0') )
+        {
+            printUsage();
+            exit (-1);
+        }
+        if (argv[i][1]=='n')
+        {
+            opt.header = false;
+            continue;
+        }
+        if (i+1>=argc)
+        {
+            printUsage();
+            exit (-1);
+        }
+        i += 1;
+        switch (argv[i-1][1])
+        {
+            case 'r':   opt.rows = atol(argv[i]);           break;
+            case 'c':   opt.columns = atoi(argv[i]);        break;
+            case 'l':   opt.fieldLen = atoi(argv[i]);       break;
+            case 'q':   opt.quoted = atoi(argv[i]);         break;
+            case 'm':   opt.multiLine = atoi(argv[i]);      break;
+            case 'k':   opt.comments = atoi(argv[i]);       break;
+            case 'g':   opt.groupSize = atol(argv[i]);      break;
+            case 's':   opt.seed = strtoull(argv[i],NULL,10); break;
+            case 'o':   outputFile = argv[i];               break;
+            default:
+            {   /* Unexpected option */
+                printUsage();
+                exit (-1);
+            }   /* default */
+        }   /* switch (argv[i-1][1]) */
+    }   /* for (i=1; i<argc; i++) */
+
+    if ( (opt.rows<0) || (opt.columns<1) || (opt.fieldLen<0) || (opt.groupSize<0) )
+    {
+        printUsage();
+        exit (-1);
+    }
+    if ( (outputFile!=NULL) && ((out=fopen(outputFile,"w"))==NULL) )
+    {
+        printf ("Unable to open output CSV File... Aborting\n\n");
+        exit (-1);
+    }
+
+    rngState = (opt.seed==0) ? DEFSEED : opt.seed;
+    generateCsv (out,&opt);
+
+    if (out!=stdout)
+        fclose (out);
+    exit (0);
+}
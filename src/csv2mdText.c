@@ -32,21 +32,42 @@
 /**********************
  * Linux system files *
  **********************/
+#define _GNU_SOURCE             /* Needed for O_DIRECT and memmem() */
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <zlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 
 /***************
  * Definitions *
  ***************/
 #define MAXFILENAMELEN   256    /* Maximum length for file names                             */
-#define MAXLINELEN      2048    /* Maximum length for a single line of the CSV input file    */
-#define MAXFIELDLEN     8192    /* Maximum length for a single field                         */
-#define MAXFIELDS         64    /* Maximum number of fields                                  */
+#define INITFIELDS        64    /* Initial size of the fields array (grows when needed)      */
+#define ARENABLOCKSIZE (64*1024)    /* Minimum size of a block of the per-row arena          */
 
 #define DEFSEPARATOR     ';'    /* Default CSV separator                                     */
 #define DEFHEADER       true    /* By default we assume that the first CSV line is an header */
@@ -55,22 +76,668 @@
 #define DEFMULTILINE     '"'    /* Character enclosing fields spanning over multiple lines   */
 #define DEFAPPEND      false    /* If true, the output md file is opened in append mode      */
 
+#define DEFOUTBUFSIZE  (1024*1024)  /* Default size of the output buffer (bytes)          */
+#define INBUFSIZE      (1024*1024)  /* Initial size of the window used to stream the input  */
+#define OUTBUFALIGN     4096    /* Alignment (and granularity) of the output buffer          */
+#define DEFTHREADS         1    /* By default rows are parsed and rendered by a single thread */
+#define MAXTHREADS        64    /* Maximum number of worker threads (option -j)              */
+#define CHUNKSIZE (4*1024*1024) /* Size of the input chunks rendered by worker threads       */
+#define MAXLEVELS          8    /* Maximum number of nested chapter levels (option -c)       */
+#define MAXHEADINGS (MAXLEVELS*(MAXLEVELS+1)/2) /* Chapter headings deferred in a chunk    */
+#define MAXJOBARGS       128    /* Maximum number of arguments of a job in the manifest (-b) */
+
 #define UNDEFINED          0    /* Possible values for altSyntax variable (for args parsing) */
 #define STANDARD           1
 #define DECODEHDR          2
 
+#define SCANAUTO           0    /* Possible values for the structural scanner (--scanner)    */
+#define SCANSCALAR         1
+#define SCANSSE2           2
+#define SCANAVX2           3
+
+#define CHARNONE           0    /* Byte classes used by the structural scanner               */
+#define CHARSTRUCT         1    /* Separator or multi line character                         */
+#define CHAREOL            2    /* CR, LF or null (end of line)                              */
+
+#define RFCSTART           0    /* States of the RFC 4180 parser (option --rfc4180): start   */
+#define RFCPLAIN           1    /* of a field, unquoted field, quoted field and quote found  */
+#define RFCQUOTED          2    /* in a quoted field (either closing it or escaping another  */
+#define RFCQUOTE           3    /* quote)                                                    */
+#define RFCSTATES          4
+#define RFCNONE            0    /* Actions of the RFC 4180 parser, taken on a transition     */
+#define RFCBEGIN           1    /* A field segment starts with this byte                     */
+#define RFCOPEN            2    /* A field segment starts after this byte (opening quote)    */
+#define RFCAPPEND          3    /* Append the segment ending before this byte to the field   */
+#define RFCFIELD           4    /* Same as RFCAPPEND, then close the field                   */
+#define RFCCLOSE           5    /* Close the field (already appended)                        */
+#define RFCLINE            6    /* Line feed within a quoted field                           */
+#define RFCROW             7    /* Same as RFCFIELD (CR LF or LF excluded), then end the row */
+#define RFCENDROW          8    /* Same as RFCCLOSE, then end the row                        */
+#define RFCNEXT(s,a)  ((s)|((a)<<2))    /* Transition of the RFC 4180 parser (state and action) */
+
+#define SYNCNONE           0    /* Possible values for syncPolicy (option --sync)            */
+#define SYNCDATA           1    /* fdatasync() the output file before closing it             */
+#define SYNCDIRECT         2    /* Write the output file with O_DIRECT (bypass page cache)   */
+
+#define CODECNONE          0    /* Possible values for the compression codec (--compress)    */
+#define CODECGZIP          1
+#define CODECZSTD          2
+#define CODECAUTO          3    /* Codec chosen from the extension of the file (.gz, .zst)   */
+#define CODECBUFSIZE (256*1024) /* Size of the buffers of the codec threads                  */
+#define PIPEBUFSIZE (1024*1024) /* Capacity requested for the pipes of the codec threads     */
+#define GZIPLEVEL          6    /* Compression levels of the output file                     */
+#define ZSTDLEVEL          3
+#define ZSTDLIB "libzstd.so.1"  /* zstd is loaded at runtime, only when needed               */
+
+#define ASYNCNONE          0    /* Possible values for the asynchronous I/O (--async-io)     */
+#define ASYNCURING         1    /* io_uring                                                  */
+#define ASYNCTHREAD        2    /* Helper thread                                             */
+#define ASYNCAUTO          3    /* io_uring if supported by the kernel, else a helper thread */
+#define ASYNCIDLE          0    /* States of the request of an asynchronous I/O engine       */
+#define ASYNCQUEUED        1
+#define ASYNCDONE          2
+#define READAHEADSIZE (256*1024)    /* Size of the read ahead buffers of a streamed input    */
+#define PREFETCHSIZE (8*1024*1024)  /* Part of a mapped input prefetched ahead of the parser */
+
+#define STATSNONE          0    /* Possible values for statsFormat (option --stats)          */
+#define STATSTEXT          1
+#define STATSJSON          2
+
+#define GROUPNONE          0    /* Possible values for groupOrder (option --group)           */
+#define GROUPFIRST         1    /* Chapters in order of first appearance                     */
+#define GROUPSORTED        2    /* Chapters sorted by the value of their chapter field       */
+#define DEFGROUPMEM (256*1024*1024) /* Default memory budget of chapter groups (--group-memory) */
+#define GROUPBUFSIZE     256    /* Initial size of the buffer of a chapter group             */
+#define INITBUCKETS     1024    /* Initial size of the hash index of chapter groups          */
+#define SPILLREADSIZE (1024*1024)   /* Size of the reads from the spill file                 */
+#define DEFMAXOPEN       128    /* Default maximum number of open output files (fan-out)     */
+#define FDRESERVE         16    /* File descriptors left free for other uses (fan-out)       */
+
+#define HEADINGUNKNOWN     0    /* Chapter heading deferred to the end of a chunk, compared   */
+#define HEADINGSAME        1    /* with the previous chunk (UNKNOWN) or already compared      */
+#define HEADINGCHANGED     2    /* within the chunk (SAME or CHANGED)                         */
+
+#define JOBFREE            0    /* Possible states of a chunk of input rendered in parallel  */
+#define JOBPENDING         1
+#define JOBDONE            2
+
+#define MAXPREDICATES     16    /* Maximum number of row filters (option --where)            */
+#define MAXNESTING        16    /* Maximum nesting of template sections ({{#if N}})          */
+
+#define SEGTEXT            0    /* Template instructions (what follows a literal segment):   */
+#define SEGFIELD           1    /* nothing, a field copied as is, a field transformed (or    */
+#define SEGFORMAT          2    /* replaced by a default text when blank), the test of a     */
+#define SEGIF              3    /* field ({{#if N}}) and the end of the true branch of a     */
+#define SEGELSE            4    /* section ({{else}})                                        */
+#define XFORMTRIM       0x01    /* Transforms of a field (${N|transform}): remove leading    */
+#define XFORMUPPER      0x02    /* and trailing blanks, convert to upper or lower case,      */
+#define XFORMLOWER      0x04    /* escape markdown special characters, escape pipes and      */
+#define XFORMMD         0x08    /* newlines for a table cell                                 */
+#define XFORMCELL       0x10
+
+#define WHEREEQ            0    /* Operators of the row filters (option --where)             */
+#define WHERENE            1
+#define WHEREPREFIX        2
+#define WHERELT            3
+#define WHERELE            4
+#define WHEREGT            5
+#define WHEREGE            6
+#define WHEREIN            7
+
+#define INDEXMAGIC "C2MDIDX1"   /* First bytes of the index file (option --incremental)      */
+#define RECORDMAGIC "C2MDREC1"  /* First bytes of the record index (option --record-index)   */
+#define KEYMAGIC "C2MDKEY1"     /* First bytes of a key index (options --keys and --serve)   */
+
+#define KEYORDERKEYS       0    /* Possible values for keyOrder (option --key-order)         */
+#define KEYORDERINPUT      1
+
+#define MAXCLIENTS        64    /* Maximum number of connections served at once (--serve)    */
+#define MAXREQUEST      4096    /* Maximum length of a request line (option --serve)         */
+#define MAXREQUESTARGS     8    /* Maximum number of arguments of a request (option --serve) */
+
 
 /********************
  * Type Definitions *
  ********************/
 typedef char    filenameString[MAXFILENAMELEN+1];
-typedef char    lineString[MAXLINELEN+1];
-typedef char    fieldString[MAXFIELDLEN+1];
+
+typedef struct
+{
+    uint64_t    readNs;         /* Time spent reading and indexing input lines (ns)       */
+    uint64_t    removeNs;       /* Time spent in removeDoubleMultiLineChar() (ns)         */
+    uint64_t    scanNs;         /* Time spent in scanSingleLine()/scanMultiLine() (ns)    */
+    uint64_t    renderNs;       /* Time spent rendering the templates (ns)                */
+    uint64_t    writeNs;        /* Time spent writing the output file (ns)                */
+    uint64_t    rows;           /* Rows emitted                                           */
+    uint64_t    reusedRows;     /* Rows copied from the previous output (--incremental)   */
+    uint64_t    filteredRows;   /* Rows rejected by the row filters (--where)             */
+    uint64_t    missingKeys;    /* Keys without rows (--keys)                             */
+    uint64_t    commentLines;   /* Comment lines skipped                                  */
+    uint64_t    emptyLines;     /* Empty lines skipped                                    */
+    uint64_t    multiLineRows;  /* Rows spanning over more than one line                  */
+    uint64_t    chapters;       /* Chapters emitted                                       */
+    uint64_t    outputFiles;    /* Output files written (output path pattern)             */
+    uint64_t    reopenedFiles;  /* Output files closed and reopened (output path pattern) */
+    uint64_t    bytesIn;        /* Bytes read from the input CSV file                     */
+    uint64_t    bytesOut;       /* Bytes written to the output markdown file              */
+    size_t      longestLine;    /* Longest input line (CR/LF excluded)                    */
+    size_t      longestField;   /* Longest field                                          */
+} runStats;
+
+typedef struct
+{
+    char   *ptr;            /* Field content (not null terminated). It points either into */
+    size_t  len;            /* the input CSV file or into a copy buffer                   */
+} fieldView;
+
+typedef struct
+{
+    char   *ptr;            /* Copy of a field that shall survive the current row (e.g.   */
+    size_t  len;            /* the last chapter), not null terminated                     */
+    size_t  cap;
+} keyString;
+
+typedef struct arenaBlock
+{
+    struct arenaBlock  *next;   /* Next block (kept allocated across rows for reuse)      */
+    size_t              size;   /* Size of data[]                                         */
+    size_t              used;   /* Bytes of data[] already allocated                      */
+    char                data[];
+} arenaBlock;
+
+typedef struct
+{
+    arenaBlock *first;          /* Bump allocator for all the bytes copied while parsing  */
+    arenaBlock *current;        /* a row. It is reset (not freed) at the start of a row   */
+} rowArena;
+
+typedef struct
+{
+    pthread_t   thread;     /* Thread compressing or decompressing the data               */
+    int         codec;      /* CODECGZIP or CODECZSTD                                     */
+    bool        compress;   /* True for an output file, false for an input file           */
+    int         srcFd;      /* Data read by the thread (compressed input file, or pipe    */
+    int         dstFd;      /* of the output) and written by it (pipe of the input, or    */
+                            /* compressed output file)                                    */
+    char        prefix[4];  /* Bytes already read from srcFd to detect the codec          */
+    size_t      prefixLen;
+    int         syncPolicy; /* SYNCNONE or SYNCDATA (compressed output file)              */
+} codecStream;
+
+typedef struct
+{
+    int         mode;       /* ASYNCURING or ASYNCTHREAD                                  */
+    int         fd;         /* File read or written                                       */
+    int         state;      /* ASYNCIDLE, ASYNCQUEUED or ASYNCDONE (one request at most)  */
+    bool        write;      /* Request: write (or read) len bytes of data at the current  */
+    char       *data;       /* position of the file                                       */
+    size_t      len;
+    ssize_t     result;     /* Bytes transferred, or -errno                               */
+    int         ringFd;     /* io_uring: ring, and its submission and completion queues   */
+    void       *sqRing,     /* mapped from the kernel                                     */
+               *cqRing;
+    size_t      sqRingSize,
+                cqRingSize,
+                sqeSize;
+    unsigned   *sqTail,
+               *sqMask,
+               *sqArray,
+               *cqHead,
+               *cqTail,
+               *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    pthread_t       thread; /* Helper thread (fallback), woken up for each request        */
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool            stop;
+} asyncIo;
+
+typedef struct
+{
+    const void *src;        /* ZSTD_inBuffer and ZSTD_outBuffer (see zstd.h)              */
+    size_t      size;
+    size_t      pos;
+} zstdInBuffer;
+
+typedef struct
+{
+    void       *dst;
+    size_t      size;
+    size_t      pos;
+} zstdOutBuffer;
+
+typedef struct
+{
+    void       *handle;     /* Functions of libzstd used by the codec threads (NULL if   */
+    void     *(*createDStream) (void);  /* the library is not available)                  */
+    size_t    (*initDStream) (void *);
+    size_t    (*decompressStream) (void *, zstdOutBuffer *, zstdInBuffer *);
+    size_t    (*freeDStream) (void *);
+    void     *(*createCStream) (void);
+    size_t    (*initCStream) (void *, int);
+    size_t    (*compressStream2) (void *, zstdOutBuffer *, zstdInBuffer *, int);
+    size_t    (*freeCStream) (void *);
+    unsigned  (*isError) (size_t);
+    const char *(*getErrorName) (size_t);
+} zstdLibrary;
+
+typedef struct
+{
+    char   *data;           /* Content of the input CSV file (or a window of it)          */
+    size_t  size;           /* Size of the input CSV file (or bytes in the window)        */
+    size_t  pos;            /* Offset of the next line to be read                         */
+    bool    mapped;         /* True if data is a memory mapping of the input file         */
+    bool    stream;         /* True if the input is read through a window (e.g. a pipe)   */
+    bool    eof;            /* True when the end of a streamed input has been reached     */
+    int     fd;             /* File descriptor of a streamed input                        */
+    size_t  cap;            /* Size of the window                                         */
+    size_t  keep;           /* Start of the oldest row still in use (kept in the window)  */
+    size_t  scanned;        /* Bytes of the window already searched for a newline         */
+    codecStream *codec;     /* Decompression of the input (NULL if not compressed)        */
+    asyncIo *aio;           /* Read ahead of a streamed input (NULL if synchronous)       */
+    char   *ahead[2];       /* Read ahead buffers: ahead[current] is being consumed from  */
+    int     current;        /* aheadPos to aheadLen, the other one is being read          */
+    size_t  aheadPos;
+    size_t  aheadLen;
+    size_t  prefetch;       /* A mapped input is prefetched when pos reaches this offset  */
+} inputCsv;
+
+typedef struct
+{
+    int         field;              /* Field tested (0-based)                             */
+    int         op;                 /* WHEREEQ, WHERENE, WHEREPREFIX, WHERELT, WHERELE,   */
+                                    /* WHEREGT, WHEREGE or WHEREIN                        */
+    char       *value;              /* Value compared with the field (not null terminated */
+    size_t      valueLen;           /* for WHEREIN, where it is the list of values)       */
+    double      number;             /* Value of numeric comparisons                       */
+    fieldView  *values;             /* Values of WHEREIN (views into value)               */
+    size_t     *buckets;            /* Hash index of values[] (position+1, 0 if empty),   */
+    size_t      bucketNo;           /* with linear probing; bucketNo is a power of 2      */
+} rowPredicate;
+
+typedef struct csvParser csvParser;
+typedef char *(*lineScanner) (csvParser *ps, char *p, char *limit);
+
+struct csvParser
+{
+    inputCsv    in;                     /* Input CSV file                                 */
+    char        separator,              /* CSV separator (option -s)                      */
+                multiLine,              /* Character enclosing multi line fields          */
+                comment;                /* Character that starts a comment (option -r)    */
+    bool        skipHeader;             /* True until the first valid line is skipped     */
+    bool        skipFields;             /* If true, fields are delimited but not stored   */
+    bool       *fieldWanted;            /* Fields referenced by the templates, NULL if    */
+    int         fieldLimit;             /* all of them are needed. Fields after the last  */
+                                        /* one (fieldLimit) are not split at all          */
+    bool        curSkipped;             /* True if the current field is not stored        */
+    rowPredicate *predicates;           /* Row filters (option --where), sorted by field  */
+    int         predicateNo;
+    int        *firstPredicate;         /* First predicate testing each field (-1 if none)*/
+    bool        rejected;               /* True once a row filter rejected the current row*/
+    int         lineNo;                 /* Number of lines read so far                    */
+    size_t      rowStart;               /* Offset of the first line of the last row read  */
+    fieldView  *fields;                 /* Fields extracted from the current row          */
+    int         fieldNo;                /* Number of fields extracted so far              */
+    int         fieldCap;               /* Size of the fields array                       */
+    char       *curPtr;                 /* Field currently being built (fields[fieldNo])  */
+    size_t      curLen;
+    bool        curCopied;              /* True if curPtr is a copy stored in the arena   */
+    rowArena    arena;                  /* Storage for copied lines and fields            */
+    lineScanner scanLine;               /* Structural scanner (scalar, SSE2 or AVX2)      */
+    char        charClass[256];         /* Byte classes used by the scalar scanner        */
+    char      **structs;                /* Structural index of the current line, i.e.     */
+    size_t      structNo;               /* position of all separators and multi line      */
+    size_t      structCap;              /* characters, in increasing order                */
+    size_t      structPos;              /* First entry not yet consumed by the parser     */
+    char       *lastMultiLine;          /* Last multi line character found in the line    */
+    char       *nextMultiLine;          /* Next multi line character in the input (only   */
+                                        /* used when skipFields is set)                   */
+    bool        doubleMultiLine;        /* True if the line contains a double multi line  */
+    bool        rfc4180;                /* Rows parsed by the RFC 4180 parser (--rfc4180) */
+    unsigned char rfcDfa[RFCSTATES][256];   /* Transitions of the RFC 4180 parser         */
+    runStats   *stats;                  /* Statistics (NULL if --stats was not given)     */
+};
+
+typedef struct
+{
+    char   *text;           /* Literal text to be copied verbatim (not null terminated)   */
+    size_t  textLen;        /* Length of the literal text                                 */
+    int     op;             /* What follows the text: SEGTEXT, SEGFIELD, SEGFORMAT, SEGIF */
+                            /* or SEGELSE                                                 */
+    int     fieldRef;       /* Field substituted (or tested by SEGIF) after the text      */
+                            /* (1-based), 0 if the placeholder is not followed by digits, */
+                            /* -1 if none                                                 */
+    int     transforms;     /* XFORM flags applied to the field (SEGFORMAT)               */
+    char   *defaultText;    /* Text substituted for a blank field (SEGFORMAT, NULL if     */
+    size_t  defaultLen;     /* none)                                                      */
+    int     jump;           /* Next segment when the field tested by SEGIF is blank, or   */
+                            /* at the end of the true branch (SEGELSE)                    */
+    char   *name;           /* Column referred to by name (${name}, {{#if name}}), NULL   */
+    size_t  nameLen;        /* if by number; fieldRef is set by resolveMdTemplate()       */
+} templateSegment;
+
+typedef struct
+{
+    char            *literals;      /* All literal text of the template, already split   */
+    templateSegment *segments;      /* Ordered list of literal segments and field refs   */
+    int              segmentNo;     /* Number of entries in segments[]                   */
+    int              firstFieldRef; /* First placeholder found (used for chapters)       */
+    int              maxFieldRef;   /* Highest field referenced by the template          */
+    bool             invalidRef;    /* True if at least one placeholder has no digits    */
+    int              checkedFieldNo;/* Row shape (fieldNo) already validated, -1 if none */
+    int              namedRefNo;    /* Placeholders and sections referring to a column   */
+                                    /* by name, resolved against the header row          */
+} mdTemplate;
+
+typedef struct
+{
+    mdTemplate  rowTemplate;        /* Compiled markdown template (option -t)             */
+    mdTemplate  chapterTemplate[MAXLEVELS]; /* Compiled chapter markdown templates (option */
+                                    /* -c), from the outermost chapter level inwards      */
+    int         chapterFieldNo[MAXLEVELS];  /* Field monitored by each level (0 if none)  */
+    int         levelNo;            /* Number of chapter levels (0 if no chapters)        */
+    char        placeHolder;        /* Placeholder character (option -p)                  */
+    keyString   lastChapter[MAXLEVELS]; /* Value of chapterFieldNo in the last chapter of */
+                                    /* each level                                         */
+    runStats   *stats;              /* Statistics (NULL if --stats was not given)         */
+} mdRenderer;
+
+typedef struct
+{
+    int     fd;             /* Output file descriptor (-1 for an in-memory output)        */
+    char   *buffer;         /* Rendered markdown not yet written to the output file       */
+    size_t  size;           /* Capacity of buffer (multiple of OUTBUFALIGN)               */
+    size_t  len;            /* Number of bytes currently stored in buffer                 */
+    int     syncPolicy;     /* SYNCNONE, SYNCDATA or SYNCDIRECT                           */
+    bool    direct;         /* True while the file descriptor is in O_DIRECT mode         */
+    codecStream *codec;     /* Compression of the output (NULL if not compressed)         */
+    asyncIo *aio;           /* Asynchronous writes (NULL if synchronous): a full buffer   */
+    char   *spare;          /* is written while the spare one is filled                   */
+    runStats   *stats;      /* Statistics (NULL if --stats was not given)                 */
+} outputBuffer;
+
+typedef struct
+{
+    int         level;              /* Chapter level of the heading                       */
+    bool        rowStart;           /* True for the outermost deferred heading of a row   */
+    int         same;               /* HEADINGUNKNOWN, HEADINGSAME or HEADINGCHANGED      */
+    keyString   key;                /* Value of the chapter field                         */
+    size_t      start;              /* Position of the heading in the output of the chunk */
+    size_t      end;
+} chapterHeading;
+
+typedef struct
+{
+    size_t          start;          /* Input range of the chunk (always whole rows)       */
+    size_t          end;
+    bool            skipHeader;     /* True if the header row is in this chunk            */
+    int             state;          /* JOBFREE, JOBPENDING or JOBDONE                     */
+    outputBuffer    out;            /* Markdown rendered by the worker (in memory)        */
+    chapterHeading  headings[MAXHEADINGS]; /* Headings rendered before the chapter of   */
+    int             headingNo;      /* the previous chunk was known: they are written     */
+                                    /* only if their chapter differs from it              */
+    bool            chapterSeen[MAXLEVELS]; /* True if a row of the chunk has the field   */
+    keyString       lastChapter[MAXLEVELS]; /* Last chapter of each level in the chunk    */
+} renderJob;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  jobPosted;      /* Signalled when a new chunk is ready to be rendered */
+    pthread_cond_t  jobDone;        /* Signalled when a worker completes a chunk          */
+    renderJob      *jobs;           /* Ring of jobs (jobNo entries)                       */
+    int             jobNo;
+    long            posted;         /* Number of jobs posted by the main thread           */
+    long            taken;          /* Number of jobs taken by the workers                */
+    bool            finished;       /* True when no more jobs will be posted              */
+    csvParser      *ps;             /* Parser settings and input shared by the workers    */
+    mdRenderer     *rd;             /* Compiled templates shared by the workers           */
+    int             scanner;        /* Structural scanner used by the workers             */
+    runStats       *stats;          /* Statistics of all workers (NULL if not needed)     */
+} renderPool;
+
+typedef struct
+{
+    off_t   offset;         /* Part of a chapter group already written to the spill file  */
+    size_t  len;
+} spillExtent;
+
+typedef struct
+{
+    keyString       key;            /* Value of the chapter field shared by the group     */
+    uint64_t        hash;           /* Hash of key, level and parent                      */
+    int             level;          /* Chapter level of the group                         */
+    int             parent;         /* Enclosing group (-1 for the outermost chapters)    */
+    int             firstChild;     /* Nested groups, in order of first appearance (-1    */
+    int             lastChild;      /* if none)                                           */
+    int             nextSibling;
+    outputBuffer    out;            /* Rows of the group rendered but not yet spilled     */
+    spillExtent    *extents;        /* Parts of the group written to the spill file, in   */
+    int             extentNo;       /* order                                              */
+    int             extentCap;
+} chapterGroup;
+
+typedef struct
+{
+    chapterGroup    preamble;       /* Rows preceding the first one with chapter fields   */
+    chapterGroup   *groups;         /* Chapter groups, in order of first appearance       */
+    int             firstRoot;      /* Outermost groups, in order of first appearance     */
+    int             lastRoot;       /* (-1 if none)                                       */
+    int             groupNo;
+    int             groupCap;
+    int            *buckets;        /* Hash index of groups[] (position+1, 0 if empty),   */
+    size_t          bucketNo;       /* with linear probing; bucketNo is a power of 2      */
+    int             current;        /* Group of the last row having a chapter field (-1   */
+                                    /* if none yet)                                       */
+    size_t          memUsed;        /* Memory used by the buffers of the groups           */
+    size_t          memLimit;       /* Groups are spilled to disk when memUsed exceeds it */
+    outputBuffer    spill;          /* Spill file (fd is -1 until the first spill)        */
+    off_t           spillSize;      /* Bytes written to the spill file so far             */
+    int             order;          /* GROUPFIRST or GROUPSORTED                          */
+} groupIndex;
+
+typedef struct
+{
+    char           *path;           /* Output file (expanded from the path pattern)       */
+    uint64_t        hash;           /* Hash of path                                       */
+    outputBuffer    out;            /* Buffered writer (fd is -1 while the file is closed)*/
+    bool            created;        /* True once the file has been opened (and truncated) */
+    int             prev,           /* Neighbours in the list of open files, from the     */
+                    next;           /* most recently used one (-1 if none)                */
+    keyString       lastChapter[MAXLEVELS]; /* Chapters of the file (see mdRenderer)      */
+} fanOutFile;
+
+typedef struct
+{
+    mdTemplate      pattern;        /* Output path pattern (option -o), compiled          */
+    char            placeHolder;    /* Placeholder character (option -p)                  */
+    fanOutFile     *files;          /* Output files, in order of first appearance         */
+    int             fileNo;
+    int             fileCap;
+    int            *buckets;        /* Hash index of files[] (position+1, 0 if empty),    */
+    size_t          bucketNo;       /* with linear probing; bucketNo is a power of 2      */
+    int             openNo,         /* Number of open files, and maximum number of open   */
+                    maxOpen;        /* files (option --max-open)                          */
+    int             mru,            /* Most and least recently used open files (-1 if     */
+                    lru;            /* none)                                              */
+    char           *path;           /* Path of the current row                            */
+    size_t          pathCap;
+    size_t          bufSize;        /* Size of the buffer of each open file               */
+    int             syncPolicy;     /* Options --sync, --compress and -a                  */
+    int             codec;
+    bool            appendMode;
+    runStats       *stats;          /* Statistics (NULL if --stats was not given)         */
+} fanOutput;
+
+typedef struct
+{
+    uint64_t    hash;               /* Hash of the row (see hashCsvRow())                 */
+    uint64_t    len;                /* Length of the markdown rendered for the row        */
+} rowIndexEntry;
+
+typedef struct
+{
+    uint64_t        optionsHash;    /* Hash of the templates and of the parsing options   */
+    rowIndexEntry  *rows;           /* Rows of the previous run, in output order          */
+    uint64_t       *offsets;        /* Offset of each of them in the previous output      */
+    size_t          rowNo;
+    size_t         *buckets;        /* Hash index of rows[] (position+1, 0 if empty),     */
+    size_t          bucketNo;       /* with linear probing; bucketNo is a power of 2      */
+    size_t          next;           /* Row following the last one reused                  */
+    int             oldFd;          /* Previous output file (-1 if it cannot be reused)   */
+    bool            writable;       /* True if oldFd can be patched in place              */
+    uint64_t        oldSize;        /* Size of the previous output                        */
+    bool            diverged;       /* True once a row differs from the previous run      */
+    uint64_t        keepLen;        /* Leading part of the previous output kept unchanged */
+    bool            patch;          /* True if the previous output is patched in place    */
+    uint64_t        runStart;       /* Part of the previous output still to be copied to  */
+    uint64_t        runLen;         /* the new one (consecutive reused rows)              */
+    outputBuffer    scratch;        /* Markdown of the row being rendered (in memory)     */
+    rowIndexEntry  *newRows;        /* Index of the new output, written at the end        */
+    size_t          newRowNo;
+    size_t          newRowCap;
+    filenameString  indexFile,      /* Index file, output file and temporary output file  */
+                    outputFile;
+    char            tmpOutputFile[MAXFILENAMELEN+5];
+} rowIndex;
+
+typedef struct
+{
+    uint64_t       *offsets;        /* Offset of each record of the input CSV file (the   */
+    size_t          recordNo;       /* header included), in increasing order              */
+    void           *map;            /* Mapping of the index file (NULL if offsets has     */
+    size_t          mapSize;        /* been built by this run)                            */
+} recordIndex;
+
+typedef struct
+{
+    int             altSyntax;          /* UNDEFINED, STANDARD or DECODEHDR               */
+    filenameString  inputCsvFile,       /* Options -i (or -d), -t, -o and -c              */
+                    inputMdTemplate,
+                    outputMdFile,
+                    inputMdChapterTemplate[MAXLEVELS];
+    int             levelNo;            /* Number of -c options                           */
+    filenameString  manifestFile;       /* Option -b (empty if not given)                 */
+    filenameString  indexFile;          /* Option --incremental (empty if not given)      */
+    filenameString  recordIndexFile;    /* Option --record-index (empty if not given)     */
+    filenameString  serveSocket;        /* Option --serve (empty if not given)            */
+    filenameString  keysFile;           /* Options --keys, --key-column and --key-order:  */
+    size_t          keyColumn;          /* keys to render, key column (1-based, 0 if not  */
+    int             keyOrder;           /* given) and order of the rows rendered          */
+    char           *where[MAXPREDICATES];   /* Options --where (copies of the arguments)  */
+    int             whereNo;
+    size_t          skipRows,           /* Options --skip, --head, --rows and --sample:   */
+                    lastRow,            /* rows to skip, last row to read (0 for all),    */
+                    headRows,           /* rows to render (0 for all) and sampling step   */
+                    sampleStep;
+    size_t          outBufSize,         /* Options --buffer-size and --group-memory       */
+                    groupMemory;
+    int             syncPolicy,         /* Options --sync, --scanner, -j, --stats,        */
+                    scanner,            /* --group and --max-open                         */
+                    threadNo,
+                    statsFormat,
+                    groupOrder,
+                    maxOpen,            /* Options --compress (CODECAUTO by extension)    */
+                    compress,           /* and --async-io                                 */
+                    asyncIo;
+    bool            skipHeader,         /* Options -n, -a and --rfc4180                   */
+                    appendMode,
+                    rfc4180;
+    char            separator,          /* Options -s, -r and -p                          */
+                    comment,
+                    placeHolder,
+                    multiLine;
+} runOptions;
+
+typedef struct cachedTemplate
+{
+    struct cachedTemplate  *next;
+    filenameString          file;           /* Markdown template file                     */
+    char                    placeHolder;    /* Placeholder used to compile it             */
+    mdTemplate              tmpl;           /* Compiled template (read only)              */
+} cachedTemplate;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    cachedTemplate *first;          /* Templates compiled so far (option -b)              */
+} templateCache;
+
+typedef struct
+{
+    runOptions  opt;                /* Options of the job (command line + manifest line)  */
+    int         nextSameOutput;     /* Next job writing the same output file (-1 if none) */
+    bool        chainHead;          /* True for the first job writing its output file     */
+} batchJob;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    batchJob       *jobs;           /* Jobs of the manifest, in order                     */
+    int             jobNo;
+    int             next;           /* First job not yet examined by the workers          */
+    templateCache   cache;          /* Templates shared by all the jobs                   */
+} batchPool;
+
+typedef struct serverTemplate
+{
+    struct serverTemplate  *next;
+    filenameString          file;           /* Markdown template file                     */
+    struct timespec         mtime;          /* Modification time and size of the file     */
+    off_t                   size;           /* when it was compiled                       */
+    bool                    loaded;         /* False if the file could not be read        */
+    unsigned                inputLoad;      /* Input whose header resolved the column     */
+                                            /* names of the template (see inputLoads)     */
+    mdTemplate              tmpl;
+} serverTemplate;
+
+typedef struct keyIndex
+{
+    struct keyIndex *next;          /* Next key column indexed (option --serve)           */
+    int             field;          /* Key column (0-based)                               */
+    size_t          firstRecord;    /* Record of the first row (the header is not a key)  */
+    size_t          rowNo;
+    uint64_t       *hashes;         /* Hash of the key of each row                        */
+    uint64_t       *chain;          /* Next row with the same hash (row+1, 0 if none)     */
+    uint64_t       *buckets;        /* Hash index of the first row of each hash (row+1, 0 */
+    size_t          bucketNo;       /* if empty), with linear probing; power of 2         */
+    void           *map;            /* Mapping of the index file (NULL if hashes and      */
+    size_t          mapSize;        /* buckets have been built by this run)               */
+} keyIndex;
+
+typedef struct
+{
+    int             fd;             /* Connection (-1 if the slot is free)                */
+    char            request[MAXREQUEST];    /* Request line being received               */
+    size_t          len;
+} serverClient;
+
+typedef struct
+{
+    runOptions     *opt;
+    csvParser       ps;             /* Parser of the input CSV file (mapped)              */
+    recordIndex     rx;             /* Offset of each row of the input                    */
+    size_t          inputSize;      /* Size of the input (ps.in.size is moved by seekCsv) */
+    size_t          firstRecord;    /* First record that is not the header                */
+    struct timespec inputMtime;     /* Modification time and size of the input when it   */
+    off_t           inputStSize;    /* was loaded                                         */
+    serverTemplate *templates;      /* Templates compiled so far                          */
+    unsigned        inputLoads;     /* Number of times the input has been (re)loaded      */
+    fieldView      *header;         /* Copy of the header row (column names of templates),*/
+    int             headerNo;       /* -1 if the input has no header (option -n)          */
+    char            error[MAXFILENAMELEN+512];  /* Error message of the current request   */
+    keyIndex       *keys;           /* Key columns indexed so far (dropped on reload)     */
+    outputBuffer    out;            /* Markdown of the current reply (in memory)          */
+    serverClient    clients[MAXCLIENTS];
+} csvServer;
 
 
 /********************
  * Global Variables *
  ********************/
+static volatile sig_atomic_t serverStop = 0;    /* Set by SIGINT/SIGTERM (option --serve) */
+static zstdLibrary  zstdLib;                    /* libzstd, loaded when first needed      */
 
 /**********************
  * Internal Functions *
@@ -82,13 +749,29 @@ static void printUsage (void)
 {
     printf ("Usage:\n\n");
     printf ("    csv2mdText [-n] [-a] [-s <separator>] [-p <placeholder>]\n");
-    printf ("               [-r <remark>] [-c <chapter_md_template>]\n");
+    printf ("               [-r <remark>] [-c <chapter_md_template>] [-j <threads>]\n");
+    printf ("               [--buffer-size <bytes>] [--sync <none|data|direct>]\n");
+    printf ("               [--scanner <auto|scalar|sse2|avx2>] [--stats <text|json>]\n");
+    printf ("               [--group <first|sorted>] [--group-memory <bytes>]\n");
+    printf ("               [--incremental <index_file>] [--where <predicate>]\n");
+    printf ("               [--skip <rows>] [--head <rows>] [--rows <first>-[<last>]]\n");
+    printf ("               [--sample 1/<step>] [--record-index <index_file>]\n");
+    printf ("               [--key-column <column> --keys <keys_file>] [--key-order <keys|input>]\n");
+    printf ("               [--max-open <files>] [--compress <auto|none|gzip|zstd>]\n");
+    printf ("               [--async-io <auto|uring|thread|none>] [--rfc4180]\n");
     printf ("               -i <csv_input_file> -o <md_output_file> -t <md_template>\n");
     printf ("\n");
-    printf ("    csv2mdText -d <csv_input_file>\n");
+    printf ("    csv2mdText -d <csv_input_file> [--skip <rows>] [--record-index <index_file>]\n");
+    printf ("               [--rfc4180]\n");
+    printf ("\n");
+    printf ("    csv2mdText -b <manifest_file> [-j <threads>] [<options applied to all jobs>]\n");
     printf ("\n");
     printf ("    csv2mdText -h\n");
     printf ("\n");
+    printf ("    csv2mdText --serve <socket_file> [-n] [-s <separator>] [-p <placeholder>] [-r <remark>]\n");
+    printf ("               [-c <chapter_md_template>] [--record-index <index_file>] [--rfc4180]\n");
+    printf ("               -i <csv_input_file> -t <md_template>\n");
+    printf ("\n");
 
     return;
 }
@@ -101,15 +784,31 @@ static void printHelp (void)
 {
     printf ("Usage:\n\n");
     printf ("    csv2mdText [-n] [-a] [-s <separator>] [-p <placeholder>]\n");
-    printf ("               [-r <remark>] [-c <chapter_md_template>]\n");
+    printf ("               [-r <remark>] [-c <chapter_md_template>] [-j <threads>]\n");
+    printf ("               [--buffer-size <bytes>] [--sync <none|data|direct>]\n");
+    printf ("               [--scanner <auto|scalar|sse2|avx2>] [--stats <text|json>]\n");
+    printf ("               [--group <first|sorted>] [--group-memory <bytes>]\n");
+    printf ("               [--incremental <index_file>] [--where <predicate>]\n");
+    printf ("               [--skip <rows>] [--head <rows>] [--rows <first>-[<last>]]\n");
+    printf ("               [--sample 1/<step>] [--record-index <index_file>]\n");
+    printf ("               [--key-column <column> --keys <keys_file>] [--key-order <keys|input>]\n");
+    printf ("               [--max-open <files>] [--compress <auto|none|gzip|zstd>]\n");
+    printf ("               [--async-io <auto|uring|thread|none>] [--rfc4180]\n");
     printf ("               -i <csv_input_file> -o <md_output_file> -t <md_template>\n");
     printf ("\n");
-    printf ("    csv2mdText -d <csv_input_file>\n");
+    printf ("    csv2mdText -d <csv_input_file> [--skip <rows>] [--record-index <index_file>]\n");
+    printf ("               [--rfc4180]\n");
+    printf ("\n");
+    printf ("    csv2mdText -b <manifest_file> [-j <threads>] [<options applied to all jobs>]\n");
     printf ("\n");
     printf ("    csv2mdText -h\n");
     printf ("\n");
+    printf ("    csv2mdText --serve <socket_file> [-n] [-s <separator>] [-p <placeholder>] [-r <remark>]\n");
+    printf ("               [-c <chapter_md_template>] [--record-index <index_file>] [--rfc4180]\n");
+    printf ("               -i <csv_input_file> -t <md_template>\n");
+    printf ("\n");
     printf ("Note Well: the instructions below refer to the first command layout reported above\n");
-    printf ("(the third layout, i.e. the one with option -h only, provides simply this help).\n");
+    printf ("(the fourth layout, i.e. the one with option -h only, provides simply this help).\n");
     printf ("\n");
     printf ("The purpose of this command is to create a markdown output file, formatted according\n");
     printf ("to a given template, with contents extracted from an input text file in csv format.\n");
@@ -117,17 +816,34 @@ static void printHelp (void)
     printf ("\n");
     printf ("    -i  this option specifies the input csv file (namely a text file with fields delimited\n");
     printf ("        by a proper separator (semicolon \";\" by default). The separator can be changed\n");
-    printf ("        through option -s (see below).\n");
+    printf ("        through option -s (see below). Use \"-\" to read the standard input: it is streamed\n");
+    printf ("        with bounded memory, so the tool can be used in a pipeline. Gzip and zstd compressed\n");
+    printf ("        inputs are recognized and decompressed on the fly by a separate thread.\n");
     printf ("\n");
     printf ("    -o  specifies the output file. By default the output file is overwritten by the tool\n");
     printf ("        (i.e. any previous content is deleted), but this behaviour can be changed by\n");
-    printf ("        using option -a.\n");
+    printf ("        using option -a. Use \"-\" to write to the standard output (messages are then\n");
+    printf ("        printed to the standard error). If the file name contains placeholders (e.g.\n");
+    printf ("        \"site/$1/index.md\"), each row is written to the file named after its fields, so\n");
+    printf ("        that a single pass produces one file per value (see --max-open).\n");
     printf ("\n");
     printf ("    -t  is used to provide the template file in markdown format. This is a valid markdown\n");
     printf ("        file, which contains some placeholders associated to specific columns in the input\n");
     printf ("        csv file (e.g. \"$1\" stands for the content of the first column, \"$2\" represents\n");
     printf ("        the second column, and so on). The escape character used to identify a placeholder\n");
     printf ("        can be redefinned by means of option -p (see below).\n");
+    printf ("        A placeholder can also be written as \"${N}\", followed by transforms and by a\n");
+    printf ("        default text: \"${N|trim|upper:-none}\". Transforms are trim (remove leading and\n");
+    printf ("        trailing blanks), upper, lower, md (escape markdown special characters) and cell\n");
+    printf ("        (escape pipes and turn newlines into <br>, for table cells). The default text\n");
+    printf ("        replaces a blank field. Sections \"{{#if N}} ... {{else}} ... {{/if}}\" (they can\n");
+    printf ("        be nested) are rendered only if column N is not blank, or only if it is blank;\n");
+    printf ("        a line holding nothing but a section tag does not produce an output line.\n");
+    printf ("        Braced placeholders and sections are not available with -p \"{\".\n");
+    printf ("        Columns can also be referred to by their name in the header row of the csv input\n");
+    printf ("        file, e.g. \"${Movie Name|trim}\" or \"{{#if Notes}}\": names are resolved once at\n");
+    printf ("        startup, and a name missing from the header or found more than once is reported\n");
+    printf ("        before any output is written.\n");
     printf ("\n");
     printf ("Basically, the tool works as follows. It scans the csv input file row-by-row, and it builds an\n");
     printf ("output markdown file, by concatenating multiple instances of the markdown template (-t), one\n");
@@ -173,7 +889,122 @@ static void printHelp (void)
     printf ("        for using the exclamation mark for comments).\n");
     printf ("\n");
     printf ("    -c  this option allows to define an optional markdown template for defining highest level\n");
-    printf ("        chapter templates.\n");
+    printf ("        chapter templates. It can be repeated (up to %d times) to define nested chapters: the\n",MAXLEVELS);
+    printf ("        first -c is the outermost level, each one monitors the field of its first placeholder,\n");
+    printf ("        and when a level changes all the levels nested into it are repeated as well.\n");
+    printf ("\n");
+    printf ("    -j  number of threads used to parse the csv input file and to render the markdown output\n");
+    printf ("        (default 1). The input is split into chunks of whole rows which are rendered in\n");
+    printf ("        parallel, while the output is written in the original row order, so that it is\n");
+    printf ("        identical to the one obtained with a single thread. It is ignored when the input\n");
+    printf ("        is streamed (e.g. -i -).\n");
+    printf ("\n");
+    printf ("    --buffer-size  size of the buffer used to collect the markdown output before writing it\n");
+    printf ("        to the output file (default 1M). The size can be followed by K, M or G (e.g. 64K).\n");
+    printf ("\n");
+    printf ("    --sync  policy used to write the output file: none (default) relies on the page cache,\n");
+    printf ("        data forces an fdatasync() before closing the output file, direct writes the output\n");
+    printf ("        file bypassing the page cache (O_DIRECT), if supported by the file system.\n");
+    printf ("\n");
+    printf ("    --scanner  implementation used to locate separators, multi line characters and line\n");
+    printf ("        ends in the csv input file. By default (auto) the fastest one supported by the CPU\n");
+    printf ("        is selected at runtime; all of them produce exactly the same output.\n");
+    printf ("\n");
+    printf ("    --rfc4180  parse the csv input file strictly according to RFC 4180, in a single pass:\n");
+    printf ("        separators, CR, LF and comment characters within quoted fields belong to the field\n");
+    printf ("        (line ends are kept as they are), \"\" is a quote, rows end with LF or CR LF, and\n");
+    printf ("        spaces are part of the fields. Blank lines and comments are skipped only where a\n");
+    printf ("        row may start.\n");
+    printf ("\n");
+    printf ("    --stats  at the end of the run, print to the standard error the time spent reading the\n");
+    printf ("        input, removing double quotes, splitting fields, rendering the templates and writing\n");
+    printf ("        the output, together with some counters (rows, skipped lines, multi line rows,\n");
+    printf ("        chapters, bytes in/out, longest line and field). The format is either text or json\n");
+    printf ("        (a single JSON object on one line). With -j, stage times are summed over threads.\n");
+    printf ("\n");
+    printf ("    --group  group the rows by the chapter fields (see -c), so that the input csv file does\n");
+    printf ("        not need to be sorted by them: each chapter is written once, followed by all its rows\n");
+    printf ("        in input order and by its nested chapters. Chapters are written in order of first\n");
+    printf ("        appearance (first) or sorted by the value of their chapter field (sorted). Rows are\n");
+    printf ("        rendered by a single thread.\n");
+    printf ("\n");
+    printf ("    --group-memory  memory budget for the rows rendered with --group (default 256M); when\n");
+    printf ("        it is exceeded, rendered rows are moved to a temporary file (in $TMPDIR or /tmp).\n");
+    printf ("\n");
+    printf ("    --incremental  keep in the given index file a hash of each row and the length of its\n");
+    printf ("        markdown, so that the next run renders only new or changed rows and copies the others\n");
+    printf ("        from the previous output file. Changing the templates or the parsing options\n");
+    printf ("        invalidates the whole index. Not allowed with -a, --group or -o -.\n");
+    printf ("\n");
+    printf ("    --where  render only the rows that satisfy the given predicate (it can be repeated, and\n");
+    printf ("        all predicates shall be satisfied). A predicate is a column number (optionally\n");
+    printf ("        preceded by the placeholder), an operator and a value: = (equal), != (different),\n");
+    printf ("        ^= (starts with), <, <=, >, >= (numeric comparison, fields that are not numbers\n");
+    printf ("        never match) or @ (the value is a file listing the accepted values, one per line).\n");
+    printf ("        Missing columns are tested as empty fields (e.g. --where 3=A --where '$5>=10').\n");
+    printf ("\n");
+    printf ("    --skip, --head, --rows, --sample  render only part of the rows, e.g. to preview a\n");
+    printf ("        template on a large input: --skip ignores the first rows, --head stops after the\n");
+    printf ("        given number of rendered rows, --rows renders the rows from first to last (both\n");
+    printf ("        included, numbered from 1) and --sample 1/<step> renders one row every <step>. Rows\n");
+    printf ("        are counted after the header, comments and --where; the input is not read beyond\n");
+    printf ("        the last row needed, and the rows that are not rendered are not split into fields.\n");
+    printf ("        With -d, --skip prints the fields of the row following the skipped ones.\n");
+    printf ("\n");
+    printf ("    --record-index  keep in the given index file the offset of each row of the csv input\n");
+    printf ("        file (comments and empty lines excluded, a multi line row counted once), so that\n");
+    printf ("        --skip, --rows and --sample read only the rows requested (unless --where is given),\n");
+    printf ("        -d --skip prints any row immediately and -j splits the input without reading it.\n");
+    printf ("        The index is rebuilt automatically when the size or the modification time of the\n");
+    printf ("        input (or the -r option) changes. The input shall be a regular file.\n");
+    printf ("\n");
+    printf ("    --key-column, --keys  render only the rows whose column (numbered from 1) is equal to\n");
+    printf ("        one of the keys listed in the keys file (\"-\" for the standard input), one per line.\n");
+    printf ("        The rows are found through a hash index of the column, kept next to the record\n");
+    printf ("        index (<index_file>.key<column>) when --record-index is given, so that following\n");
+    printf ("        lookups neither scan nor parse the input; only the matching rows are parsed. With\n");
+    printf ("        --key-order keys (default) the rows are rendered in the order of the keys, all the\n");
+    printf ("        rows of a key in input order; with --key-order input they are rendered in input\n");
+    printf ("        order, once each. Keys not found are reported by --stats.\n");
+    printf ("\n");
+    printf ("    --max-open  maximum number of output files kept open at once when -o is a path pattern\n");
+    printf ("        (default %d, limited by the file descriptors available). The least recently used\n",DEFMAXOPEN);
+    printf ("        file is closed when a new one is needed, and reopened in append mode later; the\n");
+    printf ("        output buffer (--buffer-size) is shared among the open files. Missing directories\n");
+    printf ("        are created, and slashes in the fields (or fields empty, \".\" or \"..\") become \"_\".\n");
+    printf ("        Each file has its own chapters (-c). Not available with --group, --incremental\n");
+    printf ("        or --keys.\n");
+    printf ("\n");
+    printf ("    --compress  compression of the output file: auto (default) compresses files ending in\n");
+    printf ("        .gz with gzip and in .zst with zstd, none, gzip or zstd force it (e.g. with -o -).\n");
+    printf ("        Compression runs on a separate thread; with -a a new gzip member (or zstd frame) is\n");
+    printf ("        appended. zstd requires %s at runtime. Not available with --incremental.\n",ZSTDLIB);
+    printf ("\n");
+    printf ("    --async-io  overlap file I/O with parsing and rendering: the output file is written\n");
+    printf ("        from two buffers in turn (one written while the other is filled), streamed inputs\n");
+    printf ("        are read ahead in the same way and mapped inputs are prefetched. auto (default)\n");
+    printf ("        uses io_uring when the kernel supports it and a helper thread otherwise; uring and\n");
+    printf ("        thread force the engine and none disables it. Not used with --sync direct, nor for\n");
+    printf ("        compressed files (already handled by a codec thread).\n");
+    printf ("\n");
+    printf ("Batch mode (third command layout): option -b reads a manifest file (\"-\" for the standard\n");
+    printf ("input) with one job per line; each line contains the options of the first command layout\n");
+    printf ("(e.g. -i a.csv -o a.md -t row.md -a). Empty lines and comments are skipped, arguments with\n");
+    printf ("spaces can be enclosed by double quotes, and options given on the command line apply to all\n");
+    printf ("jobs. All jobs run in a single process: templates are compiled once, and jobs are run by\n");
+    printf ("-j threads (default 1). Jobs writing the same output file are run one after the other in\n");
+    printf ("manifest order (so that -a appends in the right order); -j in a manifest line sets the\n");
+    printf ("threads used by that job.\n");
+    printf ("\n");
+    printf ("Server mode (fifth command layout): option --serve listens on a Unix domain socket (only\n");
+    printf ("accessible by the owner) and renders the rows requested by the clients, keeping the\n");
+    printf ("offset of each row of the input csv file and the compiled templates in memory. Each\n");
+    printf ("request is a line, either \"ROW <row> [<md_template>]\" (rows numbered from 1, header\n");
+    printf ("excluded) or \"KEY <column> <value> [<md_template>]\" (first row whose column is equal to\n");
+    printf ("value; the column is indexed when first used), and values with spaces can be enclosed by\n");
+    printf ("double quotes. The reply is \"OK <bytes>\" followed by a newline and the markdown of the\n");
+    printf ("row (preceded by its chapter headings, see -c), or \"ERR <message>\" and a newline. Input\n");
+    printf ("file and templates are reloaded when they change. The server stops on SIGINT or SIGTERM.\n");
     printf ("\n");
     printf ("Examples:\n");
     printf ("    csv2mdText -i ~/myInput.csv -o ~/myOutput.md -t ~/myTemplate.md\n");
@@ -194,635 +1025,7402 @@ static void printHelp (void)
 }
 
 
-/**************************************************************************/
-/* This function remove all double occurences of the multi line character */
-/* from the string passed as first argument. It does not return anything  */
-/**************************************************************************/
-static void removeDoubleMultiLineChar (char *inputLine, char multiLine)
+/*****************************************************************************************/
+/* Load libzstd (called once, see loadZstd()). zstd is not a build dependency: its      */
+/* streaming API is resolved at runtime, the first time a zstd file is found            */
+/*****************************************************************************************/
+static void openZstdLibrary (void)
 {
     /* Local Variables */
-    char       *p, *q;
-    lineString  dummyString = "";
+    void   *handle;
 
-    p = inputLine;
-    q = dummyString;
-
-    if (p==NULL)
+    if ( (handle=dlopen(ZSTDLIB,RTLD_NOW|RTLD_LOCAL))==NULL )
         return;
-
-    /* Remove all double occurences of multi line character */
-    while (*p != '\0')
+    zstdLib.createDStream = (void *(*)(void)) dlsym (handle,"ZSTD_createDStream");
+    zstdLib.initDStream = (size_t (*)(void *)) dlsym (handle,"ZSTD_initDStream");
+    zstdLib.decompressStream = (size_t (*)(void *,zstdOutBuffer *,zstdInBuffer *)) dlsym (handle,"ZSTD_decompressStream");
+    zstdLib.freeDStream = (size_t (*)(void *)) dlsym (handle,"ZSTD_freeDStream");
+    zstdLib.createCStream = (void *(*)(void)) dlsym (handle,"ZSTD_createCStream");
+    zstdLib.initCStream = (size_t (*)(void *,int)) dlsym (handle,"ZSTD_initCStream");
+    zstdLib.compressStream2 = (size_t (*)(void *,zstdOutBuffer *,zstdInBuffer *,int)) dlsym (handle,"ZSTD_compressStream2");
+    zstdLib.freeCStream = (size_t (*)(void *)) dlsym (handle,"ZSTD_freeCStream");
+    zstdLib.isError = (unsigned (*)(size_t)) dlsym (handle,"ZSTD_isError");
+    zstdLib.getErrorName = (const char *(*)(size_t)) dlsym (handle,"ZSTD_getErrorName");
+    if ( (zstdLib.createDStream==NULL) || (zstdLib.initDStream==NULL) || (zstdLib.decompressStream==NULL) ||
+         (zstdLib.freeDStream==NULL) || (zstdLib.createCStream==NULL) || (zstdLib.initCStream==NULL) ||
+         (zstdLib.compressStream2==NULL) || (zstdLib.freeCStream==NULL) || (zstdLib.isError==NULL) ||
+         (zstdLib.getErrorName==NULL) )
     {
-        *q = *p;
-        if ( (*p == multiLine) && (*(p+1) == multiLine) )
-            p += 1;
-        p += 1;
-        q += 1;
-    }   /* while (*p != '\0') */
-
-    *q = '\0';
-    strcpy (inputLine, dummyString);
+        dlclose (handle);
+        return;
+    }
+    zstdLib.handle = handle;
 
     return;
+}
+
+
+/*****************************************************************************************/
+/* Make sure that libzstd is loaded, aborting if it is not available                     */
+/*****************************************************************************************/
+static void loadZstd (void)
+{
+    static pthread_once_t   once = PTHREAD_ONCE_INIT;
 
+    pthread_once (&once,openZstdLibrary);
+    if (zstdLib.handle==NULL)
+    {
+        printf ("zstd compressed files require %s... Aborting\n\n",ZSTDLIB);
+        exit (-1);
+    }
+
+    return;
 }
 
 
-/*********************************************************************************************/
-/* Scan the current line read from input CSV file char-by-char and fills the fields[] array  */
-/* This function is invoked by the main loop when in single line mode                        */
-/* It exits when one of the following conditions occur:                                      */
-/* - EOL is reached (in this case it returns false, i.e. it stays in single line mode)       */
-/* - a delimiter is found at the beginning of the current field (in this case it returns     */
-/*   true, i.e. it switches to multiline mode). Upon return, control is taken by the         */
-/*   complementary function scanMultiLine()                                                  */
-/* Remember that all double delimiters have been removed by removeDoubleMultiLineChar(), so  */
-/* that we do not have to worry about that (i.e., if a delimiter is found within a field,    */
-/* neither at the beginning nor at the end, but in the middle, it means that in the original */
-/* line there was a double delimiter)                                                        */
-/*********************************************************************************************/
-static bool scanSingleLine (char **pp, char separator, char multiLine, int lineNo, int *fieldNo, fieldString fields[])
+/*****************************************************************************************/
+/* Codec of a file, from its first bytes (magic numbers of gzip and zstd)                */
+/*****************************************************************************************/
+static int detectCodec (unsigned char *magic, size_t len)
 {
-    /* This function is invoked from the main loop when we are not in multi line mode */
-    /* p points to the char we are currently scanning */
+    if ( (len>=2) && (magic[0]==0x1f) && (magic[1]==0x8b) )
+        return (CODECGZIP);
+    if ( (len>=4) && (magic[0]==0x28) && (magic[1]==0xb5) && (magic[2]==0x2f) && (magic[3]==0xfd) )
+        return (CODECZSTD);
+
+    return (CODECNONE);
+}
 
+
+/*****************************************************************************************/
+/* Codec of an existing file, from its first bytes (CODECNONE if it cannot be read)      */
+/*****************************************************************************************/
+static int fileCodec (char *file)
+{
     /* Local Variables */
-    char   *q, *r, *p;
-    int     len;
-    bool    withinQuotes;
+    unsigned char   magic[4];
+    ssize_t         got = 0;
+    int             fd;
 
-    /* Initialization */
-    p = *pp;
-    /* Go through the line char-by-char */
-    while ( (p!=NULL) && (*p!='\0') )
+    if ( (fd=open(file,O_RDONLY))>=0 )
     {
-        len = strlen (p);
-        if ( (q=strchr (p,separator)) != NULL)
-            *q = '\0';
-        if ( (r=strchr (p,multiLine)) == NULL )
-        {   /* This line does not contain the multi line delimiter */
-            strcpy (fields[*fieldNo],p);
-            (*fieldNo) += 1;
-            strcpy (fields[*fieldNo],"");
-            if (q)
-                p = q+1;
-            else
-                p += len;
-            continue;
-        }   /* if ( (r=strchr (p,multiLine)) == NULL ) */
-        /* We reach this point only if this line contains the multi line */
-        /* delimiter before the separator and/or the EOL (note that so   */
-        /* far we are in no multi line mode) */
-        if (q)  /* Restore the separator, otherwise the line will be truncated */
-            *q = separator;
-        if ( (r==p) || (*(r-1)=='\0') || (*(r-1)==separator) )
-        {   /* Special case: the delimiter is the first char in p or is */
-            /* preceded by a separator -> reset pointer p to the first  */
-            /* char after the delimiter and switch to multi line mode   */
-            strcpy (fields[*fieldNo],"");
-            p = r+1;
-            *pp = p;
-            return (true);
-        }
-        /* We are here because there is at least a multiline delimiter */
-        /* before the next separator (or the EOL). Go on char-by-char  */
-        /* starting from current position (p) and consider as only     */
-        /* separator characters that are not included in multi line    */
-        /* as actual separators                                        */
-        withinQuotes = false;   /* single line mode -> we start with withinQuotes = false */
-        q = p;
-        while ( (q!=NULL) && (*q!='\0') )
-        {
-            if (*q==multiLine)
-                withinQuotes = withinQuotes?false:true;
-            if ( (*q==separator) && (withinQuotes==false) )
-            {   /* we have found an actual separator, i.e. not enclosed within delimiters */
-                *q = '\0';
-                strcpy (fields[*fieldNo],p);
-                (*fieldNo) += 1;
-                strcpy (fields[*fieldNo],"");
-                p = q+1;
-                *pp = p;
-                return (false);
-            }   /* if ( (*q==separator) && (withinQuotes==false) ) */
-            q += 1;
-        }   /* while ( (q!=NULL) && (*q!='\0') ) */
-        strcpy (fields[*fieldNo],p);
-        (*fieldNo) += 1;
-        strcpy (fields[*fieldNo],"");
-        p = q;
-
-    }   /* while ( (p!=NULL) && (*p!='\0') ) */
+        got = pread (fd,magic,sizeof(magic),0);
+        close (fd);
+    }
 
-    /* The line is finished without switching to multi line mode */
-    *pp = p;
-    return (false);
+    return ( (got>0) ? detectCodec(magic,got) : CODECNONE );
 }
 
 
-/***********************************************************************************************/
-/* Scan the current line read from input CSV file char-by-char and fills the fields[] array    */
-/* This function is invoked by the main loop when in multi line mode                           */
-/* It exits when one of the following conditions occur:                                        */
-/* - EOL is reached (in this case it returns true, i.e. it stays in multi line mode)           */
-/* - a delimiter is found at the end of the current field (in this case it returns false,      */
-/*   i.e. it switches to single line mode). Upon return, control is taken by the complementary */
-/*   function scanSingleLine()                                                                 */
-/* Remember that all double delimiters have been removed by removeDoubleMultiLineChar(), so    */
-/* that we do not have to worry about that (i.e., if a delimiter is found within a field,      */
-/* neither at the beginning nor at the end, but in the middle, it means that in the original   */
-/* line there was a double delimiter)                                                          */
-/***********************************************************************************************/
-static bool scanMultiLine (char **pp, char separator, char multiLine, int lineNo, int *fieldNo, fieldString fields[])
+/*****************************************************************************************/
+/* Codec of an output file (option --compress): CODECAUTO is resolved from the extension */
+/* of the file name (.gz or .zst)                                                        */
+/*****************************************************************************************/
+static int outputCodec (int codec, char *outputMdFile)
 {
-    /* This function is invoked from the main loop when we are in multi line mode */
-    /* p points to the char we are currently scanning */
-
     /* Local Variables */
-    char   *r, *p;
-    int     len;
-    bool    withinQuotes;
+    size_t  len = strlen(outputMdFile);
 
-    /* Initialization */
-    p = *pp;
+    if (codec!=CODECAUTO)
+        return (codec);
+    if ( (len>3) && (strcmp(outputMdFile+len-3,".gz")==0) )
+        return (CODECGZIP);
+    if ( (len>4) && (strcmp(outputMdFile+len-4,".zst")==0) )
+        return (CODECZSTD);
+
+    return (CODECNONE);
+}
+
+
+/*****************************************************************************************/
+/* Write len bytes to a file descriptor, retrying on partial writes and signals. It      */
+/* returns false on errors (errno is set)                                                */
+/*****************************************************************************************/
+static bool writeFd (int fd, void *data, size_t len)
+{
+    /* Local Variables */
+    ssize_t written;
 
-    /* Go through the line char-by-char */
-    while ( (p!=NULL) && (*p!='\0') )
+    while (len>0)
     {
-        len = strlen (p);
-        if ( (r=strchr (p,multiLine)) == NULL )
-        {   /* This line does not contain the multi line delimiter */
-            strcat (fields[*fieldNo],p);
-            strcat (fields[*fieldNo],"\n");
-            p += len;
-            *pp = p;
-            return (true);
-        }   /* if ( (r=strchr (p,multiLine)) == NULL ) */
-        /* If we reach this point this line contains the multi line */
-        /* delimiter. Check whether it ends the field or not        */
-        if ( (*(r+1)=='\0') || (*(r+1)==separator) )
-        {   /* The delimiter is the last char of the current field */
-            /* preceded by a separator -> stop multi line mode     */
-            *r = '\0';
-            strcat (fields[*fieldNo],p);
-            (*fieldNo) += 1;
-            strcpy (fields[*fieldNo],"");
-            if (*(r+1)==separator)
-                p = r+2;
-            else
-                p = r+1;
-            *pp = p;
+        if ( (written=write(fd,data,len))<0 )
+        {
+            if (errno==EINTR)
+                continue;
             return (false);
         }
-        /* The multi line delimiter is not the last character of this field   */
-        /* It shall be necessarily in the middle                              */
-        withinQuotes = true;    /* multi line mode -> we start with withinQuotes = true */
-        r = p;
-        while ( (r!=NULL) && (*r!='\0') )
-        {
-            if (*r==multiLine)
-                withinQuotes = withinQuotes?false:true;
-            if ( (*r==separator) && (withinQuotes==false) )
-            {   /* we have found an actual separator, i.e. not enclosed within delimiters   */
-                /* in this case we attach the text until the separator to the current field */
-                /* then switch to single line mode */
-                *r = '\0';
-                if ( (r!=p)&&(*(r-1)==multiLine) )  /* if the char that precedes the separator */
-                    *(r-1) = '\0';                  /* is the closing delimiter, eliminate it  */
-                strcat (fields[*fieldNo],p);
-                (*fieldNo) += 1;
-                strcpy (fields[*fieldNo],"");
-                p = r+1;
-                *pp = p;
-                return (false);
-            }   /*if ( (*r==separator) && (withinQuotes==false) ) */
-            r += 1;
-        }   /* while ( (r!=NULL) && (*r!='\0') ) */
-        strcat (fields[*fieldNo],p);
-        strcat (fields[*fieldNo],"\n");
-        p = r;
-
-    }   /* while ( (p!=NULL) && (*p!='\0') ) */
+        data = (char *)data + written;
+        len -= written;
+    }   /* while (len>0) */
 
-    /* The line is finished without switching to single line mode */
-    *pp = p;
     return (true);
 }
 
 
-/********************************************************************************************/
-/* This function appends to the output file a new section, obtained by copy/paste of the    */
-/* input markdown template, with all placeholder properly substitued by the content of the  */
-/* fields obtained from parsing the current csv input file                                  */
-/* Please note that the output file shall be opened by the calling function before entering */
-/* appendCsvRow2Output(), while the input template is opened and closed directly here       */
-/********************************************************************************************/
-static void appendCsvRow2Output (FILE *outputMdFd, char *inputMdTemplate, char placeHolder, int fieldNo, fieldString fields[])
+/*****************************************************************************************/
+/* Read up to len bytes from the source of a codec thread, starting with the bytes      */
+/* already read to detect the codec. It returns 0 at the end of the data                */
+/*****************************************************************************************/
+static size_t readCodecSource (codecStream *cs, char *buffer, size_t len)
 {
     /* Local Variables */
-    FILE       *inputMdTemplateFd;
-    lineString  currentLine;
-    char       *p, *q;
-    int         currentField;
+    ssize_t got;
 
-    /* Open the markdown template file in read mode */
-    if ( (inputMdTemplateFd=fopen(inputMdTemplate,"r"))==NULL )
+    if (cs->prefixLen>0)
     {
-        printf ("Unable to open input Markdown Template... Aborting\n\n");
-        exit (-1);
+        memcpy (buffer,cs->prefix,cs->prefixLen);
+        got = cs->prefixLen;
+        cs->prefixLen = 0;
+        return (got);
     }
-
-    /* Append the content of the input template to the output */
-    /* file substituting placeholders with the content of the */
-    /* corresponding fields                                   */
-    while ( fgets(currentLine,MAXLINELEN,inputMdTemplateFd) )
+    while ( (got=read(cs->srcFd,buffer,len))<0 )
     {
-        currentLine[strcspn(currentLine, "\r\n")] = '\0';   /* Remove trailing CR, LF, CRLF, LFCR, etc.    */
-        p = currentLine;
-        while ( (q=strchr(p,placeHolder))!=NULL )
+        if (errno!=EINTR)
         {
-            *q = '\0';
-            fprintf (outputMdFd,"%s",p);
-            currentField = 0;
-            q += 1;
-            while ( ((*q)!='\0') && isdigit(*q) )
-            {
-                currentField = 10*currentField + (int)(*q -'0');
-                q += 1;
-            }   /* while ( ((*q)!='\0') && isdigit(*q) ) */
-
-            if ( (currentField<=0) || (currentField>fieldNo+1) )
-            {
-                printf ("The template contains a placeholder (%c%d) that refers to a non-existing field... Aborting\n\n",placeHolder,currentField);
-                exit (-1);
-            }
-            fprintf (outputMdFd,"%s",fields[currentField-1]);
-            if ( *q=='\0')
-                p = q;
-            else
-                p = q+1;
+            printf ("Error reading %s (%s)... Aborting\n\n",(cs->compress)?"output Markdown File":"input CSV File",strerror(errno));
+            exit (-1);
         }
-        fprintf (outputMdFd,"%s\n",p);
+    }   /* while ( (got=read(cs->srcFd,buffer,len))<0 ) */
 
-    }   /* while ( fgets(currentLine,MAXLINELEN,inputMdTemplateFd) ) */
-
-    fprintf (outputMdFd,"\n");
-    fclose (inputMdTemplateFd);
-
-    return;
+    return (got);
+}
+
+
+/*****************************************************************************************/
+/* Write data produced by a codec thread. A decompressed input is written to the pipe   */
+/* read by the parser: when the parser stops early (e.g. --head) the pipe is closed and */
+/* the thread just stops (it returns false). Errors writing a compressed output file     */
+/* are fatal                                                                             */
+/*****************************************************************************************/
+static bool writeCodecData (codecStream *cs, void *data, size_t len)
+{
+    if (writeFd(cs->dstFd,data,len))
+        return (true);
+    if (cs->compress || (errno!=EPIPE))
+    {
+        printf ("Error writing %s (%s)... Aborting\n\n",(cs->compress)?"output Markdown File":"input CSV File",strerror(errno));
+        exit (-1);
+    }
+
+    return (false);
+}
+
+
+/*****************************************************************************************/
+/* Gzip (and zlib) decompression; concatenated gzip members are decompressed in turn    */
+/*****************************************************************************************/
+static void gunzipStream (codecStream *cs, char *inBuffer, char *outBuffer)
+{
+    /* Local Variables */
+    z_stream    z;
+    int         ret = Z_OK;
+    size_t      got = 0;
+
+    memset (&z,0,sizeof(z_stream));
+    if (inflateInit2(&z,15+32)!=Z_OK)
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    for (;;)
+    {
+        if (z.avail_in==0)
+        {
+            if ( (got=readCodecSource(cs,inBuffer,CODECBUFSIZE))==0 )
+                break;
+            z.next_in = (Bytef *)inBuffer;
+            z.avail_in = got;
+        }
+        if (ret==Z_STREAM_END)
+            inflateReset (&z);              /* Next gzip member */
+        z.next_out = (Bytef *)outBuffer;
+        z.avail_out = CODECBUFSIZE;
+        ret = inflate (&z,Z_NO_FLUSH);
+        if ( (ret!=Z_OK) && (ret!=Z_STREAM_END) && (ret!=Z_BUF_ERROR) )
+        {
+            printf ("Error decompressing input CSV File (%s)... Aborting\n\n",(z.msg!=NULL)?z.msg:"invalid gzip data");
+            exit (-1);
+        }
+        if (!writeCodecData(cs,outBuffer,CODECBUFSIZE-z.avail_out))
+            break;
+    }   /* for (;;) */
+    if ( (ret!=Z_STREAM_END) && (got==0) )
+    {
+        printf ("Error decompressing input CSV File (truncated gzip data)... Aborting\n\n");
+        exit (-1);
+    }
+    inflateEnd (&z);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Gzip compression of the output                                                        */
+/*****************************************************************************************/
+static void gzipStream (codecStream *cs, char *inBuffer, char *outBuffer)
+{
+    /* Local Variables */
+    z_stream    z;
+    int         flush = Z_NO_FLUSH,
+                ret;
+    size_t      got;
+
+    memset (&z,0,sizeof(z_stream));
+    if (deflateInit2(&z,GZIPLEVEL,Z_DEFLATED,15+16,8,Z_DEFAULT_STRATEGY)!=Z_OK)
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    do
+    {
+        got = readCodecSource (cs,inBuffer,CODECBUFSIZE);
+        if (got==0)
+            flush = Z_FINISH;
+        z.next_in = (Bytef *)inBuffer;
+        z.avail_in = got;
+        do
+        {
+            z.next_out = (Bytef *)outBuffer;
+            z.avail_out = CODECBUFSIZE;
+            ret = deflate (&z,flush);
+            writeCodecData (cs,outBuffer,CODECBUFSIZE-z.avail_out);
+        } while (z.avail_out==0);
+    } while (flush!=Z_FINISH);
+    if (ret!=Z_STREAM_END)
+    {
+        printf ("Error compressing output Markdown File... Aborting\n\n");
+        exit (-1);
+    }
+    deflateEnd (&z);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Zstd decompression; concatenated frames are decompressed in turn                      */
+/*****************************************************************************************/
+static void unzstdStream (codecStream *cs, char *inBuffer, char *outBuffer)
+{
+    /* Local Variables */
+    void           *ds;
+    zstdInBuffer    in;
+    zstdOutBuffer   out;
+    size_t          ret = 0;
+    bool            open = true;
+
+    if ( (ds=zstdLib.createDStream())==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    zstdLib.initDStream (ds);
+    while ( open && ((in.size=readCodecSource(cs,inBuffer,CODECBUFSIZE))>0) )
+    {
+        in.src = inBuffer;
+        in.pos = 0;
+        while ( open && (in.pos<in.size) )
+        {
+            out.dst = outBuffer;
+            out.size = CODECBUFSIZE;
+            out.pos = 0;
+            ret = zstdLib.decompressStream (ds,&out,&in);
+            if (zstdLib.isError(ret))
+            {
+                printf ("Error decompressing input CSV File (%s)... Aborting\n\n",zstdLib.getErrorName(ret));
+                exit (-1);
+            }
+            open = writeCodecData (cs,outBuffer,out.pos);
+        }   /* while ( open && (in.pos<in.size) ) */
+    }   /* while ( open && ((in.size=readCodecSource(cs,inBuffer,CODECBUFSIZE))>0) ) */
+    if (open && (ret!=0))
+    {
+        printf ("Error decompressing input CSV File (truncated zstd data)... Aborting\n\n");
+        exit (-1);
+    }
+    zstdLib.freeDStream (ds);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Zstd compression of the output                                                        */
+/*****************************************************************************************/
+static void zstdStream (codecStream *cs, char *inBuffer, char *outBuffer)
+{
+    /* Local Variables */
+    void           *zs;
+    zstdInBuffer    in;
+    zstdOutBuffer   out;
+    size_t          ret;
+    int             endOp = 0;              /* ZSTD_e_continue, then ZSTD_e_end (2) */
+
+    if ( (zs=zstdLib.createCStream())==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    zstdLib.initCStream (zs,ZSTDLEVEL);
+    do
+    {
+        in.size = readCodecSource (cs,inBuffer,CODECBUFSIZE);
+        if (in.size==0)
+            endOp = 2;
+        in.src = inBuffer;
+        in.pos = 0;
+        do
+        {
+            out.dst = outBuffer;
+            out.size = CODECBUFSIZE;
+            out.pos = 0;
+            ret = zstdLib.compressStream2 (zs,&out,&in,endOp);
+            if (zstdLib.isError(ret))
+            {
+                printf ("Error compressing output Markdown File (%s)... Aborting\n\n",zstdLib.getErrorName(ret));
+                exit (-1);
+            }
+            writeCodecData (cs,outBuffer,out.pos);
+        } while ( (in.pos<in.size) || ((endOp==2) && (ret!=0)) );
+    } while (endOp!=2);
+    zstdLib.freeCStream (zs);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Codec thread: it decompresses the input file into the pipe read by the parser, or    */
+/* compresses the data written by the tool into the pipe of the output file, so that    */
+/* compression runs in parallel with parsing and rendering. The thread closes both its  */
+/* descriptors when done (so the parser reads the end of the input). SIGPIPE is blocked,*/
+/* so that a parser stopping early only makes write() fail with EPIPE                    */
+/*****************************************************************************************/
+static void *codecWorker (void *arg)
+{
+    /* Local Variables */
+    codecStream    *cs = (codecStream *)arg;
+    sigset_t        mask;
+    char           *inBuffer, *outBuffer;
+
+    sigemptyset (&mask);
+    sigaddset (&mask,SIGPIPE);
+    pthread_sigmask (SIG_BLOCK,&mask,NULL);
+    if ( ((inBuffer=malloc(CODECBUFSIZE))==NULL) || ((outBuffer=malloc(CODECBUFSIZE))==NULL) )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    if (cs->codec==CODECGZIP)
+        (cs->compress) ? gzipStream(cs,inBuffer,outBuffer) : gunzipStream(cs,inBuffer,outBuffer);
+    else
+        (cs->compress) ? zstdStream(cs,inBuffer,outBuffer) : unzstdStream(cs,inBuffer,outBuffer);
+    free (inBuffer);
+    free (outBuffer);
+
+    if ( cs->compress && (cs->syncPolicy!=SYNCNONE) && (fdatasync(cs->dstFd)<0) && (errno!=EINVAL) )
+    {
+        printf ("Error syncing output Markdown File (%s)... Aborting\n\n",strerror(errno));
+        exit (-1);
+    }
+    if (cs->srcFd!=STDIN_FILENO)
+        close (cs->srcFd);
+    close (cs->dstFd);
+
+    return (NULL);
+}
+
+
+/*****************************************************************************************/
+/* Start a codec thread between fd (the compressed file, owned by the thread from now  */
+/* on) and a new pipe. The returned descriptor is the read end of the pipe for an input */
+/* file (compress false) and its write end for an output file                           */
+/*****************************************************************************************/
+static int startCodec (codecStream **codec, int codecType, bool compress, int fd, char *prefix, size_t prefixLen, int syncPolicy)
+{
+    /* Local Variables */
+    codecStream    *cs;
+    int             p[2];
+
+    if (codecType==CODECZSTD)
+        loadZstd ();
+    if ( (cs=calloc(1,sizeof(codecStream)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    if (pipe2(p,O_CLOEXEC)<0)
+    {
+        printf ("Unable to create a pipe (%s)... Aborting\n\n",strerror(errno));
+        exit (-1);
+    }
+    fcntl (p[0],F_SETPIPE_SZ,PIPEBUFSIZE);   /* Best effort: the default is 64 KiB */
+    cs->codec = codecType;
+    cs->compress = compress;
+    cs->srcFd = (compress) ? p[0] : fd;
+    cs->dstFd = (compress) ? fd : p[1];
+    memcpy (cs->prefix,prefix,prefixLen);
+    cs->prefixLen = prefixLen;
+    cs->syncPolicy = syncPolicy;
+    if (pthread_create(&cs->thread,NULL,codecWorker,cs)!=0)
+    {
+        printf ("Unable to create the codec thread... Aborting\n\n");
+        exit (-1);
+    }
+    *codec = cs;
+
+    return ( (compress) ? p[1] : p[0] );
+}
+
+
+/*****************************************************************************************/
+/* Wait for a codec thread, after closing the descriptor of the pipe used by the tool   */
+/*****************************************************************************************/
+static void stopCodec (codecStream **codec, int fd)
+{
+    close (fd);
+    pthread_join ((*codec)->thread,NULL);
+    free (*codec);
+    *codec = NULL;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Set up an io_uring with room for a single request (no liburing: the rings are mapped */
+/* directly). It returns false if io_uring is not available, e.g. on kernels without    */
+/* reads and writes at the current file position (before 5.6) or when it is disabled   */
+/*****************************************************************************************/
+static bool openUring (asyncIo *aio)
+{
+    /* Local Variables */
+    struct io_uring_params  p;
+
+    memset (&p,0,sizeof(p));
+    if ( (aio->ringFd=syscall(__NR_io_uring_setup,2,&p))<0 )
+        return (false);
+    if ( !(p.features&IORING_FEAT_RW_CUR_POS) )
+    {
+        close (aio->ringFd);
+        return (false);
+    }
+    aio->sqRingSize = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+    aio->cqRingSize = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    if (p.features&IORING_FEAT_SINGLE_MMAP)
+    {
+        if (aio->cqRingSize>aio->sqRingSize)
+            aio->sqRingSize = aio->cqRingSize;
+        aio->cqRingSize = aio->sqRingSize;
+    }
+    aio->sqeSize = p.sq_entries*sizeof(struct io_uring_sqe);
+    aio->sqRing = mmap (NULL,aio->sqRingSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,aio->ringFd,IORING_OFF_SQ_RING);
+    aio->cqRing = (p.features&IORING_FEAT_SINGLE_MMAP) ? aio->sqRing :
+                  mmap (NULL,aio->cqRingSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,aio->ringFd,IORING_OFF_CQ_RING);
+    aio->sqes = mmap (NULL,aio->sqeSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,aio->ringFd,IORING_OFF_SQES);
+    if ( (aio->sqRing==MAP_FAILED) || (aio->cqRing==MAP_FAILED) || (aio->sqes==MAP_FAILED) )
+    {
+        printf ("Unable to map the io_uring queues (%s)... Aborting\n\n",strerror(errno));
+        exit (-1);
+    }
+    aio->sqTail = (unsigned *)((char *)aio->sqRing + p.sq_off.tail);
+    aio->sqMask = (unsigned *)((char *)aio->sqRing + p.sq_off.ring_mask);
+    aio->sqArray = (unsigned *)((char *)aio->sqRing + p.sq_off.array);
+    aio->cqHead = (unsigned *)((char *)aio->cqRing + p.cq_off.head);
+    aio->cqTail = (unsigned *)((char *)aio->cqRing + p.cq_off.tail);
+    aio->cqMask = (unsigned *)((char *)aio->cqRing + p.cq_off.ring_mask);
+    aio->cqes = (struct io_uring_cqe *)((char *)aio->cqRing + p.cq_off.cqes);
+
+    return (true);
+}
+
+
+/*****************************************************************************************/
+/* Helper thread (fallback of io_uring): it performs the requests posted by the main     */
+/* thread one at a time. Writes are completed (retrying partial writes), reads return   */
+/* what is available                                                                     */
+/*****************************************************************************************/
+static void *asyncWorker (void *arg)
+{
+    /* Local Variables */
+    asyncIo    *aio = (asyncIo *)arg;
+    ssize_t     result;
+
+    pthread_mutex_lock (&aio->lock);
+    for (;;)
+    {
+        while ( (aio->state!=ASYNCQUEUED) && !aio->stop )
+            pthread_cond_wait (&aio->cond,&aio->lock);
+        if (aio->stop)
+            break;
+        pthread_mutex_unlock (&aio->lock);
+        if (aio->write)
+            result = (writeFd(aio->fd,aio->data,aio->len)) ? (ssize_t)aio->len : -errno;
+        else
+        {
+            while ( ((result=read(aio->fd,aio->data,aio->len))<0) && (errno==EINTR) )
+                ;
+            if (result<0)
+                result = -errno;
+        }
+        pthread_mutex_lock (&aio->lock);
+        aio->result = result;
+        aio->state = ASYNCDONE;
+        pthread_cond_broadcast (&aio->cond);
+    }   /* for (;;) */
+    pthread_mutex_unlock (&aio->lock);
+
+    return (NULL);
+}
+
+
+/*****************************************************************************************/
+/* Start an asynchronous I/O engine on fd (option --async-io): io_uring, a helper thread */
+/* or, with ASYNCAUTO, io_uring when the kernel supports it and a helper thread         */
+/* otherwise. It returns NULL for ASYNCNONE                                              */
+/*****************************************************************************************/
+static asyncIo *openAsyncIo (int fd, int mode)
+{
+    /* Local Variables */
+    asyncIo    *aio;
+
+    if (mode==ASYNCNONE)
+        return (NULL);
+    if ( (aio=calloc(1,sizeof(asyncIo)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    aio->fd = fd;
+    aio->state = ASYNCIDLE;
+    if ( (mode!=ASYNCTHREAD) && openUring(aio) )
+        aio->mode = ASYNCURING;
+    else if (mode==ASYNCURING)
+    {
+        printf ("io_uring is not supported by this kernel (... --async-io uring)... Aborting\n\n");
+        exit (-1);
+    }
+    else
+    {
+        aio->mode = ASYNCTHREAD;
+        pthread_mutex_init (&aio->lock,NULL);
+        pthread_cond_init (&aio->cond,NULL);
+        if (pthread_create(&aio->thread,NULL,asyncWorker,aio)!=0)
+        {
+            printf ("Unable to create the I/O thread... Aborting\n\n");
+            exit (-1);
+        }
+    }
+
+    return (aio);
+}
+
+
+/*****************************************************************************************/
+/* Submit a request to the io_uring (user data 1 for reads and writes, 2 to cancel them) */
+/*****************************************************************************************/
+static void submitUring (asyncIo *aio, int opcode, uint64_t addr, size_t len, uint64_t userData)
+{
+    /* Local Variables */
+    struct io_uring_sqe    *sqe;
+    unsigned                tail, index;
+
+    tail = *aio->sqTail;
+    index = tail & *aio->sqMask;
+    sqe = &aio->sqes[index];
+    memset (sqe,0,sizeof(struct io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->fd = (opcode==IORING_OP_ASYNC_CANCEL) ? -1 : aio->fd;
+    sqe->addr = addr;
+    sqe->len = len;
+    sqe->off = (uint64_t)-1;                /* Current file position */
+    sqe->user_data = userData;
+    aio->sqArray[index] = index;
+    __atomic_store_n (aio->sqTail,tail+1,__ATOMIC_RELEASE);
+    while (syscall(__NR_io_uring_enter,aio->ringFd,1,0,0,NULL,0)<0)
+    {
+        if (errno!=EINTR)
+        {
+            printf ("Unable to submit an I/O request (%s)... Aborting\n\n",strerror(errno));
+            exit (-1);
+        }
+    }   /* while (syscall(__NR_io_uring_enter,aio->ringFd,1,0,0,NULL,0)<0) */
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Wait for the completion of the read or write request (user data 1) of the io_uring, */
+/* and return its result (completions of cancel requests are skipped)                   */
+/*****************************************************************************************/
+static ssize_t reapUring (asyncIo *aio)
+{
+    /* Local Variables */
+    struct io_uring_cqe    *cqe;
+    unsigned                head;
+    ssize_t                 result;
+
+    for (;;)
+    {
+        head = *aio->cqHead;
+        if (head==__atomic_load_n(aio->cqTail,__ATOMIC_ACQUIRE))
+        {
+            if ( (syscall(__NR_io_uring_enter,aio->ringFd,0,1,IORING_ENTER_GETEVENTS,NULL,0)<0) && (errno!=EINTR) )
+            {
+                printf ("Unable to wait for an I/O request (%s)... Aborting\n\n",strerror(errno));
+                exit (-1);
+            }
+            continue;
+        }
+        cqe = &aio->cqes[head & *aio->cqMask];
+        result = cqe->res;
+        __atomic_store_n (aio->cqHead,head+1,__ATOMIC_RELEASE);
+        if (cqe->user_data==1)
+            return (result);
+    }   /* for (;;) */
+}
+
+
+/*****************************************************************************************/
+/* Post a read or a write of len bytes at the current position of the file. Only one    */
+/* request can be in flight: waitAsyncIo() shall be called before the next one          */
+/*****************************************************************************************/
+static void submitAsyncIo (asyncIo *aio, bool write, char *data, size_t len)
+{
+    aio->write = write;
+    aio->data = data;
+    aio->len = len;
+    if (aio->mode==ASYNCTHREAD)
+    {
+        pthread_mutex_lock (&aio->lock);
+        aio->state = ASYNCQUEUED;
+        pthread_cond_broadcast (&aio->cond);
+        pthread_mutex_unlock (&aio->lock);
+        return;
+    }
+
+    submitUring (aio,(write)?IORING_OP_WRITE:IORING_OP_READ,(uint64_t)(uintptr_t)data,len,1);
+    aio->state = ASYNCQUEUED;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Wait for the request in flight (if any). It returns the bytes transferred (0 if no   */
+/* request was in flight), or -errno                                                     */
+/*****************************************************************************************/
+static ssize_t waitAsyncIo (asyncIo *aio)
+{
+    /* Local Variables */
+    ssize_t     result;
+
+    if (aio->state==ASYNCIDLE)
+        return (0);
+    if (aio->mode==ASYNCTHREAD)
+    {
+        pthread_mutex_lock (&aio->lock);
+        while (aio->state!=ASYNCDONE)
+            pthread_cond_wait (&aio->cond,&aio->lock);
+        result = aio->result;
+        aio->state = ASYNCIDLE;
+        pthread_mutex_unlock (&aio->lock);
+        return (result);
+    }
+
+    result = reapUring (aio);
+    aio->state = ASYNCIDLE;
+
+    return (result);
+}
+
+
+/*****************************************************************************************/
+/* Stop an asynchronous I/O engine. A read still in flight (e.g. on a pipe, when the    */
+/* parser stopped early) is cancelled, so that its buffer can be released               */
+/*****************************************************************************************/
+static void closeAsyncIo (asyncIo *aio)
+{
+    if (aio==NULL)
+        return;
+    if (aio->mode==ASYNCURING)
+    {
+        if (aio->state==ASYNCQUEUED)
+        {
+            submitUring (aio,IORING_OP_ASYNC_CANCEL,1,0,2);
+            reapUring (aio);
+        }
+        munmap (aio->sqes,aio->sqeSize);
+        if (aio->cqRing!=aio->sqRing)
+            munmap (aio->cqRing,aio->cqRingSize);
+        munmap (aio->sqRing,aio->sqRingSize);
+        close (aio->ringFd);
+    }
+    else
+    {
+        pthread_mutex_lock (&aio->lock);
+        aio->stop = true;
+        pthread_cond_broadcast (&aio->cond);
+        if (aio->state==ASYNCQUEUED)
+            pthread_cancel (aio->thread);
+        pthread_mutex_unlock (&aio->lock);
+        pthread_join (aio->thread,NULL);
+        pthread_mutex_destroy (&aio->lock);
+        pthread_cond_destroy (&aio->cond);
+    }
+    free (aio);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Open the input CSV file ("-" stands for the standard input). Regular files are memory */
+/* mapped, so that fields can be kept as (pointer, length) views into the mapping without */
+/* copying them; any other kind of input (e.g. a pipe) is streamed through a window that  */
+/* is refilled by fillInputCsv(), so that memory does not depend on the input size. A    */
+/* gzip or zstd compressed input (recognized by its first bytes) is streamed too, from a  */
+/* pipe filled by a thread decompressing it                                               */
+/*****************************************************************************************/
+static void openInputCsv (inputCsv *in, char *inputCsvFile)
+{
+    /* Local Variables */
+    int         fd;
+    struct stat st;
+    char        magic[4];
+    ssize_t     got;
+    size_t      magicLen = 0;
+    bool        regular;
+
+    if (strcmp(inputCsvFile,"-")==0)
+        fd = STDIN_FILENO;
+    else if ( (fd=open(inputCsvFile,O_RDONLY))<0 )
+    {
+        printf ("Unable to open input CSV File... Aborting\n\n");
+        exit (-1);
+    }
+
+    memset (in,0,sizeof(inputCsv));
+    in->fd = -1;
+    in->prefetch = SIZE_MAX;                    /* See startAsyncInput() */
+    regular = ( (fstat(fd,&st)==0) && S_ISREG(st.st_mode) );
+    while (magicLen<sizeof(magic))
+    {   /* The bytes read from a stream are not lost: they are passed to the codec */
+        /* thread or copied to the window below                                     */
+        got = (regular) ? pread(fd,magic+magicLen,sizeof(magic)-magicLen,magicLen) : read(fd,magic+magicLen,sizeof(magic)-magicLen);
+        if ( (got<0) && (errno==EINTR) )
+            continue;
+        if (got<=0)
+        {
+            in->eof = (got==0) && !regular;
+            break;
+        }
+        magicLen += got;
+    }   /* while (magicLen<sizeof(magic)) */
+    if (detectCodec((unsigned char *)magic,magicLen)!=CODECNONE)
+    {
+        in->fd = startCodec (&in->codec,detectCodec((unsigned char *)magic,magicLen),false,fd,magic,(regular)?0:magicLen,SYNCNONE);
+        in->stream = true;
+        in->eof = false;
+        in->cap = INBUFSIZE;
+        if ( (in->data=malloc(in->cap))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+        return;
+    }   /* if (detectCodec((unsigned char *)magic,magicLen)!=CODECNONE) */
+    if ( regular && (st.st_size>0) )
+    {
+        in->data = mmap (NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+        if (in->data!=MAP_FAILED)
+        {
+            in->size = st.st_size;
+            in->mapped = true;
+            madvise (in->data,in->size,MADV_SEQUENTIAL);
+            if (fd!=STDIN_FILENO)
+                close (fd);
+            return;
+        }
+        in->data = NULL;
+    }
+
+    /* Not a regular file (or mmap not available): stream it */
+    in->stream = true;
+    in->fd = fd;
+    in->cap = INBUFSIZE;
+    if ( (in->data=malloc(in->cap))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    if (!regular)
+    {
+        memcpy (in->data,magic,magicLen);
+        in->size = magicLen;
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Update a pointer into the window of a streamed input after the window was moved       */
+/* (oldData is its previous address) and its first shift bytes were discarded           */
+/*****************************************************************************************/
+static inline void rebaseView (char **ptr, char *oldData, size_t oldSize, char *newData, size_t shift)
+{
+    if ( (*ptr>=oldData) && (*ptr<=oldData+oldSize) )
+        *ptr = newData + ((*ptr-oldData) - shift);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Read up to len bytes of a streamed input: directly, or from the read ahead buffers   */
+/* (see startAsyncInput()). When the current buffer has been consumed, the one being    */
+/* read becomes the current one and the read of the next block is posted                */
+/*****************************************************************************************/
+static ssize_t readInputCsv (inputCsv *in, char *data, size_t len)
+{
+    /* Local Variables */
+    ssize_t got;
+
+    if (in->aio==NULL)
+        return (read(in->fd,data,len));
+
+    if (in->aheadPos==in->aheadLen)
+    {
+        if (in->aio->state==ASYNCIDLE)
+            submitAsyncIo (in->aio,false,in->ahead[in->current^1],READAHEADSIZE);
+        if ( (got=waitAsyncIo(in->aio))<=0 )
+        {
+            errno = -got;
+            return ( (got==0) ? 0 : -1 );
+        }
+        in->current ^= 1;
+        in->aheadPos = 0;
+        in->aheadLen = got;
+        submitAsyncIo (in->aio,false,in->ahead[in->current^1],READAHEADSIZE);
+    }   /* if (in->aheadPos==in->aheadLen) */
+    got = (len<in->aheadLen-in->aheadPos) ? len : in->aheadLen-in->aheadPos;
+    memcpy (data,in->ahead[in->current]+in->aheadPos,got);
+    in->aheadPos += got;
+
+    return (got);
+}
+
+
+/*****************************************************************************************/
+/* Read more data from a streamed input, until the window contains a whole line starting */
+/* at the current position (or the end of the input is reached). The bytes of the rows  */
+/* already processed are discarded first; the window grows only if a single row does not */
+/* fit in it. Fields of the current row which are views into the window are moved too   */
+/*****************************************************************************************/
+static void fillInputCsv (csvParser *ps)
+{
+    /* Local Variables */
+    inputCsv   *in = &ps->in;
+    char       *oldData, *eol;
+    size_t      from, shift, oldSize;
+    ssize_t     got;
+    int         i;
+
+    if ( in->mapped && (in->pos>=in->prefetch) && (in->pos<in->size) )
+    {   /* Ask the kernel to read the next part of the input ahead of the parser */
+        from = in->pos - in->pos%sysconf(_SC_PAGESIZE);
+        madvise (in->data+from,((in->size-from<PREFETCHSIZE)?in->size-from:PREFETCHSIZE),MADV_WILLNEED);
+        in->prefetch = in->pos + PREFETCHSIZE/2;
+    }
+    if (!in->stream)
+        return;
+
+    for (;;)
+    {
+        from = (in->scanned>in->pos) ? in->scanned : in->pos;
+        if ( (eol=memchr(in->data+from,'\n',in->size-from))!=NULL )
+        {
+            in->scanned = eol - in->data;
+            return;
+        }
+        in->scanned = in->size;
+        if (in->eof)
+            return;
+
+        if (in->size==in->cap)
+        {   /* The window is full: discard the rows already processed, or make it larger */
+            oldData = in->data;
+            oldSize = in->size;
+            shift = in->keep;
+            if (shift>0)
+                memmove (in->data,in->data+shift,in->size-shift);
+            else
+            {
+                in->cap *= 2;
+                if ( (in->data=realloc(in->data,in->cap))==NULL )
+                {
+                    printf ("Memory allocation failure... Aborting\n\n");
+                    exit (-1);
+                }
+            }
+            in->size -= shift;
+            in->pos -= shift;
+            in->scanned -= shift;
+            in->keep = 0;
+            for (i=0; (i<ps->fieldNo) && !ps->skipFields && ((ps->fieldWanted==NULL) || (i<ps->fieldLimit)); i++)
+                rebaseView (&ps->fields[i].ptr,oldData,oldSize,in->data,shift);
+            if (!ps->curCopied)
+                rebaseView (&ps->curPtr,oldData,oldSize,in->data,shift);
+            ps->nextMultiLine = NULL;
+        }   /* if (in->size==in->cap) */
+
+        if ( (got=readInputCsv(in,in->data+in->size,in->cap-in->size))<0 )
+        {
+            if (errno==EINTR)
+                continue;
+            printf ("Error reading input CSV File (%s)... Aborting\n\n",strerror(errno));
+            exit (-1);
+        }
+        if (got==0)
+            in->eof = true;
+        in->size += got;
+    }   /* for (;;) */
+}
+
+
+/*****************************************************************************************/
+/* Release the input CSV file (unmap it or free the memory used to read it, and stop the */
+/* decompression of a compressed input)                                                  */
+/*****************************************************************************************/
+static void closeInputCsv (inputCsv *in)
+{
+    if (in->mapped)
+        munmap (in->data,in->size);
+    else
+        free (in->data);
+    if (in->aio!=NULL)
+    {
+        closeAsyncIo (in->aio);
+        free (in->ahead[0]);
+        free (in->ahead[1]);
+        in->aio = NULL;
+    }
+    if (in->codec!=NULL)
+        stopCodec (&in->codec,in->fd);
+    else if ( (in->stream) && (in->fd!=STDIN_FILENO) )
+        close (in->fd);
+    in->data = NULL;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Overlap the reads of the input with parsing (option --async-io). A streamed input is  */
+/* read ahead by an asynchronous I/O engine into two buffers: the next block is read    */
+/* while the current one is parsed. For a mapped input the kernel is asked to read the  */
+/* part of the file following the current position (see fillInputCsv())                 */
+/*****************************************************************************************/
+static void startAsyncInput (inputCsv *in, int mode)
+{
+    if (mode==ASYNCNONE)
+        return;
+    if (in->mapped)
+    {
+        in->prefetch = 0;
+        return;
+    }
+    if ( !in->stream || (in->codec!=NULL) )     /* A decompressed input has its own thread */
+        return;
+    if ( ((in->ahead[0]=malloc(READAHEADSIZE))==NULL) || ((in->ahead[1]=malloc(READAHEADSIZE))==NULL) )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    in->aio = openAsyncIo (in->fd,mode);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Return the current time in ns (monotonic clock), used for --stats                     */
+/*****************************************************************************************/
+static inline uint64_t statsClock (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC,&ts);
+    return ((uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec);
+}
+
+
+/*****************************************************************************************/
+/* Add the time elapsed since start to the given stage counter and return the current    */
+/* time, so that consecutive stages can be measured with a single clock read each        */
+/*****************************************************************************************/
+static inline uint64_t statsLap (uint64_t *stage, uint64_t start)
+{
+    uint64_t t = statsClock();
+
+    *stage += t - start;
+    return (t);
+}
+
+
+/*****************************************************************************************/
+/* Add len bytes to a 64 bit hash (options --incremental and --where). Eight bytes are   */
+/* mixed at once, so that hashing a row costs much less than rendering it                */
+/*****************************************************************************************/
+static uint64_t hashBytes (uint64_t hash, const void *data, size_t len)
+{
+    /* Local Variables */
+    const unsigned char *p = data;
+    uint64_t            word;
+
+    while (len>=8)
+    {
+        memcpy (&word,p,8);
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 29;
+        p += 8;
+        len -= 8;
+    }   /* while (len>=8) */
+    while (len>0)
+    {
+        hash = (hash ^ *p++) * 1099511628211ULL;
+        len -= 1;
+    }   /* while (len>0) */
+
+    return (hash);
+}
+
+
+/*****************************************************************************************/
+/* Allocate len bytes from the per-row arena. Blocks are never freed: when the arena is  */
+/* reset they are reused, so that in steady state parsing a row requires no malloc()     */
+/*****************************************************************************************/
+static char *arenaAlloc (rowArena *arena, size_t len)
+{
+    /* Local Variables */
+    arenaBlock *block;
+    size_t      size;
+
+    block = arena->current;
+    if ( (block!=NULL) && (len<=block->size-block->used) )
+    {
+        block->used += len;
+        return (block->data + block->used - len);
+    }
+
+    /* Move to the next block that is large enough, allocating it if needed */
+    while ( (block!=NULL) && (block->next!=NULL) )
+    {
+        block = block->next;
+        block->used = 0;
+        if (len<=block->size)
+        {
+            arena->current = block;
+            block->used = len;
+            return (block->data);
+        }
+    }   /* while ( (block!=NULL) && (block->next!=NULL) ) */
+
+    size = (2*len>ARENABLOCKSIZE) ? 2*len : ARENABLOCKSIZE;
+    if ( (block=malloc(sizeof(arenaBlock)+size))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    block->size = size;
+    block->used = len;
+    block->next = NULL;
+    if (arena->current==NULL)
+        arena->first = block;
+    else
+    {   /* Append the new block at the end of the list, so that it is reused later */
+        block->next = arena->current->next;
+        arena->current->next = block;
+    }
+    arena->current = block;
+
+    return (block->data);
+}
+
+
+/*****************************************************************************************/
+/* Grow the last allocation of the arena (ptr, oldLen bytes) to newLen bytes. The        */
+/* allocation is extended in place when possible, otherwise it is moved                  */
+/*****************************************************************************************/
+static char *arenaGrow (rowArena *arena, char *ptr, size_t oldLen, size_t newLen)
+{
+    /* Local Variables */
+    arenaBlock *block = arena->current;
+    char       *newPtr;
+
+    if ( (block!=NULL) && (ptr+oldLen==block->data+block->used) && (newLen-oldLen<=block->size-block->used) )
+    {
+        block->used += newLen-oldLen;
+        return (ptr);
+    }
+    newPtr = arenaAlloc (arena,2*newLen);
+    arena->current->used -= newLen;     /* Keep room to grow further in place */
+    if (oldLen>0)
+        memcpy (newPtr,ptr,oldLen);
+
+    return (newPtr);
+}
+
+
+/*****************************************************************************************/
+/* Release all the allocations of the arena (blocks are kept for the next rows)          */
+/*****************************************************************************************/
+static inline void arenaReset (rowArena *arena)
+{
+    if (arena->first!=NULL)
+        arena->first->used = 0;
+    arena->current = arena->first;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Make room in the structural index of the current line for at least n more entries    */
+/*****************************************************************************************/
+static inline void reserveStructs (csvParser *ps, size_t n)
+{
+    if (ps->structNo+n<=ps->structCap)
+        return;
+    ps->structCap = (ps->structCap>0) ? 2*ps->structCap+n : 256+n;
+    if ( (ps->structs=realloc(ps->structs,ps->structCap*sizeof(char *)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Add to the structural index a separator or multi line character found at position e. */
+/* Two adjacent multi line characters mean that the line needs removeDoubleMultiLineChar */
+/*****************************************************************************************/
+static inline void pushStruct (csvParser *ps, char *e)
+{
+    if (*e==ps->multiLine)
+    {
+        if (e==ps->lastMultiLine+1)
+            ps->doubleMultiLine = true;
+        ps->lastMultiLine = e;
+    }
+    ps->structs[ps->structNo++] = e;
+
+    return;
+}
+
+
+/******************************************************************************************/
+/* Structural scanner (scalar version). It classifies the bytes from p up to limit by     */
+/* means of a lookup table, stopping at the first end of line character (CR, LF or null). */
+/* Separators and multi line characters found on the way are added to the structural     */
+/* index; the function returns the position of the end of line (or limit)                 */
+/******************************************************************************************/
+static char *scanLineScalar (csvParser *ps, char *p, char *limit)
+{
+    for (; p<limit; p++)
+    {
+        switch (ps->charClass[(unsigned char)*p])
+        {
+            case CHARSTRUCT:
+                reserveStructs (ps,1);
+                pushStruct (ps,p);
+                break;
+            case CHAREOL:
+                return (p);
+            default:
+                break;
+        }   /* switch (ps->charClass[(unsigned char)*p]) */
+    }   /* for (; p<limit; p++) */
+
+    return (limit);
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+/******************************************************************************************/
+/* Structural scanner (SSE2 version). Same as scanLineScalar(), but the bytes are         */
+/* classified 16 at a time; the tail of the input (less than 16 bytes) is left to the     */
+/* scalar version, so that no byte beyond limit is ever read                              */
+/******************************************************************************************/
+__attribute__((target("sse2")))
+static char *scanLineSse2 (csvParser *ps, char *p, char *limit)
+{
+    /* Local Variables */
+    __m128i     block,
+                separator = _mm_set1_epi8 (ps->separator),
+                multiLine = _mm_set1_epi8 (ps->multiLine),
+                lf = _mm_set1_epi8 ('\n'),
+                cr = _mm_set1_epi8 ('\r'),
+                nul = _mm_setzero_si128 ();
+    unsigned    eolMask, structMask;
+
+    while (limit-p>=16)
+    {
+        block = _mm_loadu_si128 ((const __m128i *)p);
+        eolMask = _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8(block,lf),_mm_cmpeq_epi8(block,cr)),
+                                                   _mm_cmpeq_epi8(block,nul)));
+        structMask = _mm_movemask_epi8 (_mm_or_si128 (_mm_cmpeq_epi8(block,separator),_mm_cmpeq_epi8(block,multiLine)));
+        if (eolMask)
+            structMask &= (eolMask & -eolMask) - 1;     /* Keep only what precedes the end of line */
+        reserveStructs (ps,16);
+        while (structMask)
+        {
+            pushStruct (ps,p+__builtin_ctz(structMask));
+            structMask &= structMask-1;
+        }
+        if (eolMask)
+            return (p+__builtin_ctz(eolMask));
+        p += 16;
+    }   /* while (limit-p>=16) */
+
+    return (scanLineScalar(ps,p,limit));
+}
+
+
+/******************************************************************************************/
+/* Structural scanner (AVX2 version). Same as scanLineSse2(), with 32 bytes at a time     */
+/******************************************************************************************/
+__attribute__((target("avx2")))
+static char *scanLineAvx2 (csvParser *ps, char *p, char *limit)
+{
+    /* Local Variables */
+    __m256i     block,
+                separator = _mm256_set1_epi8 (ps->separator),
+                multiLine = _mm256_set1_epi8 (ps->multiLine),
+                lf = _mm256_set1_epi8 ('\n'),
+                cr = _mm256_set1_epi8 ('\r'),
+                nul = _mm256_setzero_si256 ();
+    unsigned    eolMask, structMask;
+
+    while (limit-p>=32)
+    {
+        block = _mm256_loadu_si256 ((const __m256i *)p);
+        eolMask = _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8(block,lf),_mm256_cmpeq_epi8(block,cr)),
+                                                         _mm256_cmpeq_epi8(block,nul)));
+        structMask = _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_cmpeq_epi8(block,separator),_mm256_cmpeq_epi8(block,multiLine)));
+        if (eolMask)
+            structMask &= (eolMask & -eolMask) - 1;     /* Keep only what precedes the end of line */
+        reserveStructs (ps,32);
+        while (structMask)
+        {
+            pushStruct (ps,p+__builtin_ctz(structMask));
+            structMask &= structMask-1;
+        }
+        if (eolMask)
+            return (p+__builtin_ctz(eolMask));
+        p += 32;
+    }   /* while (limit-p>=32) */
+
+    return (scanLineSse2(ps,p,limit));
+}
+#endif  /* defined(__x86_64__) || defined(__i386__) */
+
+
+/******************************************************************************************/
+/* Select the structural scanner and initialize its lookup table, as well as the table of */
+/* transitions of the RFC 4180 parser. With SCANAUTO the best implementation supported by */
+/* the CPU is chosen at runtime. It returns false if the requested implementation is not  */
+/* available                                                                              */
+/******************************************************************************************/
+static bool initScanner (csvParser *ps, int scanner)
+{
+    /* Local Variables */
+    int         state;
+
+    /* Transitions of the RFC 4180 parser for the byte classes: other, separator, quote  */
+    /* (the multi line character) and LF. CR is an ordinary byte, but it is dropped from */
+    /* the end of the last field of a row (CR LF line terminator)                        */
+    static const unsigned char rfcTable[RFCSTATES][4] =
+    {   /* RFCSTART  */ { RFCNEXT(RFCPLAIN,RFCBEGIN),  RFCNEXT(RFCSTART,RFCCLOSE), RFCNEXT(RFCQUOTED,RFCOPEN),  RFCNEXT(RFCSTART,RFCENDROW) },
+        /* RFCPLAIN  */ { RFCNEXT(RFCPLAIN,RFCNONE),   RFCNEXT(RFCSTART,RFCFIELD), RFCNEXT(RFCPLAIN,RFCNONE),   RFCNEXT(RFCSTART,RFCROW)    },
+        /* RFCQUOTED */ { RFCNEXT(RFCQUOTED,RFCNONE),  RFCNEXT(RFCQUOTED,RFCNONE), RFCNEXT(RFCQUOTE,RFCAPPEND), RFCNEXT(RFCQUOTED,RFCLINE) },
+        /* RFCQUOTE  */ { RFCNEXT(RFCPLAIN,RFCBEGIN),  RFCNEXT(RFCSTART,RFCCLOSE), RFCNEXT(RFCQUOTED,RFCBEGIN), RFCNEXT(RFCSTART,RFCENDROW) } };
+
+    for (state=0; state<RFCSTATES; state++)
+    {
+        memset (ps->rfcDfa[state],rfcTable[state][0],256);
+        ps->rfcDfa[state][(unsigned char)ps->separator] = rfcTable[state][1];
+        ps->rfcDfa[state][(unsigned char)ps->multiLine] = rfcTable[state][2];
+        ps->rfcDfa[state]['\n'] = rfcTable[state][3];
+    }   /* for (state=0; state<RFCSTATES; state++) */
+
+    memset (ps->charClass,CHARNONE,sizeof(ps->charClass));
+    ps->charClass[(unsigned char)ps->separator] = CHARSTRUCT;
+    ps->charClass[(unsigned char)ps->multiLine] = CHARSTRUCT;
+    ps->charClass['\n'] = CHAREOL;
+    ps->charClass['\r'] = CHAREOL;
+    ps->charClass['\0'] = CHAREOL;
+
+    ps->scanLine = scanLineScalar;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init ();
+    if ( (scanner==SCANAVX2) || ((scanner==SCANAUTO) && __builtin_cpu_supports("avx2")) )
+    {
+        if (!__builtin_cpu_supports("avx2"))
+            return (false);
+        ps->scanLine = scanLineAvx2;
+    }
+    else if ( (scanner==SCANSSE2) || (scanner==SCANAUTO) )
+    {
+        if (!__builtin_cpu_supports("sse2"))
+            return (false);
+        ps->scanLine = scanLineSse2;
+    }
+#else
+    if ( (scanner==SCANSSE2) || (scanner==SCANAVX2) )
+        return (false);
+#endif
+
+    return (true);
+}
+
+
+/*****************************************************************************************/
+/* Build the structural index of the line from p to limit (a line that has already been */
+/* isolated, such as the copy made by removeDoubleMultiLineChar()). It returns the end  */
+/* of the line content                                                                   */
+/*****************************************************************************************/
+static inline char *indexLine (csvParser *ps, char *p, char *limit)
+{
+    ps->structNo = 0;
+    ps->structPos = 0;
+    ps->lastMultiLine = NULL;
+    ps->doubleMultiLine = false;
+
+    return (ps->scanLine(ps,p,limit));
+}
+
+
+/******************************************************************************************/
+/* Return the next line of the input CSV file (line is not null terminated), building its */
+/* structural index in the same pass. As with the previous fgets() based implementation,  */
+/* the line is truncated at the first CR or LF (or null character). It returns false when */
+/* the end of the input file is reached                                                   */
+/******************************************************************************************/
+static bool readCsvLine (csvParser *ps, char **line, size_t *len)
+{
+    /* Local Variables */
+    inputCsv   *in = &ps->in;
+    char       *p, *end;
+
+    fillInputCsv (ps);
+    if (in->pos>=in->size)
+        return (false);
+
+    *line = in->data + in->pos;
+    end = in->data + in->size;
+    p = indexLine (ps,*line,end);
+    *len = p - *line;
+    if ( (p<end) && (*p!='\n') && ((p=memchr(p,'\n',end-p))==NULL) )
+        p = end;
+    p = (p<end) ? p+1 : end;
+    if (ps->stats)
+    {
+        ps->stats->bytesIn += p - *line;
+        if (*len>ps->stats->longestLine)
+            ps->stats->longestLine = *len;
+    }
+    in->pos = p - in->data;
+
+    return (true);
+}
+
+
+/*********************************************************************************************/
+/* Append len bytes to the field currently being built (fields[fieldNo]). As long as the     */
+/* pieces are contiguous, the field remains a view into the input file (or into the copy of  */
+/* the line made by removeDoubleMultiLineChar()); bytes are copied into the arena only when  */
+/* this is not possible, e.g. when a multi line field spans lines terminated by CR LF        */
+/*********************************************************************************************/
+static void appendToField (csvParser *ps, char *p, size_t len)
+{
+    if (ps->curSkipped)
+        return;
+    if ( (!ps->curCopied) && (ps->curLen==0) )
+    {
+        ps->curPtr = p;
+        ps->curLen = len;
+        return;
+    }
+    if ( (!ps->curCopied) && (ps->curPtr+ps->curLen==p) )
+    {
+        ps->curLen += len;
+        return;
+    }
+
+    /* The field cannot be a simple view any longer: copy it into the arena */
+    if (!ps->curCopied)
+    {
+        ps->curPtr = memcpy (arenaGrow(&ps->arena,NULL,0,ps->curLen+len),ps->curPtr,ps->curLen);
+        ps->curCopied = true;
+    }
+    else
+        ps->curPtr = arenaGrow (&ps->arena,ps->curPtr,ps->curLen,ps->curLen+len);
+    memcpy (ps->curPtr+ps->curLen,p,len);
+    ps->curLen += len;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Append a newline to the field currently being built. If the field is a view into the */
+/* input and it is followed by the LF that terminated the line, the view is just extended */
+/*****************************************************************************************/
+static void appendNewlineToField (csvParser *ps)
+{
+    if (ps->curSkipped)
+        return;
+    if ( (!ps->curCopied) && (ps->curPtr>=ps->in.data) && (ps->curPtr+ps->curLen<ps->in.data+ps->in.size) &&
+         (ps->curPtr[ps->curLen]=='\n') )
+        ps->curLen += 1;
+    else
+        appendToField (ps,"\n",1);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Evaluate the row filters (option --where) testing the given field, stopping at the    */
+/* first one that fails. It returns false if the row shall be rejected                   */
+/*****************************************************************************************/
+static bool testPredicates (csvParser *ps, int fieldNo, char *ptr, size_t len)
+{
+    /* Local Variables */
+    rowPredicate   *pred;
+    char            number[64], *end;
+    double          value = 0;
+    size_t          b, mask;
+    bool            numeric = false,
+                    found;
+    int             k;
+
+    for (k=ps->firstPredicate[fieldNo]; (k<ps->predicateNo) && (ps->predicates[k].field==fieldNo); k++)
+    {
+        pred = &ps->predicates[k];
+        switch (pred->op)
+        {
+            case WHEREEQ:
+            case WHERENE:
+                found = ( (len==pred->valueLen) && (memcmp(ptr,pred->value,len)==0) );
+                if (found!=(pred->op==WHEREEQ))
+                    return (false);
+                break;
+            case WHEREPREFIX:
+                if ( (len<pred->valueLen) || (memcmp(ptr,pred->value,pred->valueLen)!=0) )
+                    return (false);
+                break;
+            case WHEREIN:
+                mask = pred->bucketNo - 1;
+                found = false;
+                for (b=hashBytes(14695981039346656037ULL,ptr,len)&mask; !found && (pred->buckets[b]!=0); b=(b+1)&mask)
+                    found = ( (pred->values[pred->buckets[b]-1].len==len) && (memcmp(pred->values[pred->buckets[b]-1].ptr,ptr,len)==0) );
+                if (!found)
+                    return (false);
+                break;
+            default:
+            {   /* Numeric comparisons: fields that are not numbers never match */
+                if (!numeric)
+                {
+                    if ( (len==0) || (len>=sizeof(number)) )
+                        return (false);
+                    memcpy (number,ptr,len);
+                    number[len] = '\0';
+                    value = strtod (number,&end);
+                    if (*end!='\0')
+                        return (false);
+                    numeric = true;
+                }
+                if ( ((pred->op==WHERELT) && !(value<pred->number)) || ((pred->op==WHERELE) && !(value<=pred->number)) ||
+                     ((pred->op==WHEREGT) && !(value>pred->number)) || ((pred->op==WHEREGE) && !(value>=pred->number)) )
+                    return (false);
+                break;
+            }   /* default */
+        }   /* switch (pred->op) */
+    }   /* for (k=ps->firstPredicate[fieldNo]; ... */
+
+    return (true);
+}
+
+
+/*****************************************************************************************/
+/* Tell whether the given field shall not be stored (option -j while looking for row     */
+/* boundaries, a field not referenced by the templates or a row rejected by --where)     */
+/*****************************************************************************************/
+static inline bool skippedField (csvParser *ps, int fieldNo)
+{
+    return ( ps->skipFields || ps->rejected || ((ps->fieldWanted!=NULL) && ((fieldNo>=ps->fieldLimit) || !ps->fieldWanted[fieldNo])) );
+}
+
+
+/*****************************************************************************************/
+/* Close the field currently being built and move to the next one, which starts empty.   */
+/* The fields array grows as needed, so that there is no limit on the number of columns  */
+/* Fields not referenced by the templates are stored as empty views (nothing is copied), */
+/* those after the last referenced one are not stored at all                             */
+/*****************************************************************************************/
+static void closeField (csvParser *ps)
+{
+    if ( ps->skipFields || ((ps->fieldWanted!=NULL) && (ps->fieldNo>=ps->fieldLimit)) )
+    {
+        ps->fieldNo += 1;
+        return;
+    }
+    if (ps->fieldNo+1>=ps->fieldCap)
+    {
+        ps->fieldCap = (ps->fieldCap>0) ? 2*ps->fieldCap : INITFIELDS;
+        if ( (ps->fields=realloc(ps->fields,ps->fieldCap*sizeof(fieldView)))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+    }
+    if (ps->curSkipped)
+    {
+        ps->fields[ps->fieldNo].ptr = "";
+        ps->fields[ps->fieldNo].len = 0;
+    }
+    else
+    {
+        ps->fields[ps->fieldNo].ptr = ps->curPtr;
+        ps->fields[ps->fieldNo].len = ps->curLen;
+        if ( (ps->stats) && (ps->curLen>ps->stats->longestField) )
+            ps->stats->longestField = ps->curLen;
+        if ( (ps->firstPredicate!=NULL) && (ps->firstPredicate[ps->fieldNo]>=0) )
+            ps->rejected = !testPredicates (ps,ps->fieldNo,ps->curPtr,ps->curLen);
+    }
+    ps->fieldNo += 1;
+    ps->fields[ps->fieldNo].ptr = "";
+    ps->fields[ps->fieldNo].len = 0;
+    ps->curPtr = NULL;
+    ps->curLen = 0;
+    ps->curCopied = false;
+    ps->curSkipped = skippedField (ps,ps->fieldNo);
+
+    return;
+}
+
+
+/******************************************************************************************/
+/* This function removes all double occurences of the multi line character from the line  */
+/* passed as first argument. Since the input file is never modified, if there is any      */
+/* double occurence the line is copied into the arena and line/len are updated to refer   */
+/* to the copy (that remains valid until the end of the row), then the copy is indexed    */
+/******************************************************************************************/
+static void removeDoubleMultiLineChar (csvParser *ps, char **line, size_t *len)
+{
+    /* Local Variables */
+    char        *p, *q, *end, *copy;
+
+    if (!ps->doubleMultiLine)       /* Detected by the structural scanner */
+        return;
+
+    /* Remove all double occurences of multi line character */
+    p = *line;
+    end = *line + *len;
+    q = copy = arenaAlloc (&ps->arena,*len);
+    while (p<end)
+    {
+        *q = *p;
+        if ( (*p==ps->multiLine) && (p+1<end) && (*(p+1)==ps->multiLine) )
+            p += 1;
+        p += 1;
+        q += 1;
+    }   /* while (p<end) */
+
+    *line = copy;
+    *len = q - copy;
+    indexLine (ps,copy,q);      /* The structural index shall refer to the copy */
+
+    return;
+}
+
+
+/*********************************************************************************************/
+/* Scan the current line read from input CSV file and fills the fields[] array               */
+/* This function is invoked by the main loop when in single line mode                        */
+/* It exits when one of the following conditions occur:                                      */
+/* - EOL is reached (in this case it returns false, i.e. it stays in single line mode)       */
+/* - a delimiter is found at the beginning of the current field (in this case it returns     */
+/*   true, i.e. it switches to multiline mode). Upon return, control is taken by the         */
+/*   complementary function scanMultiLine()                                                  */
+/* Remember that all double delimiters have been removed by removeDoubleMultiLineChar(), so  */
+/* that we do not have to worry about that (i.e., if a delimiter is found within a field,    */
+/* neither at the beginning nor at the end, but in the middle, it means that in the original */
+/* line there was a double delimiter)                                                        */
+/*********************************************************************************************/
+static bool scanSingleLine (csvParser *ps, char **pp, char *end)
+{
+    /* This function is invoked from the main loop when we are not in multi line mode */
+    /* p points to the char we are currently scanning, end to the end of the line.    */
+    /* Separators and multi line characters are taken from the structural index of   */
+    /* the line, so that the line is never scanned again char-by-char                 */
+
+    /* Local Variables */
+    char   *q, *r, *p;
+    size_t  k;
+    bool    withinQuotes;
+
+    /* Initialization */
+    p = *pp;
+    /* Go through the line, structural character by structural character */
+    while (p<end)
+    {
+        if ( (ps->rejected || ((ps->fieldWanted!=NULL) && (ps->fieldNo>=ps->fieldLimit))) && (ps->lastMultiLine<p) )
+        {   /* All the fields referenced by the templates have been found (or the row   */
+            /* was rejected by a row filter), and the rest of the line has no multi    */
+            /* line character: the row ends with this line                             */
+            p = end;
+            break;
+        }
+        while ( (ps->structPos<ps->structNo) && (ps->structs[ps->structPos]<p) )
+            ps->structPos += 1;
+        q = (ps->structPos<ps->structNo) ? ps->structs[ps->structPos] : NULL;
+        if ( (q==NULL) || (*q==ps->separator) )
+        {   /* This field does not contain the multi line delimiter */
+            appendToField (ps,p,((q)?q:end)-p);
+            closeField (ps);
+            if (q)
+                p = q+1;
+            else
+                p = end;
+            continue;
+        }   /* if ( (q==NULL) || (*q==ps->separator) ) */
+        /* We reach this point only if this field contains the multi line */
+        /* delimiter before the separator and/or the EOL (note that so    */
+        /* far we are in no multi line mode)                              */
+        r = q;
+        if (r==p)
+        {   /* Special case: the delimiter is the first char of the field */
+            /* -> reset pointer p to the first char after the delimiter   */
+            /* and switch to multi line mode                              */
+            p = r+1;
+            appendToField (ps,p,0);
+            *pp = p;
+            return (true);
+        }
+        /* We are here because there is at least a multiline delimiter */
+        /* before the next separator (or the EOL). Go on starting from */
+        /* current position (p) and consider as only separator         */
+        /* characters that are not included in multi line as actual    */
+        /* separators                                                  */
+        withinQuotes = false;   /* single line mode -> we start with withinQuotes = false */
+        for (k=ps->structPos; k<ps->structNo; k++)
+        {
+            q = ps->structs[k];
+            if (*q==ps->multiLine)
+                withinQuotes = withinQuotes?false:true;
+            if ( (*q==ps->separator) && (withinQuotes==false) )
+            {   /* we have found an actual separator, i.e. not enclosed within delimiters */
+                appendToField (ps,p,q-p);
+                closeField (ps);
+                p = q+1;
+                *pp = p;
+                return (false);
+            }   /* if ( (*q==ps->separator) && (withinQuotes==false) ) */
+        }   /* for (k=ps->structPos; k<ps->structNo; k++) */
+        appendToField (ps,p,end-p);
+        closeField (ps);
+        p = end;
+
+    }   /* while (p<end) */
+
+    /* The line is finished without switching to multi line mode */
+    *pp = p;
+    return (false);
+}
+
+
+/***********************************************************************************************/
+/* Scan the current line read from input CSV file and fills the fields[] array                 */
+/* This function is invoked by the main loop when in multi line mode                           */
+/* It exits when one of the following conditions occur:                                        */
+/* - EOL is reached (in this case it returns true, i.e. it stays in multi line mode)           */
+/* - a delimiter is found at the end of the current field (in this case it returns false,      */
+/*   i.e. it switches to single line mode). Upon return, control is taken by the complementary */
+/*   function scanSingleLine()                                                                 */
+/* Remember that all double delimiters have been removed by removeDoubleMultiLineChar(), so    */
+/* that we do not have to worry about that (i.e., if a delimiter is found within a field,      */
+/* neither at the beginning nor at the end, but in the middle, it means that in the original   */
+/* line there was a double delimiter)                                                          */
+/***********************************************************************************************/
+static bool scanMultiLine (csvParser *ps, char **pp, char *end)
+{
+    /* This function is invoked from the main loop when we are in multi line mode */
+    /* p points to the char we are currently scanning, end to the end of the line */
+    /* Separators and multi line characters are taken from the structural index  */
+
+    /* Local Variables */
+    char   *r, *p;
+    size_t  k, len;
+    bool    withinQuotes;
+
+    /* Initialization */
+    p = *pp;
+
+    /* Go through the line, structural character by structural character */
+    while (p<end)
+    {
+        while ( (ps->structPos<ps->structNo) && (ps->structs[ps->structPos]<p) )
+            ps->structPos += 1;
+        for (k=ps->structPos; (k<ps->structNo) && (*ps->structs[k]!=ps->multiLine); k++)
+            ;
+        if (k==ps->structNo)
+        {   /* This line does not contain the multi line delimiter */
+            appendToField (ps,p,end-p);
+            appendNewlineToField (ps);
+            *pp = end;
+            return (true);
+        }   /* if (k==ps->structNo) */
+        /* If we reach this point this line contains the multi line */
+        /* delimiter. Check whether it ends the field or not        */
+        r = ps->structs[k];
+        if ( (r+1==end) || (*(r+1)==ps->separator) )
+        {   /* The delimiter is the last char of the current field */
+            /* preceded by a separator -> stop multi line mode     */
+            appendToField (ps,p,r-p);
+            closeField (ps);
+            if ( (r+1<end) && (*(r+1)==ps->separator) )
+                p = r+2;
+            else
+                p = r+1;
+            *pp = p;
+            return (false);
+        }
+        /* The multi line delimiter is not the last character of this field   */
+        /* It shall be necessarily in the middle                              */
+        withinQuotes = true;    /* multi line mode -> we start with withinQuotes = true */
+        for (k=ps->structPos; k<ps->structNo; k++)
+        {
+            r = ps->structs[k];
+            if (*r==ps->multiLine)
+                withinQuotes = withinQuotes?false:true;
+            if ( (*r==ps->separator) && (withinQuotes==false) )
+            {   /* we have found an actual separator, i.e. not enclosed within delimiters   */
+                /* in this case we attach the text until the separator to the current field */
+                /* then switch to single line mode. If the char that precedes the separator */
+                /* is the closing delimiter, eliminate it                                   */
+                len = r-p;
+                if ( (r!=p)&&(*(r-1)==ps->multiLine) )
+                    len -= 1;
+                appendToField (ps,p,len);
+                closeField (ps);
+                p = r+1;
+                *pp = p;
+                return (false);
+            }   /*if ( (*r==ps->separator) && (withinQuotes==false) ) */
+        }   /* for (k=ps->structPos; k<ps->structNo; k++) */
+        appendToField (ps,p,end-p);
+        appendNewlineToField (ps);
+        p = end;
+
+    }   /* while (p<end) */
+
+    /* The line is finished without switching to single line mode */
+    *pp = p;
+    return (true);
+}
+
+
+/*****************************************************************************************/
+/* Complete the row just split: fields after the last one referenced by the templates    */
+/* are not counted, so that the templates see the same row shape as if they had been    */
+/* split, and fields missing in the row are tested by the row filters as empty fields.  */
+/* It returns false if the row is rejected by a row filter (option --where)              */
+/*****************************************************************************************/
+static bool endCsvRow (csvParser *ps, bool multiLineRow)
+{
+    /* Local Variables */
+    int i;
+
+    if ( (ps->fieldWanted!=NULL) && (ps->fieldNo>ps->fieldLimit) )
+        ps->fieldNo = ps->fieldLimit;
+    for (i=0; (i<ps->predicateNo) && !ps->rejected && !ps->skipFields; i++)
+    {
+        if (ps->predicates[i].field>=ps->fieldNo)
+            ps->rejected = !testPredicates (ps,ps->predicates[i].field,"",0);
+    }
+    if (ps->rejected)
+    {
+        if (ps->stats)
+            ps->stats->filteredRows += 1;
+        return (false);
+    }
+    if ( (ps->stats) && multiLineRow )
+        ps->stats->multiLineRows += 1;
+
+    return (true);
+}
+
+
+/*****************************************************************************************/
+/* Append the bytes from start to end to the field being built by the RFC 4180 parser.  */
+/* Empty segments are only used to give an empty field its position                     */
+/*****************************************************************************************/
+static inline void appendRfcSegment (csvParser *ps, char *start, char *end)
+{
+    if ( (end>start) || (ps->curPtr==NULL) )
+        appendToField (ps,start,end-start);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* End of the part of the input the RFC 4180 parser can go through: the whole input if  */
+/* it is mapped, up to the end of the line read so far if it is streamed                */
+/*****************************************************************************************/
+static inline char *rfcLimit (inputCsv *in)
+{
+    if ( in->stream && (in->scanned<in->size) )
+        return (in->data+in->scanned+1);
+
+    return (in->data+in->size);
+}
+
+
+/*****************************************************************************************/
+/* Feed the byte at p to the RFC 4180 parser: take the transition of the DFA (see       */
+/* initScanner()) from the current state and perform its action on the current field.  */
+/* It returns true if the byte ends the row                                              */
+/*****************************************************************************************/
+static inline bool stepRfc4180 (csvParser *ps, int *state, char **segment, char **lineStart, char *p)
+{
+    /* Local Variables */
+    unsigned char   next;
+
+    next = ps->rfcDfa[*state][(unsigned char)*p];
+    *state = next & (RFCSTATES-1);
+    switch (next>>2)
+    {
+        case RFCBEGIN:
+            *segment = p;
+            break;
+        case RFCOPEN:
+            *segment = p + 1;
+            break;
+        case RFCAPPEND:
+            appendRfcSegment (ps,*segment,p);
+            break;
+        case RFCFIELD:
+            appendRfcSegment (ps,*segment,p);
+            closeField (ps);
+            break;
+        case RFCCLOSE:
+            appendRfcSegment (ps,p,p);
+            closeField (ps);
+            break;
+        case RFCROW:
+            appendRfcSegment (ps,*segment,((p>*segment) && (p[-1]=='\r'))?p-1:p);
+            closeField (ps);
+            break;
+        case RFCENDROW:
+            appendRfcSegment (ps,p,p);
+            closeField (ps);
+            break;
+        default:
+            break;
+    }   /* switch (next>>2) */
+    if (*p!='\n')
+        return (false);
+
+    /* A line ends here (within a quoted field or at the end of the row) */
+    ps->lineNo += 1;
+    if ( (ps->stats) && ((size_t)(p-*lineStart)>ps->stats->longestLine) )
+        ps->stats->longestLine = p - *lineStart;
+    *lineStart = p + 1;
+
+    return (*state!=RFCQUOTED);
+}
+
+
+/******************************************************************************************/
+/* Read the next row from the input CSV file according to RFC 4180 (option --rfc4180) and */
+/* split it into ps->fields[]. The row is parsed in a single pass by a DFA, with no       */
+/* per-line preprocessing: separators, CR, LF and comment characters within quoted fields */
+/* are part of the field, "" is a quote, and a row ends at the first LF (or CR LF) out of */
+/* quotes. The DFA is fed by the structural scanner: besides separators, quotes and end   */
+/* of line characters, only the first byte of each run of other bytes needs a transition  */
+/* (the following ones cannot change the state). Fields are taken verbatim (leading       */
+/* spaces included) and remain views into the input unless they contain escaped quotes.  */
+/* Lines that are blank or start with the comment character are skipped (only where a    */
+/* row may start), as well as the first row if ps->skipHeader is set. It returns false   */
+/* when the end of the input is reached (a row with an unterminated quote is discarded)   */
+/******************************************************************************************/
+static bool readCsvRowRfc4180 (csvParser *ps)
+{
+    /* Local Variables */
+    inputCsv   *in = &ps->in;
+    char       *p, *q, *e, *eol, *limit, *chunk,
+               *segment = NULL,
+               *lineStart;
+    size_t      k;
+    int         state, firstLineNo;
+    bool        rowEnd;
+    uint64_t    t = 0;
+
+    for (;;)
+    {
+        /* A new row starts here: the bytes before it are no longer needed */
+        if (ps->stats)
+            t = statsClock();
+        in->keep = in->pos;
+        fillInputCsv (ps);
+        if (ps->stats)
+            t = statsLap (&ps->stats->readNs,t);
+        if (in->pos>=in->size)
+            return (false);
+        p = in->data + in->pos;
+        limit = rfcLimit (in);
+
+        /* Skip blank lines and comments */
+        for (q=p; (q<limit) && ((*q==' ') || (*q=='\t')); q++)
+            ;
+        if ( (q==limit) || (*q=='\n') || ((*q=='\r') && ((q+1==limit) || (q[1]=='\n'))) || (*q==ps->comment) )
+        {
+            if ( (q=memchr(q,'\n',limit-q))==NULL )
+                q = limit - 1;
+            in->pos = q + 1 - in->data;
+            ps->lineNo += 1;
+            if (ps->stats)
+            {
+                ps->stats->bytesIn += q + 1 - p;
+                for (q=p; (q<limit) && ((*q==' ') || (*q=='\t')); q++)
+                    ;
+                if ( (q<limit) && (*q==ps->comment) )
+                    ps->stats->commentLines += 1;
+                else
+                    ps->stats->emptyLines += 1;
+            }
+            continue;
+        }
+
+        /* Split the row */
+        arenaReset (&ps->arena);
+        firstLineNo = ps->lineNo + 1;
+        ps->rowStart = in->pos;
+        ps->fieldNo = 0;
+        ps->rejected = false;
+        ps->curPtr = NULL;
+        ps->curLen = 0;
+        ps->curCopied = false;
+        ps->curSkipped = skippedField (ps,0);
+        state = RFCSTART;
+        lineStart = chunk = p;
+        rowEnd = false;
+        for (;;)
+        {
+            while ( (p<limit) && !rowEnd )
+            {   /* p is the first byte not yet fed to the DFA */
+                eol = indexLine (ps,p,limit);
+                for (k=0; k<=ps->structNo; k++)
+                {
+                    e = (k<ps->structNo) ? ps->structs[k] : eol;
+                    if ( (p<e) && ((state==RFCSTART) || (state==RFCQUOTE)) )
+                    {   /* Run of other bytes: only its first one may have an effect, */
+                        /* and only in these states                                   */
+                        stepRfc4180 (ps,&state,&segment,&lineStart,p);
+                    }
+                    p = e;
+                    if (e==limit)
+                        break;
+                    p += 1;
+                    if ( (rowEnd=stepRfc4180(ps,&state,&segment,&lineStart,e)) )
+                        break;
+                }   /* for (k=0; k<=ps->structNo; k++) */
+            }   /* while ( (p<limit) && !rowEnd ) */
+            if (ps->stats)
+                ps->stats->bytesIn += p - chunk;
+            in->pos = p - in->data;
+            if (rowEnd)
+                break;
+
+            /* End of the window of a streamed input (within a quoted field), or of the input */
+            if ( in->stream && (state==RFCQUOTED) )
+            {
+                appendRfcSegment (ps,segment,p);    /* The window may be moved */
+                fillInputCsv (ps);
+                p = segment = lineStart = chunk = in->data + in->pos;
+                limit = rfcLimit (in);
+                if (p<limit)
+                    continue;
+            }
+            if (state==RFCQUOTED)
+                return (false);
+            if (state==RFCPLAIN)
+                appendRfcSegment (ps,segment,p);
+            else
+                appendRfcSegment (ps,p,p);
+            closeField (ps);
+            ps->lineNo += 1;
+            if ( (ps->stats) && ((size_t)(p-lineStart)>ps->stats->longestLine) )
+                ps->stats->longestLine = p - lineStart;
+            break;
+        }   /* for (;;) */
+        if (ps->stats)
+            statsLap (&ps->stats->scanNs,t);
+
+        if (ps->skipHeader)
+        {   /* skipHeader flag is enabled and this is the first row, so skip it */
+            ps->skipHeader = false;
+            continue;
+        }
+        if (endCsvRow(ps,ps->lineNo>firstLineNo))
+            return (true);
+    }   /* for (;;) */
+}
+
+
+/******************************************************************************************/
+/* Read the next row from the input CSV file and split it into ps->fields[]. Empty lines  */
+/* and comments are skipped, as well as the first valid line if ps->skipHeader is set. A  */
+/* row may span several lines, when it contains multi line fields. It returns false when  */
+/* the end of the input is reached (an unterminated multi line row is discarded)          */
+/******************************************************************************************/
+static bool readCsvRow (csvParser *ps)
+{
+    /* Local Variables */
+    char       *p, *line, *lineEnd, *end;
+    size_t      lineLen, lineStart;
+    bool        multiLineOpen = false;
+    int         firstLineNo = 0;
+    uint64_t    t = 0;
+
+    if (ps->rfc4180)
+        return (readCsvRowRfc4180(ps));
+
+    for (;;)
+    {
+        if (multiLineOpen==false)
+        {   /* A new row starts here: the bytes before it are no longer needed */
+            ps->in.keep = ps->in.pos;
+            fillInputCsv (ps);
+        }
+        if ( ps->skipFields && (ps->in.pos<ps->in.size) )
+        {   /* Fields are not needed (e.g. we are only looking for row boundaries): a line */
+            /* without multi line characters cannot change the multi line state, so it    */
+            /* is handled without building its structural index                           */
+            line = ps->in.data + ps->in.pos;
+            end = ps->in.data + ps->in.size;
+            if ( (ps->nextMultiLine<line) && ((ps->nextMultiLine=memchr(line,ps->multiLine,end-line))==NULL) )
+                ps->nextMultiLine = end;
+            if ( (lineEnd=memchr(line,'\n',end-line))==NULL )
+                lineEnd = end;
+            if (ps->nextMultiLine>lineEnd)
+            {
+                ps->lineNo += 1;
+                ps->in.pos = (lineEnd<end) ? (size_t)(lineEnd+1-ps->in.data) : ps->in.size;
+                if (ps->stats)
+                    ps->stats->bytesIn += ps->in.data + ps->in.pos - line;
+                if (multiLineOpen)
+                    continue;
+                for (p=line; (p<lineEnd) && ((*p==' ') || (*p=='\t')); p++)
+                    ;
+                if ( (p==lineEnd) || (*p=='\r') || (*p=='\0') || (*p==ps->comment) )
+                {
+                    if ( (ps->stats) && (*p==ps->comment) )
+                        ps->stats->commentLines += 1;
+                    else if (ps->stats)
+                        ps->stats->emptyLines += 1;
+                    continue;
+                }
+                if (ps->skipHeader)
+                {
+                    ps->skipHeader = false;
+                    continue;
+                }
+                ps->rowStart = line - ps->in.data;
+                ps->fieldNo = 0;        /* Not known, since the line was not split */
+                return (true);
+            }   /* if (ps->nextMultiLine>lineEnd) */
+        }   /* if ( ps->skipFields && (ps->in.pos<ps->in.size) ) */
+
+        if (ps->stats)
+            t = statsClock();
+        lineStart = ps->in.pos;
+        if (!readCsvLine(ps,&line,&lineLen))
+            break;
+        ps->lineNo += 1;
+        if (multiLineOpen==false)
+        {
+            arenaReset (&ps->arena);                /* A new row starts here: release its storage */
+            firstLineNo = ps->lineNo;
+        }
+        if (ps->stats)
+            t = statsLap (&ps->stats->readNs,t);
+        removeDoubleMultiLineChar (ps,&line,&lineLen);  /* Remove double occurences of multi line char */
+        if (ps->stats)
+            t = statsLap (&ps->stats->removeNs,t);
+
+        p = line;
+        lineEnd = line + lineLen;
+
+        if (multiLineOpen==false)
+        {   /* The line we just started parsing is not part of a multi line */
+            ps->fieldNo = 0;                    /* Reset the current field counter */
+            ps->rejected = false;
+            ps->curSkipped = skippedField (ps,0);
+            while ( (p<lineEnd) && ((*p==' ') || (*p=='\t')) ) /* Skip leading spaces and tabs (if any) */
+                p++;
+            if ( (p==lineEnd) || (*p==ps->comment) )    /* Check whether this is an empty line or a */
+            {                                           /* comment and, if so, skip this line       */
+                if ( (ps->stats) && (p==lineEnd) )
+                    ps->stats->emptyLines += 1;
+                else if (ps->stats)
+                    ps->stats->commentLines += 1;
+                continue ;
+            }
+
+            if (ps->skipHeader)
+            {   /* skipHeader flag is enabled and this is the first valid line, so skip it */
+                /* (note that if option -d was specified on command line, skipHeader is    */
+                /* forced to false, so that we never enter here)                           */
+                ps->skipHeader = false;
+                continue;
+            }   /* if (ps->skipHeader) */
+            ps->rowStart = lineStart;
+        }   /* if (multiLineOpen==false) */
+        else
+        {   /* here multiLineOpen==true */
+            if (p==lineEnd)
+            {   /* Bug fixing - if the multiline starts with an empty line, it means that we */
+                /* have to add this empty line in the current field, otherwise some markdown */
+                /* format may not be properly reproduced in the output (e.g. bullets, etc.)  */
+                appendNewlineToField (ps);
+            }   /* if (p==lineEnd) */
+        }   /* else if (multiLineOpen==false) */
+
+
+        /* Here p points to the first valid character in the current csv input line */
+        /* It may either be the first non-space character of a single line or the   */
+        /* first character of a multi line (note that space characters are allowed  */
+        /* at the beginning of a line that is part of a multi line)                 */
+        /* Scan the line until the end and handle it differently based on being or  */
+        /* not being within a multi line (observe that a multi line may begin and   */
+        /* end in the same line)                                                    */
+
+        while (p<lineEnd)
+        {
+            if (multiLineOpen)
+                multiLineOpen = scanMultiLine(ps,&p,lineEnd);
+            else
+                multiLineOpen = scanSingleLine(ps,&p,lineEnd);
+        }   /* while (p<lineEnd) */
+        if (ps->stats)
+            statsLap (&ps->stats->scanNs,t);
+
+        /* The row is terminated if there is no multi line ongoing */
+        if ( (multiLineOpen==false) && endCsvRow(ps,ps->lineNo>firstLineNo) )
+            return (true);
+
+    }   /* for (;;) */
+
+    return (false);
+}
+
+
+/*****************************************************************************************/
+/* Move the parser to the given offset of the input CSV file (it shall be the start of  */
+/* a row) and limit parsing to the first end bytes of the input                          */
+/*****************************************************************************************/
+static void seekCsv (csvParser *ps, size_t pos, size_t end)
+{
+    ps->in.pos = pos;
+    ps->in.size = end;
+    ps->nextMultiLine = NULL;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Read the header row (the first valid line) of the input CSV file into ps->fields,    */
+/* without consuming it: the parser is moved back to the start of the header, which is  */
+/* skipped again by the next readCsvRow() (ps->fields stays valid until then). Row      */
+/* filters and projection shall not be set yet. It returns false if there is no header  */
+/*****************************************************************************************/
+static bool readCsvHeader (csvParser *ps)
+{
+    /* Local Variables */
+    runStats   *stats = ps->stats;
+    char       *p;
+    bool        found;
+
+    ps->stats = NULL;
+    ps->skipHeader = false;
+    if ( (found=readCsvRow(ps)) )
+    {   /* The window of a streamed input still holds the whole row, from in.keep */
+        for (p=ps->in.data+ps->in.keep; (p=memchr(p,'\n',ps->in.data+ps->in.pos-p))!=NULL; p++)
+            ps->lineNo -= 1;
+        ps->in.pos = ps->in.keep;
+        ps->nextMultiLine = NULL;
+    }
+    ps->stats = stats;
+    ps->skipHeader = true;
+
+    return (found);
+}
+
+
+/*****************************************************************************************/
+/* Release the memory allocated by the parser (fields, structural index and arena)       */
+/*****************************************************************************************/
+static void freeCsvParser (csvParser *ps)
+{
+    /* Local Variables */
+    arenaBlock *block, *next;
+
+    for (block=ps->arena.first; block!=NULL; block=next)
+    {
+        next = block->next;
+        free (block);
+    }
+    ps->arena.first = NULL;
+    ps->arena.current = NULL;
+    free (ps->fields);
+    ps->fields = NULL;
+    ps->fieldCap = 0;
+    free (ps->structs);
+    ps->structs = NULL;
+    ps->structCap = 0;
+
+    return;
+}
+
+
+/****************************************************************************************/
+/* Parse a number of rows given on the command line (options --head, --skip, --rows and */
+/* --sample). It returns the first character following the number, NULL if none        */
+/****************************************************************************************/
+static char *parseCount (char *arg, size_t *value)
+{
+    /* Local Variables */
+    char   *p;
+
+    if ( (arg==NULL) || !isdigit(*arg) )
+        return (NULL);
+    *value = (size_t)strtoull (arg,&p,10);
+
+    return (p);
+}
+
+
+/****************************************************************************************/
+/* Parse a size given on the command line, optionally followed by K, M or G (e.g. 64K). */
+/* It returns false if the string is not a valid size                                   */
+/****************************************************************************************/
+static bool parseSize (char *arg, size_t *value)
+{
+    /* Local Variables */
+    char               *p;
+    unsigned long long  size;
+    size_t              multiplier = 1;
+
+    if ( (arg==NULL) || !isdigit(*arg) )
+        return (false);
+    errno = 0;
+    size = strtoull (arg,&p,10);
+    if ( (errno==ERANGE) || (size>SIZE_MAX) )
+        return (false);
+    switch (toupper(*p))
+    {
+        case 'G':   multiplier *= 1024;     /* fall through */
+        case 'M':   multiplier *= 1024;     /* fall through */
+        case 'K':   multiplier *= 1024;     p += 1;     break;
+        default:    break;
+    }   /* switch (toupper(*p)) */
+    if ( (*p!='\0') || (size>SIZE_MAX/multiplier) )
+        return (false);
+    size *= multiplier;
+
+    *value = (size_t)size;
+    return (true);
+}
+
+
+/*****************************************************************************************/
+/* Write len bytes to the output file, retrying on partial writes and signals. Any error */
+/* is fatal, since the output file would be incomplete                                   */
+/*****************************************************************************************/
+static void writeAll (outputBuffer *out, char *data, size_t len)
+{
+    /* Local Variables */
+    ssize_t     written;
+    uint64_t    start = 0;
+
+    if (out->stats)
+    {
+        start = statsClock();
+        out->stats->bytesOut += len;
+    }
+    while (len>0)
+    {
+        if ( (written=write(out->fd,data,len))<0 )
+        {
+            if (errno==EINTR)
+                continue;
+            printf ("Error writing output Markdown File (%s)... Aborting\n\n",strerror(errno));
+            exit (-1);
+        }
+        data += written;
+        len -= written;
+    }   /* while (len>0) */
+    if (out->stats)
+        statsLap (&out->stats->writeNs,start);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Leave O_DIRECT mode on the output file (if active). Used for the last (unaligned)     */
+/* chunk of data and whenever the kernel refuses a direct write (e.g. in append mode the */
+/* starting offset may not be aligned)                                                   */
+/*****************************************************************************************/
+static void leaveDirectMode (outputBuffer *out)
+{
+    if (out->direct)
+    {
+        fcntl (out->fd,F_SETFL,fcntl(out->fd,F_GETFL) & ~O_DIRECT);
+        out->direct = false;
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Wait for the asynchronous write of the spare buffer (if any) to complete. A partial   */
+/* write is completed synchronously                                                      */
+/*****************************************************************************************/
+static void finishAsyncWrite (outputBuffer *out)
+{
+    /* Local Variables */
+    ssize_t written;
+
+    if (out->aio->state==ASYNCIDLE)
+        return;
+    if ( ((written=waitAsyncIo(out->aio))<0) ||
+         (((size_t)written<out->aio->len) && !writeFd(out->fd,out->aio->data+written,out->aio->len-written)) )
+    {
+        printf ("Error writing output Markdown File (%s)... Aborting\n\n",strerror((written<0)?-written:errno));
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Post the asynchronous write of the output buffer and go on with the spare one, after */
+/* waiting for its own write to complete. With --stats, the time accounted to the write  */
+/* stage is the time spent waiting                                                       */
+/*****************************************************************************************/
+static void postOutputBuffer (outputBuffer *out, bool final)
+{
+    /* Local Variables */
+    char       *buffer;
+    uint64_t    start = 0;
+
+    if (out->stats)
+        start = statsClock();
+    finishAsyncWrite (out);
+    if (out->len>0)
+    {
+        submitAsyncIo (out->aio,true,out->buffer,out->len);
+        if (out->stats)
+            out->stats->bytesOut += out->len;
+        buffer = out->buffer;
+        out->buffer = out->spare;
+        out->spare = buffer;
+        out->len = 0;
+    }
+    if (final)
+        finishAsyncWrite (out);
+    if (out->stats)
+        statsLap (&out->stats->writeNs,start);
+
+    return;
+}
+
+
+/******************************************************************************************/
+/* Write the content of the output buffer to the output file. In O_DIRECT mode only the   */
+/* aligned part of the buffer is written, unless final is true; the remainder is moved to */
+/* the beginning of the buffer and written later. With asynchronous writes the buffer is  */
+/* posted, and waited for only if final is true                                           */
+/******************************************************************************************/
+static void flushOutputBuffer (outputBuffer *out, bool final)
+{
+    /* Local Variables */
+    size_t      aligned;
+    ssize_t     written;
+    uint64_t    start = 0;
+
+    if (out->aio!=NULL)
+    {
+        postOutputBuffer (out,final);
+        return;
+    }
+
+    if (out->direct)
+    {
+        if (out->stats)
+            start = statsClock();
+        aligned = out->len - out->len%OUTBUFALIGN;
+        while (aligned>0)
+        {
+            if ( (written=write(out->fd,out->buffer,aligned))<0 )
+            {
+                if (errno==EINTR)
+                    continue;
+                if (errno!=EINVAL)
+                {
+                    printf ("Error writing output Markdown File (%s)... Aborting\n\n",strerror(errno));
+                    exit (-1);
+                }
+                leaveDirectMode (out);
+                break;
+            }
+            memmove (out->buffer,out->buffer+written,out->len-written);
+            out->len -= written;
+            aligned -= written;
+            if (out->stats)
+                out->stats->bytesOut += written;
+        }   /* while (aligned>0) */
+        if (out->stats)
+            statsLap (&out->stats->writeNs,start);
+        if (!final && out->direct)
+            return;
+        leaveDirectMode (out);
+    }   /* if (out->direct) */
+
+    writeAll (out,out->buffer,out->len);
+    out->len = 0;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Make room for at least len more bytes in an in-memory output buffer                   */
+/*****************************************************************************************/
+static void growOutputBuffer (outputBuffer *out, size_t len)
+{
+    if (out->len+len<=out->size)
+        return;
+
+    while (out->len+len>out->size)
+        out->size *= 2;
+    if ( (out->buffer=realloc(out->buffer,out->size))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Append len bytes to the output buffer, flushing it when full. Data that do not fit    */
+/* are written together with the buffer content by means of a single writev() call       */
+/*****************************************************************************************/
+static inline void outputWrite (outputBuffer *out, char *data, size_t len)
+{
+    /* Local Variables */
+    struct iovec    iov[2];
+    ssize_t         written;
+    uint64_t        start = 0;
+
+    if (len<=out->size-out->len)
+    {
+        memcpy (out->buffer+out->len,data,len);
+        out->len += len;
+        return;
+    }
+
+    if (out->fd<0)
+    {   /* In-memory output: the buffer grows as needed and is never flushed */
+        growOutputBuffer (out,len);
+        memcpy (out->buffer+out->len,data,len);
+        out->len += len;
+        return;
+    }   /* if (out->fd<0) */
+
+    if ( (out->direct) || (out->aio!=NULL) )
+    {   /* O_DIRECT requires aligned buffers and asynchronous writes use the buffers */
+        /* in turn, so always go through the output buffer                          */
+        while (len>0)
+        {
+            written = (len<out->size-out->len) ? len : out->size-out->len;
+            memcpy (out->buffer+out->len,data,written);
+            out->len += written;
+            data += written;
+            len -= written;
+            if (out->len==out->size)
+                flushOutputBuffer (out,false);
+        }   /* while (len>0) */
+        return;
+    }   /* if ( (out->direct) || (out->aio!=NULL) ) */
+
+    iov[0].iov_base = out->buffer;
+    iov[0].iov_len = out->len;
+    iov[1].iov_base = data;
+    iov[1].iov_len = len;
+    if (out->stats)
+        start = statsClock();
+    while ( (written=writev(out->fd,iov,2))<0 )
+    {
+        if (errno!=EINTR)
+        {
+            printf ("Error writing output Markdown File (%s)... Aborting\n\n",strerror(errno));
+            exit (-1);
+        }
+    }   /* while ( (written=writev(out->fd,iov,2))<0 ) */
+    if (out->stats)
+    {
+        statsLap (&out->stats->writeNs,start);
+        out->stats->bytesOut += written;
+    }
+    if ((size_t)written<out->len)
+    {
+        writeAll (out,out->buffer+written,out->len-written);
+        written = out->len;
+    }
+    written -= out->len;
+    out->len = 0;
+    writeAll (out,data+written,len-written);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Open the output markdown file and allocate the output buffer. The buffer size is      */
+/* rounded up to a multiple of OUTBUFALIGN, as required in O_DIRECT mode. If O_DIRECT is */
+/* not supported by the underlying filesystem, the file is written in normal mode. The   */
+/* output file "-" stands for the standard output (e.g. a pipe), which is written as     */
+/* soon as the buffer is full, so that memory does not depend on the output size. In     */
+/* this case all messages are redirected to the standard error, not to mix them with the */
+/* markdown output. With a codec (option --compress, CODECAUTO for the extension of the  */
+/* file) the tool writes to a pipe, compressed into the file by a codec thread; in       */
+/* append mode a new gzip member or zstd frame is added                                  */
+/*****************************************************************************************/
+static void openOutputBuffer (outputBuffer *out, char *outputMdFile, bool appendMode, size_t size, int syncPolicy, int codec)
+{
+    /* Local Variables */
+    int flags;
+
+    flags = O_WRONLY | O_CREAT | (appendMode ? O_APPEND : O_TRUNC);
+    codec = outputCodec (codec,outputMdFile);
+    if ( (codec!=CODECNONE) && (syncPolicy==SYNCDIRECT) )
+        syncPolicy = SYNCDATA;                  /* Compressed data go through a pipe */
+    out->direct = false;
+    out->codec = NULL;
+    out->aio = NULL;
+    out->spare = NULL;
+    out->fd = -1;
+    if (strcmp(outputMdFile,"-")==0)
+    {
+        fflush (stdout);
+        if ( ((out->fd=dup(STDOUT_FILENO))<0) || (dup2(STDERR_FILENO,STDOUT_FILENO)<0) )
+        {
+            printf ("Unable to open output Markdown File... Aborting\n\n");
+            exit (-1);
+        }
+    }
+    else if (syncPolicy==SYNCDIRECT)
+    {
+        if ( (out->fd=open(outputMdFile,flags|O_DIRECT,0666))>=0 )
+            out->direct = true;
+    }
+    if ( (out->fd<0) && ((out->fd=open(outputMdFile,flags,0666))<0) )
+    {
+        printf ("Unable to open output Markdown File... Aborting\n\n");
+        exit (-1);
+    }
+    if (codec!=CODECNONE)
+    {
+        out->fd = startCodec (&out->codec,codec,true,out->fd,NULL,0,syncPolicy);
+        syncPolicy = SYNCNONE;                  /* Applied by the codec thread */
+    }
+
+    out->size = (size+OUTBUFALIGN-1) / OUTBUFALIGN * OUTBUFALIGN;
+    if (out->size==0)
+        out->size = OUTBUFALIGN;
+    out->len = 0;
+    out->syncPolicy = syncPolicy;
+    out->stats = NULL;
+    if (posix_memalign((void **)&out->buffer,OUTBUFALIGN,out->size)!=0)
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Overlap the writes of the output file with rendering (option --async-io): a full      */
+/* output buffer is written by the asynchronous I/O engine while rendering goes on in a  */
+/* spare buffer. Not used in O_DIRECT mode, nor for compressed outputs (already written  */
+/* by the codec thread)                                                                  */
+/*****************************************************************************************/
+static void startAsyncOutput (outputBuffer *out, int mode)
+{
+    if ( (mode==ASYNCNONE) || (out->direct) || (out->codec!=NULL) || (out->fd<0) )
+        return;
+    if (posix_memalign((void **)&out->spare,OUTBUFALIGN,out->size)!=0)
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    out->aio = openAsyncIo (out->fd,mode);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Allocate an in-memory output buffer (no output file), used by worker threads to render */
+/* their chunk of rows before it is written to the output file in the right order         */
+/*****************************************************************************************/
+static void openMemoryOutput (outputBuffer *out, size_t size)
+{
+    out->fd = -1;
+    out->direct = false;
+    out->codec = NULL;
+    out->aio = NULL;
+    out->spare = NULL;
+    out->syncPolicy = SYNCNONE;
+    out->stats = NULL;
+    out->size = size;
+    out->len = 0;
+    if ( (out->buffer=malloc(out->size))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Flush the output buffer, apply the requested sync policy and close the output file    */
+/* (waiting for the codec thread to compress the end of a compressed output)             */
+/*****************************************************************************************/
+static void closeOutputBuffer (outputBuffer *out)
+{
+    flushOutputBuffer (out,true);
+    if ( (out->syncPolicy!=SYNCNONE) && (fdatasync(out->fd)<0) && (errno!=EINVAL) )
+    {
+        printf ("Error syncing output Markdown File (%s)... Aborting\n\n",strerror(errno));
+        exit (-1);
+    }
+    if (out->aio!=NULL)
+    {
+        closeAsyncIo (out->aio);
+        free (out->spare);
+        out->aio = NULL;
+    }
+    if (out->codec!=NULL)
+        stopCodec (&out->codec,out->fd);
+    else
+        close (out->fd);
+    free (out->buffer);
+    out->buffer = NULL;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Close the segment being compiled: its literal text is the one collected so far (from */
+/* *r, textLen bytes), followed by the given operation. It returns the new segment       */
+/*****************************************************************************************/
+static templateSegment *addSegment (mdTemplate *tmpl, char **r, size_t *textLen, int op, int fieldRef)
+{
+    /* Local Variables */
+    templateSegment *segment = &tmpl->segments[tmpl->segmentNo];
+
+    segment->text = *r;
+    segment->textLen = *textLen;
+    segment->op = op;
+    segment->fieldRef = fieldRef;
+    segment->transforms = 0;
+    segment->defaultText = NULL;
+    segment->defaultLen = 0;
+    segment->jump = -1;
+    segment->name = NULL;
+    segment->nameLen = 0;
+    tmpl->segmentNo += 1;
+    *r += *textLen;
+    *textLen = 0;
+
+    if ( (op==SEGFIELD) || (op==SEGFORMAT) )
+    {
+        if (tmpl->firstFieldRef<0)
+            tmpl->firstFieldRef = fieldRef;
+        if (fieldRef<=0)
+            tmpl->invalidRef = true;
+    }
+    else if ( (op==SEGIF) && (fieldRef<=0) )
+        tmpl->invalidRef = true;
+    if (fieldRef>tmpl->maxFieldRef)
+        tmpl->maxFieldRef = fieldRef;
+
+    return (segment);
+}
+
+
+/*****************************************************************************************/
+/* Split a column name (e.g. "Movie Name" in ${Movie Name}) from s to end, removing the  */
+/* leading and trailing blanks. It returns the length of the name (0 if it is blank)     */
+/*****************************************************************************************/
+static size_t columnName (char *s, char *end, char **name)
+{
+    while ( (s<end) && ((*s==' ') || (*s=='\t')) )
+        s++;
+    while ( (end>s) && ((end[-1]==' ') || (end[-1]=='\t')) )
+        end--;
+    *name = s;
+
+    return (end-s);
+}
+
+
+/*****************************************************************************************/
+/* Recognize a section tag ({{#if N}}, {{#if name}}, {{else}} or {{/if}}) at the         */
+/* beginning of s. It returns the length of the tag (0 if s does not start with a tag),  */
+/* the corresponding operation (SEGIF, SEGELSE or SEGTEXT for {{/if}}) and the field     */
+/* tested by {{#if N}} (0 for {{#if name}}, whose column name is returned in name)       */
+/*****************************************************************************************/
+static size_t sectionTag (char *s, int *op, int *fieldRef, char **name, size_t *nameLen)
+{
+    /* Local Variables */
+    char   *p, *end;
+
+    if (strncmp(s,"{{else}}",8)==0)
+    {
+        *op = SEGELSE;
+        return (8);
+    }
+    if (strncmp(s,"{{/if}}",7)==0)
+    {
+        *op = SEGTEXT;
+        return (7);
+    }
+    if ( (strncmp(s,"{{#if ",6)!=0) || ((end=strstr(s+6,"}}"))==NULL) || (s+6+strcspn(s+6,"{}")!=end) )
+        return (0);
+    for (p=s+6; *p==' '; p++)
+        ;
+    *name = NULL;
+    *nameLen = 0;
+    for (*fieldRef=0; isdigit((unsigned char)*p); p++)
+        *fieldRef = 10*(*fieldRef) + (*p-'0');
+    for (; *p==' '; p++)
+        ;
+    if (p!=end)
+    {   /* Column name */
+        *fieldRef = 0;
+        if ( (*nameLen=columnName(s+6,end,name))==0 )
+            return (0);
+    }
+    else if (*fieldRef==0)
+        return (0);
+    *op = SEGIF;
+
+    return (end+2-s);
+}
+
+
+/*****************************************************************************************/
+/* Compile a braced placeholder ${N[|transform]...[:-default]} starting at p (that       */
+/* points to the character following the opening brace); a column name can be given     */
+/* instead of N. The name and the default text are appended to the literal text of the   */
+/* template (at r+textLen). It returns the character following the closing brace, or    */
+/* NULL if the placeholder is not valid (reason is then set)                             */
+/*****************************************************************************************/
+static char *compileBracedPlaceholder (mdTemplate *tmpl, char *p, char **r, size_t *textLen, char **reason)
+{
+    /* Local Variables */
+    templateSegment *segment;
+    char            *end, *name, *column;
+    size_t           nameLen, columnLen;
+    int              fieldRef = 0,
+                     transforms = 0,
+                     i;
+    static const struct { char *name; int flag; } transformNames[] =
+    {
+        { "trim", XFORMTRIM }, { "upper", XFORMUPPER }, { "lower", XFORMLOWER }, { "md", XFORMMD }, { "cell", XFORMCELL }
+    };
+
+    if ( (end=strchr(p,'}'))==NULL )
+    {
+        *reason = "unterminated placeholder";
+        return (NULL);
+    }
+    for (name=p; isdigit((unsigned char)*p); p++)
+        fieldRef = 10*fieldRef + (*p-'0');
+    columnLen = 0;
+    if ( (p==name) || ((*p!='|') && (*p!='}') && (strncmp(p,":-",2)!=0)) )
+    {   /* Column name, up to the first transform or default text */
+        for (p=name; (p<end) && (*p!='|') && (strncmp(p,":-",2)!=0); p++)
+            ;
+        if ( (columnLen=columnName(name,p,&column))==0 )
+        {
+            *reason = "placeholder without field number or column name";
+            return (NULL);
+        }
+        fieldRef = 0;
+    }
+    while (*p=='|')
+    {   /* Transforms */
+        name = p + 1;
+        nameLen = strcspn (name,"|:}");
+        for (i=0; i<(int)(sizeof(transformNames)/sizeof(transformNames[0])); i++)
+            if ( (strlen(transformNames[i].name)==nameLen) && (strncmp(name,transformNames[i].name,nameLen)==0) )
+                break;
+        if (i==(int)(sizeof(transformNames)/sizeof(transformNames[0])))
+        {
+            *reason = "unknown transform (trim, upper, lower, md or cell)";
+            return (NULL);
+        }
+        transforms |= transformNames[i].flag;
+        p = name + nameLen;
+    }   /* while (*p=='|') */
+    if ( (transforms & XFORMUPPER) && (transforms & XFORMLOWER) )
+    {
+        *reason = "upper and lower transforms together";
+        return (NULL);
+    }
+
+    if ( (strncmp(p,":-",2)!=0) && (p!=end) )
+    {
+        *reason = "invalid placeholder";
+        return (NULL);
+    }
+
+    segment = addSegment (tmpl,r,textLen,(transforms!=0)?SEGFORMAT:SEGFIELD,fieldRef);
+    segment->transforms = transforms;
+    if (columnLen>0)
+    {   /* Column name, stored with the literal text of the template */
+        segment->name = *r;
+        segment->nameLen = columnLen;
+        memcpy (*r,column,columnLen);
+        *r += columnLen;
+        tmpl->namedRefNo += 1;
+    }
+    if (strncmp(p,":-",2)==0)
+    {   /* Default text, stored with the literal text of the template */
+        p += 2;
+        segment->op = SEGFORMAT;
+        segment->defaultText = *r;
+        segment->defaultLen = end - p;
+        memcpy (*r,p,end-p);
+        *r += end - p;
+    }
+
+    return (end+1);
+}
+
+
+/*******************************************************************************************/
+/* This function loads a markdown template file once and compiles it into an ordered list  */
+/* of literal segments and field references, so that rows can be rendered without reading  */
+/* and parsing the template again. The literal text follows the same rules used when the   */
+/* template was processed line-by-line: trailing CR/LF are removed and replaced by a single */
+/* newline, the character that immediately follows a placeholder is dropped and an empty   */
+/* line is added at the end of each instance of the template.                              */
+/* Braced placeholders (${N}, with optional transforms and default text) and sections      */
+/* ({{#if N}} ... {{else}} ... {{/if}}) are compiled as well: each segment is then an      */
+/* instruction that substitutes a field (as is, or transformed), tests a field or jumps.   */
+/* A line containing nothing but a section tag does not produce any output line. With     */
+/* -p "{" braces are placeholders, and the template is compiled as before (no braced      */
+/* placeholders nor sections). {{else}} and {{/if}} outside a section are literal text     */
+/* It returns false if the template cannot be read (error is then empty) or if it is not   */
+/* valid (error is then set to the file, the line and the reason)                          */
+/*******************************************************************************************/
+static bool compileMdTemplate (mdTemplate *tmpl, char *inputMdTemplate, char placeHolder, char *error, size_t errorLen)
+{
+    /* Local Variables */
+    FILE       *inputMdTemplateFd;
+    templateSegment *segment;
+    char       *content, *line, *lineEnd, *p, *q, *r,
+                delimiters[3] = { placeHolder, '{', '\0' };
+    long        contentLen;
+    char       *name, *next,
+               *reason = NULL;
+    size_t      textLen, tagLen, nameLen;
+    int         currentField,
+                segmentMax,
+                lineNo = 0,
+                depth = 0,
+                op,
+                ifSegment[MAXNESTING],
+                elseSegment[MAXNESTING];
+    bool        standalone,
+                braces = (placeHolder!='{');
+
+    /* Read the whole markdown template file in memory */
+    error[0] = '\0';
+    if ( (inputMdTemplateFd=fopen(inputMdTemplate,"r"))==NULL )
+        return (false);
+    fseek (inputMdTemplateFd,0,SEEK_END);
+    contentLen = ftell (inputMdTemplateFd);
+    fseek (inputMdTemplateFd,0,SEEK_SET);
+    if (contentLen<0)
+        contentLen = 0;
+    if ( ((content=malloc(contentLen+1))==NULL) ||
+         ((tmpl->literals=malloc(contentLen+2))==NULL) )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    contentLen = fread (content,1,contentLen,inputMdTemplateFd);
+    content[contentLen] = '\0';
+    fclose (inputMdTemplateFd);
+
+    /* Each placeholder or section tag produces a segment, plus a final one for the */
+    /* trailing text                                                                */
+    if (!braces)
+        delimiters[1] = '\0';
+    segmentMax = 1;
+    for (p=content; p<content+contentLen; p++)
+        if ( (*p==placeHolder) || (*p=='{') )
+            segmentMax += 1;
+    if ( (tmpl->segments=malloc(segmentMax*sizeof(templateSegment)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+
+    tmpl->segmentNo = 0;
+    tmpl->firstFieldRef = -1;
+    tmpl->maxFieldRef = 0;
+    tmpl->invalidRef = false;
+    tmpl->checkedFieldNo = -1;
+    tmpl->namedRefNo = 0;
+
+    /* Split the template line-by-line and compile it. Literal text is accumulated */
+    /* in tmpl->literals (r points to the first free byte, textLen is the length   */
+    /* of the literal text collected so far for the current segment)               */
+    r = tmpl->literals;
+    textLen = 0;
+    line = content;
+    while ( (line<content+contentLen) && (reason==NULL) )
+    {
+        if ( (lineEnd=memchr(line,'\n',content+contentLen-line))!=NULL )
+            lineEnd += 1;
+        else
+            lineEnd = content+contentLen;
+        lineNo += 1;
+        p = line;
+        line[strcspn(line, "\r\n")] = '\0';   /* Remove trailing CR, LF, CRLF, LFCR, etc.    */
+
+        /* A line holding only a section tag (and blanks) produces no output line */
+        for (q=p; (*q==' ') || (*q=='\t'); q++)
+            ;
+        standalone = false;
+        if ( braces && ((tagLen=sectionTag(q,&op,&currentField,&name,&nameLen))>0) && ((op==SEGIF) || (depth>0)) )
+        {
+            standalone = ( q[tagLen+strspn(q+tagLen," \t")]=='\0' );
+            if (standalone)
+                p = q;
+        }
+
+        while (*(q=p+strcspn(p,delimiters))!='\0')
+        {
+            memcpy (r+textLen,p,q-p);
+            textLen += q-p;
+            if (*q!=placeHolder)
+            {   /* Section tag, or literal text ({{else}} and {{/if}} outside a section) */
+                if ( ((tagLen=sectionTag(q,&op,&currentField,&name,&nameLen))==0) || ((op!=SEGIF) && (depth==0)) )
+                {
+                    tagLen = (tagLen>0) ? tagLen : 1;
+                    memcpy (r+textLen,q,tagLen);
+                    textLen += tagLen;
+                    p = q+tagLen;
+                    continue;
+                }
+                p = q+tagLen;
+                if (op==SEGIF)
+                {
+                    if (depth==MAXNESTING)
+                    {
+                        reason = "too many nested sections";
+                        break;
+                    }
+                    ifSegment[depth] = tmpl->segmentNo;
+                    elseSegment[depth] = -1;
+                    depth += 1;
+                    segment = addSegment (tmpl,&r,&textLen,SEGIF,currentField);
+                    if (nameLen>0)
+                    {   /* Column name, stored with the literal text of the template */
+                        segment->name = r;
+                        segment->nameLen = nameLen;
+                        memcpy (r,name,nameLen);
+                        r += nameLen;
+                        tmpl->namedRefNo += 1;
+                    }
+                    continue;
+                }
+                if (op==SEGELSE)
+                {   /* The test jumps after {{else}}, the end of the true branch jumps after {{/if}} */
+                    if (elseSegment[depth-1]>=0)
+                    {
+                        reason = "more than one {{else}}";
+                        break;
+                    }
+                    elseSegment[depth-1] = tmpl->segmentNo;
+                    tmpl->segments[ifSegment[depth-1]].jump = tmpl->segmentNo + 1;
+                    addSegment (tmpl,&r,&textLen,SEGELSE,-1);
+                    continue;
+                }
+                addSegment (tmpl,&r,&textLen,SEGTEXT,-1);
+                depth -= 1;
+                if (elseSegment[depth]>=0)
+                    tmpl->segments[elseSegment[depth]].jump = tmpl->segmentNo;
+                else
+                    tmpl->segments[ifSegment[depth]].jump = tmpl->segmentNo;
+                continue;
+            }   /* if (*q!=placeHolder) */
+
+            if ( braces && (q[1]=='{') )
+            {   /* Braced placeholder */
+                if ( (next=compileBracedPlaceholder(tmpl,q+2,&r,&textLen,&reason))==NULL )
+                    break;
+                p = next;
+                continue;
+            }
+            currentField = 0;
+            q += 1;
+            while ( ((*q)!='\0') && isdigit(*q) )
+            {
+                currentField = 10*currentField + (int)(*q -'0');
+                q += 1;
+            }   /* while ( ((*q)!='\0') && isdigit(*q) ) */
+            addSegment (tmpl,&r,&textLen,SEGFIELD,currentField);
+
+            if ( *q=='\0')
+                p = q;
+            else
+                p = q+1;
+        }   /* while (*(q=p+strcspn(p,delimiters))!='\0') */
+        if (reason!=NULL)
+            break;
+        memcpy (r+textLen,p,q-p);
+        textLen += q-p;
+        if (!standalone)
+            r[textLen++] = '\n';
+        line = lineEnd;
+    }   /* while ( (line<content+contentLen) && (reason==NULL) ) */
+    if ( (reason==NULL) && (depth>0) )
+        reason = "{{#if N}} without {{/if}}";
+    free (content);
+    if (reason!=NULL)
+    {
+        snprintf (error,errorLen,"%s, line %d (%s)",inputMdTemplate,lineNo,reason);
+        free (tmpl->literals);
+        free (tmpl->segments);
+        tmpl->literals = NULL;
+        tmpl->segments = NULL;
+        tmpl->segmentNo = 0;
+        return (false);
+    }
+    r[textLen++] = '\n';
+    addSegment (tmpl,&r,&textLen,SEGTEXT,-1);
+
+    return (true);
+}
+
+
+/*****************************************************************************************/
+/* Compile a markdown template (see compileMdTemplate()), aborting if it cannot be read */
+/* (with the given message) or if it is not valid                                        */
+/*****************************************************************************************/
+static void loadMdTemplate (mdTemplate *tmpl, char *inputMdTemplate, char placeHolder, char *errorMsg)
+{
+    /* Local Variables */
+    char    error[MAXFILENAMELEN+256];
+
+    if (!compileMdTemplate(tmpl,inputMdTemplate,placeHolder,error,sizeof(error)))
+    {
+        if (error[0]=='\0')
+            printf ("%s",errorMsg);
+        else
+            printf ("Invalid markdown template %s... Aborting\n\n",error);
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Load a compiled markdown template, compiling it only if it is not in the cache yet.   */
+/* Compiled templates are shared (read only); the copy returned in tmpl has its own      */
+/* row shape validation. Without a cache the template is simply compiled                 */
+/*****************************************************************************************/
+static void loadCachedTemplate (templateCache *cache, mdTemplate *tmpl, char *inputMdTemplate, char placeHolder, char *errorMsg)
+{
+    /* Local Variables */
+    cachedTemplate *entry;
+
+    if (cache==NULL)
+    {
+        loadMdTemplate (tmpl,inputMdTemplate,placeHolder,errorMsg);
+        return;
+    }
+
+    pthread_mutex_lock (&cache->lock);
+    for (entry=cache->first; entry!=NULL; entry=entry->next)
+        if ( (entry->placeHolder==placeHolder) && (strcmp(entry->file,inputMdTemplate)==0) )
+            break;
+    if (entry==NULL)
+    {
+        if ( (entry=malloc(sizeof(cachedTemplate)))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+        strcpy (entry->file,inputMdTemplate);
+        entry->placeHolder = placeHolder;
+        loadMdTemplate (&entry->tmpl,inputMdTemplate,placeHolder,errorMsg);
+        entry->next = cache->first;
+        cache->first = entry;
+    }   /* if (entry==NULL) */
+    *tmpl = entry->tmpl;
+    pthread_mutex_unlock (&cache->lock);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Release a markdown template compiled by loadMdTemplate()                              */
+/*****************************************************************************************/
+static void freeMdTemplate (mdTemplate *tmpl)
+{
+    free (tmpl->literals);
+    free (tmpl->segments);
+    tmpl->literals = NULL;
+    tmpl->segments = NULL;
+    tmpl->segmentNo = 0;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Tell whether all placeholders of the template refer to fields of a row with fieldNo  */
+/* fields (the one following the last field is always available, as an empty field)    */
+/*****************************************************************************************/
+static inline bool fitsMdTemplate (mdTemplate *tmpl, int fieldNo)
+{
+    return ( !tmpl->invalidRef && (tmpl->maxFieldRef<=fieldNo+1) );
+}
+
+
+/*********************************************************************************************/
+/* This function checks that all placeholders in the template refer to existing fields. The  */
+/* outcome only depends on the number of fields in the current row, so the check is actually */
+/* performed only when the row shape changes with respect to the last validated one          */
+/*********************************************************************************************/
+static void checkMdTemplate (mdTemplate *tmpl, char placeHolder, int fieldNo)
+{
+    /* Local Variables */
+    int i, currentField;
+
+    if (tmpl->checkedFieldNo==fieldNo)
+        return;
+
+    if (!fitsMdTemplate(tmpl,fieldNo))
+    {
+        for (i=0; i<tmpl->segmentNo; i++)
+        {
+            currentField = tmpl->segments[i].fieldRef;
+            if ( (currentField==0) || (currentField>fieldNo+1) )
+            {
+                printf ("The template contains a placeholder (%c%d) that refers to a non-existing field... Aborting\n\n",placeHolder,currentField);
+                exit (-1);
+            }
+        }   /* for (i=0; i<tmpl->segmentNo; i++) */
+    }
+    tmpl->checkedFieldNo = fieldNo;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Tell whether a field is blank (empty or made of spaces, tabs and newlines only), which */
+/* selects the default text of ${N:-default} and the branch of {{#if N}}                  */
+/*****************************************************************************************/
+static bool blankField (fieldView *field)
+{
+    /* Local Variables */
+    size_t i;
+
+    for (i=0; i<field->len; i++)
+        if ( (field->ptr[i]!=' ') && (field->ptr[i]!='\t') && (field->ptr[i]!='\r') && (field->ptr[i]!='\n') )
+            return (false);
+
+    return (true);
+}
+
+
+/*****************************************************************************************/
+/* Write a field substituted by a ${N|transform:-default} placeholder: the transforms    */
+/* are applied byte by byte while copying the field into a small buffer, which is passed */
+/* to outputWrite() whenever it is full                                                  */
+/*****************************************************************************************/
+static void writeFormattedField (outputBuffer *outputMd, templateSegment *segment, fieldView *field)
+{
+    /* Local Variables */
+    static const char mdSpecial[256] = {['\\']=1, ['`']=1, ['*']=1, ['_']=1, ['{']=1, ['}']=1,
+                                        ['[']=1, [']']=1, ['(']=1, [')']=1, ['#']=1, ['+']=1,
+                                        ['-']=1, ['.']=1, ['!']=1, ['|']=1, ['<']=1, ['>']=1,
+                                        ['~']=1};
+    char        chunk[1024];
+    const char *p, *end;
+    size_t      len = 0;
+    int         c;
+
+    if ( (segment->defaultText!=NULL) && blankField(field) )
+    {
+        outputWrite (outputMd,segment->defaultText,segment->defaultLen);
+        return;
+    }
+
+    p = field->ptr;
+    end = field->ptr + field->len;
+    if (segment->transforms & XFORMTRIM)
+    {
+        while ( (p<end) && ((*p==' ') || (*p=='\t') || (*p=='\r') || (*p=='\n')) )
+            p++;
+        while ( (end>p) && ((end[-1]==' ') || (end[-1]=='\t') || (end[-1]=='\r') || (end[-1]=='\n')) )
+            end--;
+    }
+
+    for (; p<end; p++)
+    {
+        /* Room for the longest replacement (<br>) */
+        if (len>sizeof(chunk)-4)
+        {
+            outputWrite (outputMd,chunk,len);
+            len = 0;
+        }
+        c = (unsigned char)*p;
+        if ( (segment->transforms & XFORMUPPER) && (c>='a') && (c<='z') )
+            c -= 'a' - 'A';
+        else if ( (segment->transforms & XFORMLOWER) && (c>='A') && (c<='Z') )
+            c += 'a' - 'A';
+
+        if ( (segment->transforms & XFORMCELL) && ((c=='\n') || ((c=='\r') && (p+1<end) && (p[1]=='\n'))) )
+        {
+            memcpy (chunk+len,"<br>",4);
+            len += 4;
+            if (c=='\r')
+                p++;
+            continue;
+        }
+        if ( ((segment->transforms & XFORMMD) && mdSpecial[c]) || ((segment->transforms & XFORMCELL) && (c=='|')) )
+            chunk[len++] = '\\';
+        chunk[len++] = (char)c;
+    }   /* for (; p<end; p++) */
+    outputWrite (outputMd,chunk,len);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Run a segment of a compiled template other than a plain substitution (a transformed   */
+/* field, or the test and the jump of a section). It returns the next segment to run     */
+/*****************************************************************************************/
+static int runTemplateSegment (outputBuffer *outputMd, templateSegment *segment, fieldView fields[], int i)
+{
+    switch (segment->op)
+    {
+        case SEGFORMAT:
+            writeFormattedField (outputMd,segment,&fields[segment->fieldRef-1]);
+            break;
+        case SEGIF:
+            if (blankField(&fields[segment->fieldRef-1]))
+                return (segment->jump);
+            break;
+        case SEGELSE:
+            return (segment->jump);
+    }   /* switch (segment->op) */
+
+    return (i+1);
+}
+
+
+/*****************************************************************************************/
+/* Resolve the column names of a template (${name} and {{#if name}}) against the header  */
+/* row, so that rows are rendered with field numbers as for $N. A name missing from the  */
+/* header or found more than once is reported in error, and false is returned            */
+/*****************************************************************************************/
+static bool resolveMdTemplate (mdTemplate *tmpl, int fieldNo, fieldView header[], char *error, size_t errorLen)
+{
+    /* Local Variables */
+    templateSegment *segment;
+    char            *name;
+    int              i, j, column;
+
+    for (i=0; i<tmpl->segmentNo; i++)
+    {
+        segment = &tmpl->segments[i];
+        if (segment->name==NULL)
+            continue;
+        column = 0;
+        for (j=0; j<fieldNo; j++)
+        {
+            if ( (columnName(header[j].ptr,header[j].ptr+header[j].len,&name)!=segment->nameLen) ||
+                 (memcmp(name,segment->name,segment->nameLen)!=0) )
+                continue;
+            if (column>0)
+            {
+                snprintf (error,errorLen,"column name \"%.*s\" found more than once in the header (columns %d and %d)",(int)segment->nameLen,segment->name,column,j+1);
+                return (false);
+            }
+            column = j+1;
+        }   /* for (j=0; j<fieldNo; j++) */
+        if (column==0)
+        {
+            snprintf (error,errorLen,"column name \"%.*s\" not found in the header",(int)segment->nameLen,segment->name);
+            return (false);
+        }
+        segment->fieldRef = column;
+    }   /* for (i=0; i<tmpl->segmentNo; i++) */
+
+    /* Field references changed: update the summary used by the row checks and chapters */
+    tmpl->firstFieldRef = -1;
+    tmpl->maxFieldRef = 0;
+    tmpl->invalidRef = false;
+    tmpl->checkedFieldNo = -1;
+    for (i=0; i<tmpl->segmentNo; i++)
+    {
+        segment = &tmpl->segments[i];
+        if ( (tmpl->firstFieldRef<0) && ((segment->op==SEGFIELD) || (segment->op==SEGFORMAT)) )
+            tmpl->firstFieldRef = segment->fieldRef;
+        if ( (segment->fieldRef<=0) && ((segment->op==SEGFIELD) || (segment->op==SEGFORMAT) || (segment->op==SEGIF)) )
+            tmpl->invalidRef = true;
+        if (segment->fieldRef>tmpl->maxFieldRef)
+            tmpl->maxFieldRef = segment->fieldRef;
+    }   /* for (i=0; i<tmpl->segmentNo; i++) */
+
+    return (true);
+}
+
+
+/********************************************************************************************/
+/* This function appends to the output file a new section, obtained by copy/paste of the    */
+/* compiled markdown template, with all placeholder properly substitued by the content of   */
+/* the fields obtained from parsing the current csv input file                              */
+/* Please note that the output buffer shall be opened by the calling function before       */
+/* entering appendCsvRow2Output(), and the template shall be compiled by loadMdTemplate()   */
+/********************************************************************************************/
+static void appendCsvRow2Output (outputBuffer *outputMd, mdTemplate *tmpl, char placeHolder, int fieldNo, fieldView fields[])
+{
+    /* Local Variables */
+    templateSegment *segment;
+    int              i;
+
+    checkMdTemplate (tmpl,placeHolder,fieldNo);
+
+    /* Run the compiled template: each segment copies its literal text, then     */
+    /* substitutes a field or jumps over the branch of a section not selected    */
+    for (i=0; i<tmpl->segmentNo; )
+    {
+        segment = &tmpl->segments[i];
+        outputWrite (outputMd,segment->text,segment->textLen);
+        if (segment->op==SEGFIELD)
+            outputWrite (outputMd,fields[segment->fieldRef-1].ptr,fields[segment->fieldRef-1].len);
+        else if (segment->op!=SEGTEXT)
+        {
+            i = runTemplateSegment (outputMd,segment,fields,i);
+            continue;
+        }
+        i++;
+    }   /* for (i=0; i<tmpl->segmentNo; ) */
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Save a copy of the given field into a keyString (e.g. to remember the last chapter)   */
+/*****************************************************************************************/
+static void saveKeyString (keyString *key, fieldView *field)
+{
+    if (field->len>key->cap)
+    {
+        key->cap = 2*field->len;
+        if ( (key->ptr=realloc(key->ptr,key->cap))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+    }
+    memcpy (key->ptr,field->ptr,field->len);
+    key->len = field->len;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Compare a field with a keyString previously saved. It returns true if they are equal  */
+/*****************************************************************************************/
+static inline bool sameKeyString (keyString *key, fieldView *field)
+{
+    return ( (key->len==field->len) && (memcmp(key->ptr,field->ptr,field->len)==0) );
+}
+
+
+/*****************************************************************************************/
+/* Append a row to the output: if the field monitored by a chapter level changed with    */
+/* respect to the previous row, a new chapter is added for that level and for all the    */
+/* levels nested into it, then the row template is appended                             */
+/*****************************************************************************************/
+static void renderCsvRow (mdRenderer *rd, outputBuffer *outputMd, int fieldNo, fieldView fields[])
+{
+    /* Local Variables */
+    uint64_t    start = 0,
+                writeNs = 0;
+    int         level,
+                chapterFieldNo;
+    bool        changed = false;
+
+    if (rd->stats)
+    {
+        start = statsClock();
+        writeNs = rd->stats->writeNs;
+    }
+    for (level=0; level<rd->levelNo; level++)
+    {   /* Levels whose field is missing in the row are skipped. sameKeyString() compares */
+        /* the lengths first, and keys are not compared at all once a level changed       */
+        chapterFieldNo = rd->chapterFieldNo[level];
+        if ( (chapterFieldNo<1) || (chapterFieldNo>fieldNo) )
+            continue;
+        if ( !changed && sameKeyString(&rd->lastChapter[level],&fields[chapterFieldNo-1]) )
+            continue;
+        changed = true;
+        appendCsvRow2Output (outputMd,&rd->chapterTemplate[level],rd->placeHolder,fieldNo,fields);
+        saveKeyString (&rd->lastChapter[level],&fields[chapterFieldNo-1]);
+        if (rd->stats)
+            rd->stats->chapters += 1;
+    }   /* for (level=0; level<rd->levelNo; level++) */
+    appendCsvRow2Output (outputMd,&rd->rowTemplate,rd->placeHolder,fieldNo,fields);
+    if (rd->stats)
+    {   /* Time spent writing the output file is accounted separately */
+        rd->stats->rows += 1;
+        rd->stats->renderNs += statsClock() - start - (rd->stats->writeNs - writeNs);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Load the list of values of a predicate (option --where <column>@<file>): one value   */
+/* per line (empty lines are ignored), indexed by a hash table                           */
+/*****************************************************************************************/
+static void loadValueList (rowPredicate *pred, char *file)
+{
+    /* Local Variables */
+    struct stat st;
+    char       *p, *end, *eol;
+    size_t      valueNo = 0, cap = 0, i, b, mask;
+    int         fd;
+
+    if ( ((fd=open(file,O_RDONLY))<0) || (fstat(fd,&st)<0) ||
+         ((pred->value=malloc(st.st_size+1))==NULL) || (read(fd,pred->value,st.st_size)!=st.st_size) )
+    {
+        printf ("Unable to read the list of values of a row filter (%s)... Aborting\n\n",file);
+        exit (-1);
+    }
+    close (fd);
+    pred->valueLen = st.st_size;
+    pred->values = NULL;
+    end = pred->value + pred->valueLen;
+    for (p=pred->value; p<end; p=eol+1)
+    {
+        if ( (eol=memchr(p,'\n',end-p))==NULL )
+            eol = end;
+        if ( (eol>p) && (*(eol-1)=='\r') )
+            eol -= 1;
+        if (eol>p)
+        {
+            if (valueNo==cap)
+            {
+                cap = (cap==0) ? 1024 : 2*cap;
+                if ( (pred->values=realloc(pred->values,cap*sizeof(fieldView)))==NULL )
+                {
+                    printf ("Memory allocation failure... Aborting\n\n");
+                    exit (-1);
+                }
+            }   /* if (valueNo==cap) */
+            pred->values[valueNo].ptr = p;
+            pred->values[valueNo].len = eol - p;
+            valueNo += 1;
+        }
+        if ( (eol<end) && (*eol=='\r') )
+            eol += 1;
+    }   /* for (p=pred->value; p<end; p=eol+1) */
+
+    pred->bucketNo = 2;
+    while (pred->bucketNo<2*valueNo)
+        pred->bucketNo *= 2;
+    if ( (pred->buckets=calloc(pred->bucketNo,sizeof(size_t)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    mask = pred->bucketNo - 1;
+    for (i=0; i<valueNo; i++)
+    {
+        for (b=hashBytes(14695981039346656037ULL,pred->values[i].ptr,pred->values[i].len)&mask; pred->buckets[b]!=0; b=(b+1)&mask)
+            ;
+        pred->buckets[b] = i+1;
+    }   /* for (i=0; i<valueNo; i++) */
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Compile the row filters (options --where). Each one is made of a column number        */
+/* (optionally preceded by the placeholder), an operator (=, !=, ^=, <, <=, >, >= or @)  */
+/* and a value (a number for <, <=, > and >=, a file with the list of values for @).     */
+/* Predicates are sorted by field, so that the parser tests each field as soon as it is  */
+/* split, keeping the order given on the command line for the same field                 */
+/*****************************************************************************************/
+static void compileRowFilter (csvParser *ps, runOptions *opt)
+{
+    /* Local Variables */
+    static const struct { char *text; int op; } ops[] = { {"!=",WHERENE}, {"^=",WHEREPREFIX}, {"<=",WHERELE},
+                                                           {">=",WHEREGE}, {"=",WHEREEQ}, {"<",WHERELT},
+                                                           {">",WHEREGT}, {"@",WHEREIN} };
+    rowPredicate    pred;
+    char           *p, *end;
+    long            field;
+    int             i, j, k;
+
+    ps->predicateNo = opt->whereNo;
+    if (opt->whereNo==0)
+        return;
+    if ( (ps->predicates=calloc(opt->whereNo,sizeof(rowPredicate)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    for (i=0; i<opt->whereNo; i++)
+    {
+        memset (&pred,0,sizeof(rowPredicate));
+        p = opt->where[i];
+        if (*p==opt->placeHolder)
+            p += 1;
+        field = isdigit((unsigned char)*p) ? strtol(p,&p,10) : 0;
+        for (k=0; (k<(int)(sizeof(ops)/sizeof(ops[0]))) && (strncmp(p,ops[k].text,strlen(ops[k].text))!=0); k++)
+            ;
+        if ( (field<1) || (field>1000000) || (k==(int)(sizeof(ops)/sizeof(ops[0]))) )
+        {
+            printf ("Invalid row filter \"%s\" (... --where <column><=|!=|^=|<|<=|>|>=|@><value>)... Aborting\n\n",opt->where[i]);
+            exit (-1);
+        }
+        pred.field = field - 1;
+        pred.op = ops[k].op;
+        p += strlen (ops[k].text);
+        pred.value = p;
+        pred.valueLen = strlen (p);
+        if ( (pred.op==WHERELT) || (pred.op==WHERELE) || (pred.op==WHEREGT) || (pred.op==WHEREGE) )
+        {
+            pred.number = strtod (p,&end);
+            if ( (end==p) || (*end!='\0') )
+            {
+                printf ("Invalid number in row filter \"%s\"... Aborting\n\n",opt->where[i]);
+                exit (-1);
+            }
+        }
+        else if (pred.op==WHEREIN)
+            loadValueList (&pred,p);
+        for (j=i; (j>0) && (ps->predicates[j-1].field>pred.field); j--)
+            ps->predicates[j] = ps->predicates[j-1];
+        ps->predicates[j] = pred;
+    }   /* for (i=0; i<opt->whereNo; i++) */
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Release the memory allocated for the column projection and the row filters            */
+/*****************************************************************************************/
+static void freeRowFilter (csvParser *ps)
+{
+    /* Local Variables */
+    int i;
+
+    for (i=0; i<ps->predicateNo; i++)
+    {
+        if (ps->predicates[i].op==WHEREIN)
+        {
+            free (ps->predicates[i].value);
+            free (ps->predicates[i].values);
+            free (ps->predicates[i].buckets);
+        }
+    }   /* for (i=0; i<ps->predicateNo; i++) */
+    free (ps->predicates);
+    free (ps->firstPredicate);
+    free (ps->fieldWanted);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Column projection: mark the fields referenced by the templates, by the output path   */
+/* pattern (NULL if none), by the row filters and the key column (0-based, -1 if none), */
+/* so that the parser does not store the other ones and stops splitting a row after the */
+/* last referenced field. The arrays are owned by the caller (they are shared with the  */
+/* worker threads)                                                                       */
+/*****************************************************************************************/
+static void projectFields (csvParser *ps, mdRenderer *rd, mdTemplate *pathPattern, int keyField)
+{
+    /* Local Variables */
+    mdTemplate  *tmpl;
+    int          i, level;
+
+    ps->fieldLimit = rd->rowTemplate.maxFieldRef;
+    if ( (pathPattern!=NULL) && (pathPattern->maxFieldRef>ps->fieldLimit) )
+        ps->fieldLimit = pathPattern->maxFieldRef;
+    for (level=0; level<rd->levelNo; level++)
+    {
+        if (rd->chapterTemplate[level].maxFieldRef>ps->fieldLimit)
+            ps->fieldLimit = rd->chapterTemplate[level].maxFieldRef;
+    }   /* for (level=0; level<rd->levelNo; level++) */
+    for (i=0; i<ps->predicateNo; i++)
+    {
+        if (ps->predicates[i].field+1>ps->fieldLimit)
+            ps->fieldLimit = ps->predicates[i].field+1;
+    }   /* for (i=0; i<ps->predicateNo; i++) */
+    if (keyField+1>ps->fieldLimit)
+        ps->fieldLimit = keyField+1;
+    if ( ((ps->fieldWanted=calloc(ps->fieldLimit+1,sizeof(bool)))==NULL) ||
+         ((ps->predicateNo>0) && ((ps->firstPredicate=malloc((ps->fieldLimit+1)*sizeof(int)))==NULL)) )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    for (level=-2; level<rd->levelNo; level++)
+    {
+        tmpl = (level<-1) ? pathPattern : (level<0) ? &rd->rowTemplate : &rd->chapterTemplate[level];
+        for (i=0; (tmpl!=NULL) && (i<tmpl->segmentNo); i++)
+        {
+            if (tmpl->segments[i].fieldRef>0)
+                ps->fieldWanted[tmpl->segments[i].fieldRef-1] = true;
+        }   /* for (i=0; (tmpl!=NULL) && (i<tmpl->segmentNo); i++) */
+    }   /* for (level=-2; level<rd->levelNo; level++) */
+    if (keyField>=0)
+        ps->fieldWanted[keyField] = true;
+    if (ps->predicateNo>0)
+    {
+        for (i=0; i<=ps->fieldLimit; i++)
+            ps->firstPredicate[i] = -1;
+        for (i=ps->predicateNo-1; i>=0; i--)
+        {
+            ps->fieldWanted[ps->predicates[i].field] = true;
+            ps->firstPredicate[ps->predicates[i].field] = i;
+        }   /* for (i=ps->predicateNo-1; i>=0; i--) */
+    }   /* if (ps->predicateNo>0) */
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Hash of the value of a chapter field (64 bit FNV-1a), seeded with its level and with  */
+/* the enclosing chapter group, so that the same value under different chapters is a    */
+/* different group                                                                       */
+/*****************************************************************************************/
+static inline uint64_t hashKey (fieldView *key, int level, int parent)
+{
+    /* Local Variables */
+    uint64_t    hash = 14695981039346656037ULL;
+    size_t      i;
+
+    hash = (hash ^ (uint64_t)level) * 1099511628211ULL;
+    hash = (hash ^ (uint64_t)(uint32_t)parent) * 1099511628211ULL;
+    for (i=0; i<key->len; i++)
+        hash = (hash ^ (unsigned char)key->ptr[i]) * 1099511628211ULL;
+
+    return (hash);
+}
+
+
+/*****************************************************************************************/
+/* Initialize the index of chapter groups used when the input is not sorted by the      */
+/* chapter fields (option --group)                                                       */
+/*****************************************************************************************/
+static void openGroupIndex (groupIndex *gi, int order, size_t memLimit)
+{
+    memset (gi,0,sizeof(groupIndex));
+    gi->order = order;
+    gi->memLimit = memLimit;
+    gi->current = -1;
+    gi->firstRoot = -1;
+    gi->lastRoot = -1;
+    gi->spill.fd = -1;
+    gi->bucketNo = INITBUCKETS;
+    if ( (gi->buckets=calloc(gi->bucketNo,sizeof(int)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Return the group of the given chapter level, nested into the parent group, having    */
+/* the given value of the chapter field. A new (empty) group is added if this value has */
+/* never been found before under this parent; created is set accordingly                */
+/*****************************************************************************************/
+static int findChapterGroup (groupIndex *gi, int level, int parent, fieldView *key, bool *created)
+{
+    /* Local Variables */
+    chapterGroup   *group;
+    uint64_t        hash;
+    size_t          mask, b;
+    int            *buckets;
+    int             i;
+
+    hash = hashKey (key,level,parent);
+    mask = gi->bucketNo - 1;
+    for (b=hash&mask; gi->buckets[b]!=0; b=(b+1)&mask)
+    {
+        group = &gi->groups[gi->buckets[b]-1];
+        if ( (group->hash==hash) && (group->parent==parent) && (group->level==level) && sameKeyString(&group->key,key) )
+        {
+            *created = false;
+            return (gi->buckets[b]-1);
+        }
+    }   /* for (b=hash&mask; gi->buckets[b]!=0; b=(b+1)&mask) */
+
+    /* New chapter: keep the load factor of the hash index below 1/2 */
+    if (2*(size_t)(gi->groupNo+1)>gi->bucketNo)
+    {
+        if ( (buckets=calloc(2*gi->bucketNo,sizeof(int)))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+        gi->bucketNo *= 2;
+        mask = gi->bucketNo - 1;
+        for (i=0; i<gi->groupNo; i++)
+        {
+            for (b=gi->groups[i].hash&mask; buckets[b]!=0; b=(b+1)&mask)
+                ;
+            buckets[b] = i+1;
+        }   /* for (i=0; i<gi->groupNo; i++) */
+        free (gi->buckets);
+        gi->buckets = buckets;
+        for (b=hash&mask; gi->buckets[b]!=0; b=(b+1)&mask)
+            ;
+    }   /* if (2*(size_t)(gi->groupNo+1)>gi->bucketNo) */
+    if (gi->groupNo==gi->groupCap)
+    {
+        gi->groupCap = (gi->groupCap==0) ? INITBUCKETS/2 : 2*gi->groupCap;
+        if ( (gi->groups=realloc(gi->groups,gi->groupCap*sizeof(chapterGroup)))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+    }   /* if (gi->groupNo==gi->groupCap) */
+
+    group = &gi->groups[gi->groupNo];
+    memset (group,0,sizeof(chapterGroup));
+    saveKeyString (&group->key,key);
+    group->hash = hash;
+    group->level = level;
+    group->parent = parent;
+    group->firstChild = -1;
+    group->lastChild = -1;
+    group->nextSibling = -1;
+    gi->memUsed += group->key.cap;
+    gi->buckets[b] = gi->groupNo+1;
+
+    /* Link the group after the last one nested into the same parent */
+    if (parent<0)
+    {
+        if (gi->lastRoot<0)
+            gi->firstRoot = gi->groupNo;
+        else
+            gi->groups[gi->lastRoot].nextSibling = gi->groupNo;
+        gi->lastRoot = gi->groupNo;
+    }
+    else
+    {
+        if (gi->groups[parent].lastChild<0)
+            gi->groups[parent].firstChild = gi->groupNo;
+        else
+            gi->groups[gi->groups[parent].lastChild].nextSibling = gi->groupNo;
+        gi->groups[parent].lastChild = gi->groupNo;
+    }
+    gi->groupNo += 1;
+    *created = true;
+
+    return (gi->groupNo-1);
+}
+
+
+/*****************************************************************************************/
+/* Render a template into the buffer of a group, keeping track of the memory in use     */
+/*****************************************************************************************/
+static void appendToChapterGroup (groupIndex *gi, chapterGroup *group, mdTemplate *tmpl, char placeHolder, int fieldNo, fieldView fields[])
+{
+    /* Local Variables */
+    size_t  size;
+
+    if (group->out.buffer==NULL)
+    {
+        openMemoryOutput (&group->out,GROUPBUFSIZE);
+        gi->memUsed += GROUPBUFSIZE;
+    }
+    size = group->out.size;
+    appendCsvRow2Output (&group->out,tmpl,placeHolder,fieldNo,fields);
+    gi->memUsed += group->out.size - size;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Move the rendered rows of a group to the spill file, recording where they are stored */
+/*****************************************************************************************/
+static void spillChapterGroup (groupIndex *gi, chapterGroup *group)
+{
+    if (group->out.len==0)
+        return;
+
+    if (group->extentNo==group->extentCap)
+    {
+        group->extentCap = (group->extentCap==0) ? 4 : 2*group->extentCap;
+        if ( (group->extents=realloc(group->extents,group->extentCap*sizeof(spillExtent)))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+    }   /* if (group->extentNo==group->extentCap) */
+    group->extents[group->extentNo].offset = gi->spillSize;
+    group->extents[group->extentNo].len = group->out.len;
+    group->extentNo += 1;
+    outputWrite (&gi->spill,group->out.buffer,group->out.len);
+    gi->spillSize += group->out.len;
+
+    /* Give back the memory: the buffer is allocated again by the next row of the group */
+    free (group->out.buffer);
+    group->out.buffer = NULL;
+    group->out.size = 0;
+    group->out.len = 0;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Called when the groups exceed the memory budget (option --group-memory): the rows     */
+/* rendered so far are appended to an unlinked temporary file and read back only when   */
+/* the output is written                                                                 */
+/*****************************************************************************************/
+static void spillChapterGroups (groupIndex *gi)
+{
+    /* Local Variables */
+    char   *tmpDir,
+            spillFile[MAXFILENAMELEN+1];
+    int     i;
+
+    if (gi->spill.fd<0)
+    {
+        if ( ((tmpDir=getenv("TMPDIR"))==NULL) || (tmpDir[0]=='\0') )
+            tmpDir = "/tmp";
+        snprintf (spillFile,sizeof(spillFile),"%s/csv2mdTextXXXXXX",tmpDir);
+        if ( (gi->spill.fd=mkstemp(spillFile))<0 )
+        {
+            printf ("Unable to create the spill file in %s (%s)... Aborting\n\n",tmpDir,strerror(errno));
+            exit (-1);
+        }
+        unlink (spillFile);
+        gi->spill.direct = false;
+        gi->spill.syncPolicy = SYNCNONE;
+        gi->spill.stats = NULL;
+        gi->spill.size = DEFOUTBUFSIZE;
+        gi->spill.len = 0;
+        if ( (gi->spill.buffer=malloc(gi->spill.size))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+    }   /* if (gi->spill.fd<0) */
+
+    spillChapterGroup (gi,&gi->preamble);
+    for (i=0; i<gi->groupNo; i++)
+        spillChapterGroup (gi,&gi->groups[i]);
+
+    gi->memUsed = 0;
+    for (i=0; i<gi->groupNo; i++)
+        gi->memUsed += gi->groups[i].key.cap;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Render a row into the group of its innermost chapter (option --group). Groups form a  */
+/* tree, one level per chapter template; the chapter template of a group is rendered    */
+/* only once, with the first row of the group. Rows that do not have any chapter field  */
+/* join the group of the previous row, as they do without --group                       */
+/*****************************************************************************************/
+static void renderGroupedRow (mdRenderer *rd, groupIndex *gi, int fieldNo, fieldView fields[])
+{
+    /* Local Variables */
+    chapterGroup   *group;
+    int             level,
+                    chapterFieldNo,
+                    parent = -1;
+    bool            created;
+    uint64_t        start = 0;
+
+    if (rd->stats)
+        start = statsClock();
+    for (level=0; level<rd->levelNo; level++)
+    {
+        chapterFieldNo = rd->chapterFieldNo[level];
+        if ( (chapterFieldNo<1) || (chapterFieldNo>fieldNo) )
+            continue;
+        parent = findChapterGroup (gi,level,parent,&fields[chapterFieldNo-1],&created);
+        if (created)
+        {
+            appendToChapterGroup (gi,&gi->groups[parent],&rd->chapterTemplate[level],rd->placeHolder,fieldNo,fields);
+            if (rd->stats)
+                rd->stats->chapters += 1;
+        }
+    }   /* for (level=0; level<rd->levelNo; level++) */
+    if (parent>=0)
+        gi->current = parent;
+
+    group = (gi->current<0) ? &gi->preamble : &gi->groups[gi->current];
+    appendToChapterGroup (gi,group,&rd->rowTemplate,rd->placeHolder,fieldNo,fields);
+    if (rd->stats)
+    {
+        rd->stats->rows += 1;
+        start = statsLap (&rd->stats->renderNs,start);
+    }
+
+    if (gi->memUsed>gi->memLimit)
+    {   /* Time spent spilling is accounted as writing */
+        spillChapterGroups (gi);
+        if (rd->stats)
+            statsLap (&rd->stats->writeNs,start);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Compare two chapter groups by the value of the chapter field (qsort() callback)       */
+/*****************************************************************************************/
+static int compareChapterGroups (const void *a, const void *b)
+{
+    /* Local Variables */
+    const chapterGroup *ga = *(chapterGroup * const *)a,
+                       *gb = *(chapterGroup * const *)b;
+    size_t              len;
+    int                 cmp;
+
+    len = (ga->key.len<gb->key.len) ? ga->key.len : gb->key.len;
+    if ( (len>0) && ((cmp=memcmp(ga->key.ptr,gb->key.ptr,len))!=0) )
+        return (cmp);
+    if (ga->key.len!=gb->key.len)
+        return ( (ga->key.len<gb->key.len) ? -1 : 1 );
+    if (ga->level!=gb->level)
+        return ( (ga->level<gb->level) ? -1 : 1 );
+
+    return (0);
+}
+
+
+/*****************************************************************************************/
+/* Write a group to the output file: first its parts in the spill file (if any), then    */
+/* the rows still in memory. The group is released                                      */
+/*****************************************************************************************/
+static void writeChapterGroup (groupIndex *gi, chapterGroup *group, outputBuffer *outputMd, char *readBuffer)
+{
+    /* Local Variables */
+    off_t   offset;
+    size_t  len;
+    ssize_t readLen;
+    int     i;
+
+    for (i=0; i<group->extentNo; i++)
+    {
+        offset = group->extents[i].offset;
+        len = group->extents[i].len;
+        while (len>0)
+        {
+            readLen = pread (gi->spill.fd,readBuffer,(len<SPILLREADSIZE)?len:SPILLREADSIZE,offset);
+            if ( (readLen<0) && (errno==EINTR) )
+                continue;
+            if (readLen<=0)
+            {
+                printf ("Error reading the spill file (%s)... Aborting\n\n",(readLen<0)?strerror(errno):"truncated");
+                exit (-1);
+            }
+            outputWrite (outputMd,readBuffer,readLen);
+            offset += readLen;
+            len -= readLen;
+        }   /* while (len>0) */
+    }   /* for (i=0; i<group->extentNo; i++) */
+    if (group->out.buffer!=NULL)
+        outputWrite (outputMd,group->out.buffer,group->out.len);
+
+    free (group->out.buffer);
+    free (group->extents);
+    free (group->key.ptr);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Write the groups linked from first (and, depth first, the groups nested into them),   */
+/* in order of first appearance or sorted by the value of the chapter field. sorted is a */
+/* scratch array: each call uses the entries from its start for the groups of one level */
+/*****************************************************************************************/
+static void writeChapterGroupTree (groupIndex *gi, int first, outputBuffer *outputMd, char *readBuffer, chapterGroup **sorted)
+{
+    /* Local Variables */
+    int     i, n = 0;
+
+    for (i=first; i>=0; i=gi->groups[i].nextSibling)
+        sorted[n++] = &gi->groups[i];
+    if (gi->order==GROUPSORTED)
+        qsort (sorted,n,sizeof(chapterGroup *),compareChapterGroups);
+
+    for (i=0; i<n; i++)
+    {
+        writeChapterGroup (gi,sorted[i],outputMd,readBuffer);
+        writeChapterGroupTree (gi,sorted[i]->firstChild,outputMd,readBuffer,sorted+n);
+    }   /* for (i=0; i<n; i++) */
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Write all chapter groups to the output file and release the index                     */
+/*****************************************************************************************/
+static void writeChapterGroups (groupIndex *gi, outputBuffer *outputMd)
+{
+    /* Local Variables */
+    chapterGroup  **sorted;
+    char           *readBuffer = NULL;
+
+    if (gi->spill.fd>=0)
+    {
+        flushOutputBuffer (&gi->spill,false);
+        if ( (readBuffer=malloc(SPILLREADSIZE))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+    }   /* if (gi->spill.fd>=0) */
+    if ( (sorted=malloc((gi->groupNo+1)*sizeof(chapterGroup *)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+
+    writeChapterGroup (gi,&gi->preamble,outputMd,readBuffer);
+    writeChapterGroupTree (gi,gi->firstRoot,outputMd,readBuffer,sorted);
+
+    if (gi->spill.fd>=0)
+    {
+        close (gi->spill.fd);
+        free (gi->spill.buffer);
+        free (readBuffer);
+    }
+    free (sorted);
+    free (gi->groups);
+    free (gi->buckets);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Tell whether the output file given with -o is a path pattern, i.e. it contains the    */
+/* placeholder followed by a column number (e.g. site/$2.md)                             */
+/*****************************************************************************************/
+static bool isPathPattern (char *outputMdFile, char placeHolder)
+{
+    /* Local Variables */
+    char   *p;
+
+    for (p=strchr(outputMdFile,placeHolder); p!=NULL; p=strchr(p+1,placeHolder))
+        if (isdigit(p[1]))
+            return (true);
+
+    return (false);
+}
+
+
+/*****************************************************************************************/
+/* Compile an output path pattern into a list of literal segments and field references,  */
+/* as done for markdown templates by loadMdTemplate(). Unlike templates, the character   */
+/* following a placeholder is kept, a placeholder not followed by digits is literal text */
+/* and nothing is added at the end                                                       */
+/*****************************************************************************************/
+static void compilePathPattern (mdTemplate *tmpl, char *pattern, char placeHolder)
+{
+    /* Local Variables */
+    char       *p, *q, *r;
+    size_t      textLen;
+    int         currentField,
+                segmentMax = 1;
+
+    for (p=pattern; *p!='\0'; p++)
+        if (*p==placeHolder)
+            segmentMax += 1;
+    if ( ((tmpl->literals=malloc(strlen(pattern)+1))==NULL) ||
+         ((tmpl->segments=malloc(segmentMax*sizeof(templateSegment)))==NULL) )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    tmpl->segmentNo = 0;
+    tmpl->firstFieldRef = -1;
+    tmpl->maxFieldRef = 0;
+    tmpl->invalidRef = false;
+    tmpl->checkedFieldNo = -1;
+
+    r = tmpl->literals;
+    textLen = 0;
+    for (p=pattern; *p!='\0'; )
+    {
+        if ( (*p!=placeHolder) || !isdigit(p[1]) )
+        {
+            r[textLen++] = *p++;
+            continue;
+        }
+        currentField = 0;
+        for (q=p+1; isdigit(*q); q++)
+            currentField = 10*currentField + (int)(*q -'0');
+        addSegment (tmpl,&r,&textLen,SEGFIELD,currentField);
+        p = q;
+    }   /* for (p=pattern; *p!='\0'; ) */
+    addSegment (tmpl,&r,&textLen,SEGTEXT,-1);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Prepare the output files of a path pattern (option -o, e.g. site/$2.md): each row is */
+/* written to the file named after its fields. Files are opened when first needed; at   */
+/* most maxOpen of them (option --max-open, also limited by the file descriptors        */
+/* available) are kept open at once, each one with its own share of the output buffer   */
+/* (option --buffer-size). The least recently used file is closed to make room for a    */
+/* new one, and reopened in append mode if more rows are routed to it later             */
+/*****************************************************************************************/
+static void openFanOutput (fanOutput *fo, runOptions *opt)
+{
+    /* Local Variables */
+    struct rlimit   limit;
+    int             fdNo;
+
+    memset (fo,0,sizeof(fanOutput));
+    compilePathPattern (&fo->pattern,opt->outputMdFile,opt->placeHolder);
+    if (fo->pattern.invalidRef)
+    {
+        printf ("The output path pattern contains a placeholder (%c0) that refers to a non-existing field... Aborting\n\n",opt->placeHolder);
+        exit (-1);
+    }
+    fo->placeHolder = opt->placeHolder;
+    fo->maxOpen = opt->maxOpen;
+    fo->codec = outputCodec (opt->compress,opt->outputMdFile);
+    fdNo = (fo->codec==CODECNONE) ? 1 : 3;      /* A compressed file also uses a pipe */
+    if ( (getrlimit(RLIMIT_NOFILE,&limit)==0) && (limit.rlim_cur!=RLIM_INFINITY) &&
+         (limit.rlim_cur<(rlim_t)fo->maxOpen*fdNo+FDRESERVE) )
+        fo->maxOpen = (limit.rlim_cur>(rlim_t)(fdNo+1)*FDRESERVE) ? ((int)limit.rlim_cur-FDRESERVE)/fdNo : FDRESERVE/fdNo;
+    fo->bufSize = opt->outBufSize / fo->maxOpen;
+    fo->syncPolicy = opt->syncPolicy;
+    fo->appendMode = opt->appendMode;
+    fo->mru = -1;
+    fo->lru = -1;
+    fo->bucketNo = INITBUCKETS;
+    if ( (fo->buckets=calloc(fo->bucketNo,sizeof(int)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Expand the path pattern with the fields of the current row into fo->path. Slashes   */
+/* and null characters in the fields are replaced by '_', as well as fields that are    */
+/* empty, "." or "..", so that a field cannot lead the file outside of the directories */
+/* given in the pattern                                                                  */
+/*****************************************************************************************/
+static void expandFanOutPath (fanOutput *fo, int fieldNo, fieldView fields[])
+{
+    /* Local Variables */
+    templateSegment    *segment;
+    fieldView          *field;
+    size_t              len = 0,
+                        i;
+    int                 j;
+
+    if (!fitsMdTemplate(&fo->pattern,fieldNo))
+    {
+        printf ("The output path pattern contains a placeholder (%c%d) that refers to a non-existing field... Aborting\n\n",fo->placeHolder,fo->pattern.maxFieldRef);
+        exit (-1);
+    }
+    for (j=0; j<fo->pattern.segmentNo; j++)
+    {
+        segment = &fo->pattern.segments[j];
+        len += segment->textLen + ((segment->fieldRef>0) ? fields[segment->fieldRef-1].len+1 : 0);
+    }   /* for (j=0; j<fo->pattern.segmentNo; j++) */
+    if (len+1>fo->pathCap)
+    {
+        fo->pathCap = 2*(len+1);
+        if ( (fo->path=realloc(fo->path,fo->pathCap))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+    }
+
+    len = 0;
+    for (j=0; j<fo->pattern.segmentNo; j++)
+    {
+        segment = &fo->pattern.segments[j];
+        memcpy (fo->path+len,segment->text,segment->textLen);
+        len += segment->textLen;
+        if (segment->fieldRef<=0)
+            continue;
+        field = &fields[segment->fieldRef-1];
+        if ( (field->len==0) || ((field->len<=2) && (memcmp(field->ptr,"..",field->len)==0)) )
+        {
+            fo->path[len++] = '_';
+            continue;
+        }
+        for (i=0; i<field->len; i++)
+            fo->path[len++] = ( (field->ptr[i]=='/') || (field->ptr[i]=='\0') ) ? '_' : field->ptr[i];
+    }   /* for (j=0; j<fo->pattern.segmentNo; j++) */
+    fo->path[len] = '\0';
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Return the output file whose path is fo->path, adding it (still closed) the first    */
+/* time it is found                                                                      */
+/*****************************************************************************************/
+static int findFanOutFile (fanOutput *fo)
+{
+    /* Local Variables */
+    fanOutFile *file;
+    uint64_t    hash;
+    size_t      mask, b;
+    int        *buckets;
+    int         i;
+
+    hash = hashBytes (14695981039346656037ULL,fo->path,strlen(fo->path));
+    mask = fo->bucketNo - 1;
+    for (b=hash&mask; fo->buckets[b]!=0; b=(b+1)&mask)
+    {
+        file = &fo->files[fo->buckets[b]-1];
+        if ( (file->hash==hash) && (strcmp(file->path,fo->path)==0) )
+            return (fo->buckets[b]-1);
+    }   /* for (b=hash&mask; fo->buckets[b]!=0; b=(b+1)&mask) */
+
+    /* New file: keep the load factor of the hash index below 1/2 */
+    if (2*(size_t)(fo->fileNo+1)>fo->bucketNo)
+    {
+        if ( (buckets=calloc(2*fo->bucketNo,sizeof(int)))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+        fo->bucketNo *= 2;
+        mask = fo->bucketNo - 1;
+        for (i=0; i<fo->fileNo; i++)
+        {
+            for (b=fo->files[i].hash&mask; buckets[b]!=0; b=(b+1)&mask)
+                ;
+            buckets[b] = i+1;
+        }   /* for (i=0; i<fo->fileNo; i++) */
+        free (fo->buckets);
+        fo->buckets = buckets;
+        for (b=hash&mask; fo->buckets[b]!=0; b=(b+1)&mask)
+            ;
+    }   /* if (2*(size_t)(fo->fileNo+1)>fo->bucketNo) */
+    if (fo->fileNo==fo->fileCap)
+    {
+        fo->fileCap = (fo->fileCap==0) ? INITBUCKETS/2 : 2*fo->fileCap;
+        if ( (fo->files=realloc(fo->files,fo->fileCap*sizeof(fanOutFile)))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+    }   /* if (fo->fileNo==fo->fileCap) */
+
+    file = &fo->files[fo->fileNo];
+    memset (file,0,sizeof(fanOutFile));
+    if ( (file->path=strdup(fo->path))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    file->hash = hash;
+    file->out.fd = -1;
+    file->prev = -1;
+    file->next = -1;
+    fo->buckets[b] = fo->fileNo+1;
+    fo->fileNo += 1;
+
+    return (fo->fileNo-1);
+}
+
+
+/*****************************************************************************************/
+/* Remove an open file from the list of open files (most recently used first)           */
+/*****************************************************************************************/
+static void unlinkFanOutFile (fanOutput *fo, int i)
+{
+    /* Local Variables */
+    fanOutFile *file = &fo->files[i];
+
+    if (file->prev<0)
+        fo->mru = file->next;
+    else
+        fo->files[file->prev].next = file->next;
+    if (file->next<0)
+        fo->lru = file->prev;
+    else
+        fo->files[file->next].prev = file->prev;
+    file->prev = -1;
+    file->next = -1;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Create the missing directories of the given path (errors are reported when the file  */
+/* is opened)                                                                            */
+/*****************************************************************************************/
+static void makeParentDirs (char *path)
+{
+    /* Local Variables */
+    char   *p;
+
+    for (p=strchr(path+1,'/'); p!=NULL; p=strchr(p+1,'/'))
+    {
+        *p = '\0';
+        mkdir (path,0777);
+        *p = '/';
+    }   /* for (p=strchr(path+1,'/'); p!=NULL; p=strchr(p+1,'/')) */
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Make the given output file the most recently used one, opening it if needed: the    */
+/* least recently used file is closed first when maxOpen files are already open. A file */
+/* is truncated the first time it is opened (unless -a was given), after creating its   */
+/* directories, and reopened in append mode afterwards                                   */
+/*****************************************************************************************/
+static fanOutFile *useFanOutFile (fanOutput *fo, int i)
+{
+    /* Local Variables */
+    fanOutFile *file = &fo->files[i];
+    int         lru;
+
+    if (fo->mru==i)
+        return (file);
+
+    if (file->out.fd>=0)
+        unlinkFanOutFile (fo,i);
+    else
+    {
+        if (fo->openNo==fo->maxOpen)
+        {
+            lru = fo->lru;
+            unlinkFanOutFile (fo,lru);
+            closeOutputBuffer (&fo->files[lru].out);
+            fo->files[lru].out.fd = -1;
+            fo->openNo -= 1;
+        }   /* if (fo->openNo==fo->maxOpen) */
+        if (!file->created)
+            makeParentDirs (file->path);
+        openOutputBuffer (&file->out,file->path,file->created||fo->appendMode,fo->bufSize,fo->syncPolicy,fo->codec);
+        file->out.stats = fo->stats;
+        if (fo->stats)
+        {
+            if (file->created)
+                fo->stats->reopenedFiles += 1;
+            else
+                fo->stats->outputFiles += 1;
+        }
+        file->created = true;
+        fo->openNo += 1;
+    }
+    file->next = fo->mru;
+    if (fo->mru>=0)
+        fo->files[fo->mru].prev = i;
+    fo->mru = i;
+    if (fo->lru<0)
+        fo->lru = i;
+
+    return (file);
+}
+
+
+/*****************************************************************************************/
+/* Append a row to the output file named after its fields (output path pattern). Each   */
+/* file has its own chapters, swapped in and out of the renderer                         */
+/*****************************************************************************************/
+static void renderFanOutRow (mdRenderer *rd, fanOutput *fo, int fieldNo, fieldView fields[])
+{
+    /* Local Variables */
+    fanOutFile *file;
+
+    expandFanOutPath (fo,fieldNo,fields);
+    file = useFanOutFile (fo,findFanOutFile(fo));
+    memcpy (rd->lastChapter,file->lastChapter,sizeof(rd->lastChapter));
+    renderCsvRow (rd,&file->out,fieldNo,fields);
+    memcpy (file->lastChapter,rd->lastChapter,sizeof(rd->lastChapter));
+    memset (rd->lastChapter,0,sizeof(rd->lastChapter));
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Flush and close the output files still open, and release the output path pattern    */
+/*****************************************************************************************/
+static void closeFanOutput (fanOutput *fo)
+{
+    /* Local Variables */
+    int i, level;
+
+    for (i=0; i<fo->fileNo; i++)
+    {
+        if (fo->files[i].out.fd>=0)
+            closeOutputBuffer (&fo->files[i].out);
+        for (level=0; level<MAXLEVELS; level++)
+            free (fo->files[i].lastChapter[level].ptr);
+        free (fo->files[i].path);
+    }   /* for (i=0; i<fo->fileNo; i++) */
+    freeMdTemplate (&fo->pattern);
+    free (fo->files);
+    free (fo->buckets);
+    free (fo->path);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Hash of everything the markdown of a row depends on: its fields and the chapters      */
+/* enclosing the previous row (which decide whether chapter headings are added)          */
+/*****************************************************************************************/
+static uint64_t hashCsvRow (mdRenderer *rd, int fieldNo, fieldView fields[])
+{
+    /* Local Variables */
+    uint64_t    hash = 14695981039346656037ULL;
+    int         i;
+
+    for (i=0; i<rd->levelNo; i++)
+    {
+        hash = hashBytes (hash,&rd->lastChapter[i].len,sizeof(size_t));
+        hash = hashBytes (hash,rd->lastChapter[i].ptr,rd->lastChapter[i].len);
+    }   /* for (i=0; i<rd->levelNo; i++) */
+    hash = hashBytes (hash,&fieldNo,sizeof(int));
+    for (i=0; i<fieldNo; i++)
+    {
+        hash = hashBytes (hash,&fields[i].len,sizeof(size_t));
+        hash = hashBytes (hash,fields[i].ptr,fields[i].len);
+    }   /* for (i=0; i<fieldNo; i++) */
+
+    return (hash);
+}
+
+
+/*****************************************************************************************/
+/* Hash of a compiled markdown template                                                  */
+/*****************************************************************************************/
+static uint64_t hashMdTemplate (uint64_t hash, mdTemplate *tmpl)
+{
+    /* Local Variables */
+    int i;
+
+    hash = hashBytes (hash,&tmpl->segmentNo,sizeof(int));
+    for (i=0; i<tmpl->segmentNo; i++)
+    {
+        hash = hashBytes (hash,&tmpl->segments[i].textLen,sizeof(size_t));
+        hash = hashBytes (hash,tmpl->segments[i].text,tmpl->segments[i].textLen);
+        hash = hashBytes (hash,&tmpl->segments[i].fieldRef,sizeof(int));
+        /* Plain substitutions hash as before, so existing indexes remain valid */
+        if (tmpl->segments[i].op>SEGFIELD)
+        {
+            hash = hashBytes (hash,&tmpl->segments[i].op,sizeof(int));
+            hash = hashBytes (hash,&tmpl->segments[i].transforms,sizeof(int));
+            hash = hashBytes (hash,&tmpl->segments[i].jump,sizeof(int));
+            hash = hashBytes (hash,&tmpl->segments[i].defaultLen,sizeof(size_t));
+            if (tmpl->segments[i].defaultText!=NULL)
+                hash = hashBytes (hash,tmpl->segments[i].defaultText,tmpl->segments[i].defaultLen);
+        }
+    }   /* for (i=0; i<tmpl->segmentNo; i++) */
+
+    return (hash);
+}
+
+
+/*****************************************************************************************/
+/* Open the output file in incremental mode (option --incremental). The index of the     */
+/* previous run is loaded if it was produced with the same templates and options, and   */
+/* if the output file it describes is still there; otherwise every row is rendered. The */
+/* new output is written to a temporary file, renamed by closeRowIndex()                 */
+/*****************************************************************************************/
+static void openRowIndex (rowIndex *ri, outputBuffer *out, runOptions *opt, mdRenderer *rd)
+{
+    /* Local Variables */
+    FILE       *indexFd;
+    char        magic[sizeof(INDEXMAGIC)];
+    uint64_t    header[3] = {0},
+                offset = 0;
+    struct stat st;
+    size_t      i, b, mask;
+    int         level;
+
+    memset (ri,0,sizeof(rowIndex));
+    ri->oldFd = -1;
+    strcpy (ri->indexFile,opt->indexFile);
+    strcpy (ri->outputFile,opt->outputMdFile);
+    snprintf (ri->tmpOutputFile,sizeof(ri->tmpOutputFile),"%s.tmp",opt->outputMdFile);
+
+    /* Everything that changes the markdown of all rows invalidates the whole index */
+    ri->optionsHash = hashBytes (14695981039346656037ULL,INDEXMAGIC,sizeof(INDEXMAGIC));
+    ri->optionsHash = hashBytes (ri->optionsHash,&opt->separator,1);
+    ri->optionsHash = hashBytes (ri->optionsHash,&opt->comment,1);
+    ri->optionsHash = hashBytes (ri->optionsHash,&opt->multiLine,1);
+    if (opt->rfc4180)                       /* Existing indexes stay valid otherwise */
+        ri->optionsHash = hashBytes (ri->optionsHash,"rfc4180",7);
+    ri->optionsHash = hashBytes (ri->optionsHash,&opt->skipHeader,sizeof(bool));
+    ri->optionsHash = hashMdTemplate (ri->optionsHash,&rd->rowTemplate);
+    ri->optionsHash = hashBytes (ri->optionsHash,&rd->levelNo,sizeof(int));
+    for (level=0; level<rd->levelNo; level++)
+    {
+        ri->optionsHash = hashBytes (ri->optionsHash,&rd->chapterFieldNo[level],sizeof(int));
+        ri->optionsHash = hashMdTemplate (ri->optionsHash,&rd->chapterTemplate[level]);
+    }   /* for (level=0; level<rd->levelNo; level++) */
+
+    /* Load the index of the previous run: header (options hash, size of the output */
+    /* file, number of rows) followed by the hash and the length of each row        */
+    if ( (indexFd=fopen(ri->indexFile,"r"))!=NULL )
+    {
+        if ( (fread(magic,1,sizeof(magic),indexFd)==sizeof(magic)) && (memcmp(magic,INDEXMAGIC,sizeof(magic))==0) &&
+             (fread(header,sizeof(uint64_t),3,indexFd)==3) && (header[0]==ri->optionsHash) &&
+             ((ri->rows=malloc((header[2]+1)*sizeof(rowIndexEntry)))!=NULL) &&
+             (fread(ri->rows,sizeof(rowIndexEntry),header[2],indexFd)==header[2]) &&
+             (((ri->oldFd=open(ri->outputFile,O_RDWR))>=0) || ((ri->oldFd=open(ri->outputFile,O_RDONLY))>=0)) &&
+             (fstat(ri->oldFd,&st)==0) && ((uint64_t)st.st_size==header[1]) )
+        {
+            ri->rowNo = header[2];
+            ri->oldSize = header[1];
+            ri->writable = ( (fcntl(ri->oldFd,F_GETFL) & O_ACCMODE)==O_RDWR );
+        }
+        fclose (indexFd);
+    }   /* if ( (indexFd=fopen(ri->indexFile,"r"))!=NULL ) */
+
+    /* Offsets of the rows in the old output and hash index of the rows (the first one */
+    /* is kept if several rows have the same hash, since they have the same markdown)  */
+    ri->bucketNo = 2;
+    while (ri->bucketNo<2*ri->rowNo)
+        ri->bucketNo *= 2;
+    if ( ((ri->offsets=malloc((ri->rowNo+1)*sizeof(uint64_t)))==NULL) ||
+         ((ri->buckets=calloc(ri->bucketNo,sizeof(size_t)))==NULL) )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    mask = ri->bucketNo - 1;
+    for (i=0; i<ri->rowNo; i++)
+    {
+        ri->offsets[i] = offset;
+        offset += ri->rows[i].len;
+        for (b=ri->rows[i].hash&mask; (ri->buckets[b]!=0) && (ri->rows[ri->buckets[b]-1].hash!=ri->rows[i].hash); b=(b+1)&mask)
+            ;
+        if (ri->buckets[b]==0)
+            ri->buckets[b] = i+1;
+    }   /* for (i=0; i<ri->rowNo; i++) */
+    if ( (ri->oldFd>=0) && ((ri->rowNo==0) || (offset!=ri->oldSize)) )
+    {   /* Empty or inconsistent index: render everything */
+        close (ri->oldFd);
+        ri->oldFd = -1;
+        ri->rowNo = 0;
+        ri->oldSize = 0;
+        ri->writable = false;
+        memset (ri->buckets,0,ri->bucketNo*sizeof(size_t));
+    }
+
+    openOutputBuffer (out,ri->tmpOutputFile,false,opt->outBufSize,opt->syncPolicy,CODECNONE);
+    openMemoryOutput (&ri->scratch,GROUPBUFSIZE);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Copy len bytes from inFd (at inOffset) to outFd, at *outOffset or at the current     */
+/* position if outOffset is NULL. The copy is done by the kernel (copy_file_range())    */
+/* when possible, otherwise through the (already flushed) output buffer                  */
+/*****************************************************************************************/
+static void copyFileData (outputBuffer *out, int inFd, loff_t inOffset, int outFd, loff_t *outOffset, uint64_t len)
+{
+    /* Local Variables */
+    ssize_t     copied, written;
+    uint64_t    start = 0;
+    char       *p;
+
+    if (out->stats)
+    {
+        start = statsClock();
+        out->stats->bytesOut += len;
+    }
+    while (len>0)
+    {
+        copied = copy_file_range (inFd,&inOffset,outFd,outOffset,len,0);
+        if ( (copied<0) && (errno==EINTR) )
+            continue;
+        if (copied<=0)
+        {   /* Not supported (e.g. across file systems) */
+            if ( (copied=pread(inFd,out->buffer,(len<out->size)?len:out->size,inOffset))<=0 )
+            {
+                if ( (copied<0) && (errno==EINTR) )
+                    continue;
+                printf ("Error reading the previous output Markdown File (%s)... Aborting\n\n",(copied<0)?strerror(errno):"truncated");
+                exit (-1);
+            }
+            inOffset += copied;
+            for (p=out->buffer; p<out->buffer+copied; p+=written)
+            {
+                written = (outOffset!=NULL) ? pwrite(outFd,p,out->buffer+copied-p,*outOffset) : write(outFd,p,out->buffer+copied-p);
+                if (written<0)
+                {
+                    if (errno==EINTR)
+                    {
+                        written = 0;
+                        continue;
+                    }
+                    printf ("Error writing output Markdown File (%s)... Aborting\n\n",strerror(errno));
+                    exit (-1);
+                }
+                if (outOffset!=NULL)
+                    *outOffset += written;
+            }   /* for (p=out->buffer; p<out->buffer+copied; p+=written) */
+        }
+        len -= copied;
+    }   /* while (len>0) */
+    if (out->stats)
+        statsLap (&out->stats->writeNs,start);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Copy the pending run of unchanged rows from the previous output to the new one        */
+/*****************************************************************************************/
+static void copyOldOutput (rowIndex *ri, outputBuffer *out)
+{
+    if (ri->runLen==0)
+        return;
+
+    flushOutputBuffer (out,true);
+    copyFileData (out,ri->oldFd,ri->runStart,out->fd,NULL,ri->runLen);
+    ri->runLen = 0;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Called at the first row that differs from the previous run: up to here the previous  */
+/* output is unchanged (keepLen bytes) and nothing has been written yet. If that is the */
+/* larger part of it, the previous output is patched in place (the rest of the new      */
+/* output goes to the temporary file and it is copied over the previous output at the   */
+/* end); otherwise the new output is assembled in the temporary file, starting with the */
+/* unchanged part                                                                         */
+/*****************************************************************************************/
+static void divergeRowIndex (rowIndex *ri)
+{
+    ri->diverged = true;
+    if ( ri->writable && (ri->keepLen>0) && (2*ri->keepLen>=ri->oldSize) )
+        ri->patch = true;
+    else
+    {
+        ri->runStart = 0;
+        ri->runLen = ri->keepLen;
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Render a row in incremental mode: if a row with the same hash was rendered by the    */
+/* previous run, its markdown is copied from the previous output (consecutive rows with */
+/* a single copy), otherwise it is rendered. The new index is built along the way        */
+/*****************************************************************************************/
+static void renderIndexedRow (mdRenderer *rd, rowIndex *ri, outputBuffer *out, int fieldNo, fieldView fields[])
+{
+    /* Local Variables */
+    uint64_t    hash;
+    size_t      b, mask, old = 0;
+    int         level,
+                chapterFieldNo;
+    bool        found = false;
+
+    hash = hashCsvRow (rd,fieldNo,fields);
+    if ( (ri->next<ri->rowNo) && (ri->rows[ri->next].hash==hash) )
+    {   /* Most rows are unchanged: try the row following the last one reused first */
+        old = ri->next;
+        found = true;
+    }
+    else if (ri->rowNo>0)
+    {
+        mask = ri->bucketNo - 1;
+        for (b=hash&mask; ri->buckets[b]!=0; b=(b+1)&mask)
+        {
+            if (ri->rows[ri->buckets[b]-1].hash==hash)
+            {
+                old = ri->buckets[b]-1;
+                found = true;
+                break;
+            }
+        }   /* for (b=hash&mask; ri->buckets[b]!=0; b=(b+1)&mask) */
+    }
+
+    if (ri->newRowNo==ri->newRowCap)
+    {
+        ri->newRowCap = (ri->newRowCap==0) ? 4096 : 2*ri->newRowCap;
+        if ( (ri->newRows=realloc(ri->newRows,ri->newRowCap*sizeof(rowIndexEntry)))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+    }   /* if (ri->newRowNo==ri->newRowCap) */
+    ri->newRows[ri->newRowNo].hash = hash;
+
+    if ( !ri->diverged && !(found && (old==ri->next)) )
+        divergeRowIndex (ri);
+    if (found)
+    {
+        if (!ri->diverged)
+            ri->keepLen += ri->rows[old].len;
+        else if ( (ri->runLen>0) && (ri->runStart+ri->runLen==ri->offsets[old]) )
+            ri->runLen += ri->rows[old].len;
+        else
+        {
+            copyOldOutput (ri,out);
+            ri->runStart = ri->offsets[old];
+            ri->runLen = ri->rows[old].len;
+        }
+        ri->next = old+1;
+        ri->newRows[ri->newRowNo].len = ri->rows[old].len;
+        for (level=0; level<rd->levelNo; level++)
+        {   /* Keep track of the chapters, as renderCsvRow() would do */
+            chapterFieldNo = rd->chapterFieldNo[level];
+            if ( (chapterFieldNo>=1) && (chapterFieldNo<=fieldNo) )
+                saveKeyString (&rd->lastChapter[level],&fields[chapterFieldNo-1]);
+        }   /* for (level=0; level<rd->levelNo; level++) */
+        if (rd->stats)
+        {
+            rd->stats->rows += 1;
+            rd->stats->reusedRows += 1;
+        }
+    }
+    else
+    {
+        copyOldOutput (ri,out);
+        ri->scratch.len = 0;
+        renderCsvRow (rd,&ri->scratch,fieldNo,fields);
+        outputWrite (out,ri->scratch.buffer,ri->scratch.len);
+        ri->newRows[ri->newRowNo].len = ri->scratch.len;
+    }
+    ri->newRowNo += 1;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Free the memory used by the index of rows (option --incremental)                      */
+/*****************************************************************************************/
+static void freeRowIndex (rowIndex *ri)
+{
+    free (ri->rows);
+    free (ri->offsets);
+    free (ri->buckets);
+    free (ri->newRows);
+    free (ri->scratch.buffer);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Complete the output in incremental mode. If nothing changed, the previous output is   */
+/* left untouched; if it is patched in place, the index is removed first, so that an     */
+/* interrupted patch is detected by the next run (the sizes do not match). Otherwise the */
+/* new output replaces the previous one by means of rename(). The new index is written   */
+/* to a temporary file as well, renamed when complete                                    */
+/*****************************************************************************************/
+static void closeRowIndex (rowIndex *ri, outputBuffer *out)
+{
+    /* Local Variables */
+    FILE           *indexFd;
+    char            tmpIndexFile[MAXFILENAMELEN+5];
+    uint64_t        header[3] = {0};
+    loff_t          offset;
+    struct stat     st;
+    int             tmpFd;
+    size_t          i;
+
+    if ( !ri->diverged && ((ri->oldFd<0) || (ri->keepLen<ri->oldSize)) )
+        divergeRowIndex (ri);       /* No previous output, or rows deleted at the end */
+    copyOldOutput (ri,out);
+    if (!ri->diverged)
+    {   /* Same rows as the previous run: output and index are still valid */
+        out->syncPolicy = SYNCNONE;
+        closeOutputBuffer (out);
+        unlink (ri->tmpOutputFile);
+        close (ri->oldFd);
+        freeRowIndex (ri);
+        return;
+    }
+    else if (ri->patch)
+    {
+        flushOutputBuffer (out,true);
+        unlink (ri->indexFile);
+        if ( ((tmpFd=open(ri->tmpOutputFile,O_RDONLY))<0) || (fstat(tmpFd,&st)<0) )
+        {
+            printf ("Unable to open the temporary output Markdown File (%s)... Aborting\n\n",strerror(errno));
+            exit (-1);
+        }
+        offset = ri->keepLen;
+        copyFileData (out,tmpFd,0,ri->oldFd,&offset,st.st_size);
+        if ( (ftruncate(ri->oldFd,offset)<0) ||
+             ((out->syncPolicy!=SYNCNONE) && (fdatasync(ri->oldFd)<0) && (errno!=EINVAL)) )
+        {
+            printf ("Error writing output Markdown File (%s)... Aborting\n\n",strerror(errno));
+            exit (-1);
+        }
+        close (tmpFd);
+        out->syncPolicy = SYNCNONE;
+        closeOutputBuffer (out);
+        unlink (ri->tmpOutputFile);
+    }
+    else
+    {
+        closeOutputBuffer (out);
+        if (rename(ri->tmpOutputFile,ri->outputFile)<0)
+        {
+            printf ("Unable to replace output Markdown File (%s)... Aborting\n\n",strerror(errno));
+            exit (-1);
+        }
+    }
+    if (ri->oldFd>=0)
+        close (ri->oldFd);
+
+    header[0] = ri->optionsHash;
+    for (i=0; i<ri->newRowNo; i++)
+        header[1] += ri->newRows[i].len;
+    header[2] = ri->newRowNo;
+    snprintf (tmpIndexFile,sizeof(tmpIndexFile),"%s.tmp",ri->indexFile);
+    if ( ((indexFd=fopen(tmpIndexFile,"w"))==NULL) ||
+         (fwrite(INDEXMAGIC,1,sizeof(INDEXMAGIC),indexFd)!=sizeof(INDEXMAGIC)) ||
+         (fwrite(header,sizeof(uint64_t),3,indexFd)!=3) ||
+         (fwrite(ri->newRows,sizeof(rowIndexEntry),ri->newRowNo,indexFd)!=ri->newRowNo) ||
+         (fclose(indexFd)!=0) || (rename(tmpIndexFile,ri->indexFile)<0) )
+    {
+        printf ("Unable to write the index file (%s)... Aborting\n\n",strerror(errno));
+        exit (-1);
+    }
+
+    freeRowIndex (ri);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Build the record index of the input CSV file: the offset of the first line of each   */
+/* row, following the same rules used for rendering (empty lines and comments are not   */
+/* rows, a multi line row is a single row, the header is a row as well). Fields are not */
+/* extracted, and the parser is moved back to the start of the input afterwards         */
+/*****************************************************************************************/
+static void buildRecordIndex (recordIndex *rx, csvParser *ps)
+{
+    /* Local Variables */
+    runStats   *stats = ps->stats;
+    bool        skipHeader = ps->skipHeader,
+                skipFields = ps->skipFields;
+    size_t      cap = 1024;
+
+    if ( (rx->offsets=malloc(cap*sizeof(uint64_t)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    ps->stats = NULL;
+    ps->skipHeader = false;
+    ps->skipFields = true;
+    seekCsv (ps,0,ps->in.size);
+    while ( readCsvRow(ps) )
+    {
+        if (rx->recordNo==cap)
+        {
+            cap *= 2;
+            if ( (rx->offsets=realloc(rx->offsets,cap*sizeof(uint64_t)))==NULL )
+            {
+                printf ("Memory allocation failure... Aborting\n\n");
+                exit (-1);
+            }
+        }   /* if (rx->recordNo==cap) */
+        rx->offsets[rx->recordNo++] = ps->rowStart;
+    }   /* while ( readCsvRow(ps) ) */
+    seekCsv (ps,0,ps->in.size);
+    ps->lineNo = 0;
+    ps->stats = stats;
+    ps->skipHeader = skipHeader;
+    ps->skipFields = skipFields;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Signature of the input CSV file stored in the index files: size, modification time    */
+/* and the characters that decide the row boundaries. It returns false if the input is   */
+/* not a regular file                                                                     */
+/*****************************************************************************************/
+static bool inputSignature (uint64_t signature[4], csvParser *ps, char *inputCsvFile)
+{
+    /* Local Variables */
+    struct stat st;
+
+    if ( (strcmp(inputCsvFile,"-")==0) || (ps->in.codec!=NULL) || (stat(inputCsvFile,&st)<0) || !S_ISREG(st.st_mode) )
+        return (false);
+    signature[0] = st.st_size;
+    signature[1] = st.st_mtim.tv_sec;
+    signature[2] = st.st_mtim.tv_nsec;
+    signature[3] = (unsigned char)ps->comment | ((unsigned char)ps->multiLine<<8) | ((uint64_t)ps->rfc4180<<16);
+
+    return (true);
+}
+
+
+/*****************************************************************************************/
+/* Open the record index of the input CSV file (option --record-index). The index file   */
+/* is mapped as it is if it matches the size and the modification time of the input    */
+/* and the characters that decide the row boundaries; otherwise it is rebuilt and       */
+/* written to a temporary file, renamed when complete                                    */
+/*****************************************************************************************/
+static void openRecordIndex (recordIndex *rx, csvParser *ps, char *indexFile, char *inputCsvFile)
+{
+    /* Local Variables */
+    FILE       *indexFd;
+    char        tmpIndexFile[MAXFILENAMELEN+5];
+    uint64_t    header[5],
+               *stored;
+    struct stat st;
+    void       *map;
+    int         fd;
+
+    memset (rx,0,sizeof(recordIndex));
+    if (!inputSignature(header,ps,inputCsvFile))
+    {
+        printf ("The record index requires a regular uncompressed input csv file (... --record-index <index_file>)... Aborting\n\n");
+        exit (-1);
+    }
+
+    /* Header: signature of the input (see inputSignature()) and number of records, */
+    /* followed by the offset of each record                                        */
+    if ( (fd=open(indexFile,O_RDONLY))>=0 )
+    {
+        if ( (fstat(fd,&st)==0) && ((size_t)st.st_size>=sizeof(header)+8) &&
+             ((map=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0))!=MAP_FAILED) )
+        {
+            stored = (uint64_t *)((char *)map+8);
+            if ( (memcmp(map,RECORDMAGIC,8)==0) && (memcmp(stored,header,4*sizeof(uint64_t))==0) &&
+                 ((size_t)st.st_size==sizeof(header)+8+stored[4]*sizeof(uint64_t)) )
+            {
+                rx->map = map;
+                rx->mapSize = st.st_size;
+                rx->offsets = stored + 5;
+                rx->recordNo = stored[4];
+                close (fd);
+                return;
+            }
+            munmap (map,st.st_size);
+        }
+        close (fd);
+    }   /* if ( (fd=open(indexFile,O_RDONLY))>=0 ) */
+
+    /* Missing or stale index: rebuild it */
+    buildRecordIndex (rx,ps);
+    header[4] = rx->recordNo;
+    snprintf (tmpIndexFile,sizeof(tmpIndexFile),"%s.tmp",indexFile);
+    if ( ((indexFd=fopen(tmpIndexFile,"w"))==NULL) ||
+         (fwrite(RECORDMAGIC,1,8,indexFd)!=8) ||
+         (fwrite(header,sizeof(uint64_t),5,indexFd)!=5) ||
+         (fwrite(rx->offsets,sizeof(uint64_t),rx->recordNo,indexFd)!=rx->recordNo) ||
+         (fclose(indexFd)!=0) || (rename(tmpIndexFile,indexFile)<0) )
+    {
+        printf ("Unable to write the record index file (%s)... Aborting\n\n",strerror(errno));
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Offset of the given record (0-based) in the input CSV file, or end if there is none   */
+/*****************************************************************************************/
+static inline size_t recordOffset (recordIndex *rx, size_t record, size_t end)
+{
+    if ( (record<rx->recordNo) && (rx->offsets[record]<end) )
+        return (rx->offsets[record]);
+    return (end);
+}
+
+
+/*****************************************************************************************/
+/* First record starting at or after the given offset of the input CSV file (recordNo  */
+/* if there is none)                                                                    */
+/*****************************************************************************************/
+static size_t findRecord (recordIndex *rx, size_t offset)
+{
+    /* Local Variables */
+    size_t  low = 0,
+            high = rx->recordNo,
+            mid;
+
+    while (low<high)
+    {
+        mid = low + (high-low)/2;
+        if (rx->offsets[mid]<offset)
+            low = mid+1;
+        else
+            high = mid;
+    }   /* while (low<high) */
+
+    return (low);
+}
+
+
+/*****************************************************************************************/
+/* Release the record index                                                              */
+/*****************************************************************************************/
+static void closeRecordIndex (recordIndex *rx)
+{
+    if (rx->map!=NULL)
+        munmap (rx->map,rx->mapSize);
+    else
+        free (rx->offsets);
+    memset (rx,0,sizeof(recordIndex));
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Parse the given record of the input CSV file (end is the size of the input)           */
+/*****************************************************************************************/
+static bool readRecord (csvParser *ps, recordIndex *rx, size_t record, size_t end)
+{
+    seekCsv (ps,rx->offsets[record],recordOffset(rx,record+1,end));
+    ps->skipHeader = false;
+    ps->skipFields = false;
+
+    return (readCsvRow(ps));
+}
+
+
+/*****************************************************************************************/
+/* Value of the given field (0-based) of the current row, empty if the row is shorter    */
+/*****************************************************************************************/
+static inline fieldView rowField (csvParser *ps, int field)
+{
+    /* Local Variables */
+    fieldView   value = {"",0};
+
+    if (field<ps->fieldNo)
+        value = ps->fields[field];
+
+    return (value);
+}
+
+
+/*****************************************************************************************/
+/* Build the hash index of the key column of all the rows (key->field, from record      */
+/* key->firstRecord on). Only the key column is split while the input is scanned        */
+/*****************************************************************************************/
+static void buildKeyIndex (keyIndex *key, csvParser *ps, recordIndex *rx, size_t end)
+{
+    /* Local Variables */
+    fieldView   value;
+    bool       *fieldWanted = ps->fieldWanted,
+               *wanted;
+    int         fieldLimit = ps->fieldLimit;
+    uint64_t   *last;
+    size_t      i, b, mask;
+
+    key->rowNo = rx->recordNo - key->firstRecord;
+    key->bucketNo = 2;
+    while (key->bucketNo<2*key->rowNo)
+        key->bucketNo *= 2;
+    if ( ((key->hashes=malloc((key->rowNo+1)*sizeof(uint64_t)))==NULL) ||
+         ((key->chain=calloc(key->rowNo+1,sizeof(uint64_t)))==NULL) ||
+         ((key->buckets=calloc(key->bucketNo,sizeof(uint64_t)))==NULL) ||
+         ((last=calloc(key->bucketNo,sizeof(uint64_t)))==NULL) ||
+         ((wanted=calloc(key->field+1,sizeof(bool)))==NULL) )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+
+    /* Rows with the same hash (i.e. the same key) are chained in input order, starting */
+    /* from their bucket (last[] is the tail of the chain of each bucket)                */
+    wanted[key->field] = true;
+    ps->fieldWanted = wanted;
+    ps->fieldLimit = key->field+1;
+    mask = key->bucketNo - 1;
+    for (i=0; i<key->rowNo; i++)
+    {
+        if (readRecord(ps,rx,key->firstRecord+i,end))
+            value = rowField (ps,key->field);
+        else
+        {
+            value.ptr = "";
+            value.len = 0;
+        }
+        key->hashes[i] = hashBytes (14695981039346656037ULL,value.ptr,value.len);
+        for (b=key->hashes[i]&mask; (key->buckets[b]!=0) && (key->hashes[key->buckets[b]-1]!=key->hashes[i]); b=(b+1)&mask)
+            ;
+        if (key->buckets[b]==0)
+            key->buckets[b] = i+1;
+        else
+            key->chain[last[b]-1] = i+1;
+        last[b] = i+1;
+    }   /* for (i=0; i<key->rowNo; i++) */
+    ps->fieldWanted = fieldWanted;
+    ps->fieldLimit = fieldLimit;
+    free (wanted);
+    free (last);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Open the hash index of the given key column (0-based) of the rows, starting from the  */
+/* given record. If a record index file is given (option --record-index), the key index */
+/* is kept next to it (<index_file>.key<column>): it is mapped as it is if it matches    */
+/* the input and the record index, otherwise it is rebuilt and written to a temporary    */
+/* file, renamed when complete. Without a record index file it is built in memory        */
+/*****************************************************************************************/
+static void openKeyIndex (keyIndex *key, csvParser *ps, recordIndex *rx, size_t end, int field, size_t firstRecord, char *recordIndexFile, char *inputCsvFile)
+{
+    /* Local Variables */
+    FILE       *indexFd;
+    char        indexFile[MAXFILENAMELEN+32],
+                tmpIndexFile[MAXFILENAMELEN+36];
+    uint64_t    header[8],
+               *stored;
+    struct stat st;
+    void       *map;
+    int         fd;
+
+    key->field = field;
+    key->firstRecord = firstRecord;
+    key->map = NULL;
+    if ( (recordIndexFile[0]=='\0') || !inputSignature(header,ps,inputCsvFile) )
+    {
+        buildKeyIndex (key,ps,rx,end);
+        return;
+    }
+
+    /* Header: signature of the input, key column, first record, number of rows and of  */
+    /* buckets, followed by the hash and the next row of each row and by the buckets     */
+    header[4] = field;
+    header[5] = firstRecord;
+    header[6] = rx->recordNo - firstRecord;
+    snprintf (indexFile,sizeof(indexFile),"%s.key%d",recordIndexFile,field+1);
+    if ( (fd=open(indexFile,O_RDONLY))>=0 )
+    {
+        if ( (fstat(fd,&st)==0) && ((size_t)st.st_size>=sizeof(header)+8) &&
+             ((map=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0))!=MAP_FAILED) )
+        {
+            stored = (uint64_t *)((char *)map+8);
+            if ( (memcmp(map,KEYMAGIC,8)==0) && (memcmp(stored,header,7*sizeof(uint64_t))==0) &&
+                 (stored[7]>0) && ((stored[7]&(stored[7]-1))==0) &&
+                 ((size_t)st.st_size==sizeof(header)+8+(2*stored[6]+stored[7])*sizeof(uint64_t)) )
+            {
+                key->map = map;
+                key->mapSize = st.st_size;
+                key->rowNo = stored[6];
+                key->bucketNo = stored[7];
+                key->hashes = stored + 8;
+                key->chain = key->hashes + key->rowNo;
+                key->buckets = key->chain + key->rowNo;
+                close (fd);
+                return;
+            }
+            munmap (map,st.st_size);
+        }
+        close (fd);
+    }   /* if ( (fd=open(indexFile,O_RDONLY))>=0 ) */
+
+    /* Missing or stale index: rebuild it */
+    buildKeyIndex (key,ps,rx,end);
+    header[7] = key->bucketNo;
+    snprintf (tmpIndexFile,sizeof(tmpIndexFile),"%s.tmp",indexFile);
+    if ( ((indexFd=fopen(tmpIndexFile,"w"))==NULL) ||
+         (fwrite(KEYMAGIC,1,8,indexFd)!=8) ||
+         (fwrite(header,sizeof(uint64_t),8,indexFd)!=8) ||
+         (fwrite(key->hashes,sizeof(uint64_t),key->rowNo,indexFd)!=key->rowNo) ||
+         (fwrite(key->chain,sizeof(uint64_t),key->rowNo,indexFd)!=key->rowNo) ||
+         (fwrite(key->buckets,sizeof(uint64_t),key->bucketNo,indexFd)!=key->bucketNo) ||
+         (fclose(indexFd)!=0) || (rename(tmpIndexFile,indexFile)<0) )
+    {
+        printf ("Unable to write the key index file (%s)... Aborting\n\n",strerror(errno));
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* First row (row+1) whose key has the same hash as the given one, 0 if there is none    */
+/*****************************************************************************************/
+static size_t firstKeyRow (keyIndex *key, char *value, size_t len)
+{
+    /* Local Variables */
+    uint64_t    hash = hashBytes (14695981039346656037ULL,value,len);
+    size_t      mask = key->bucketNo - 1,
+                b;
+
+    for (b=hash&mask; (key->buckets[b]!=0) && (key->hashes[key->buckets[b]-1]!=hash); b=(b+1)&mask)
+        ;
+
+    return (key->buckets[b]);
+}
+
+
+/*****************************************************************************************/
+/* Parse the next row whose key column is equal to the given value, going on along the   */
+/* chain of the rows with the same hash from *cursor (set by firstKeyRow() for the first */
+/* row, and updated for the next one). Rows are found in input order, and their number  */
+/* (0-based) is stored in *row if it is not NULL; it returns false after the last one   */
+/*****************************************************************************************/
+static bool nextKeyRecord (keyIndex *key, csvParser *ps, recordIndex *rx, size_t end, char *value, size_t len, size_t *cursor, size_t *row)
+{
+    /* Local Variables */
+    fieldView   candidate;
+    size_t      i;
+
+    while (*cursor!=0)
+    {
+        i = *cursor - 1;
+        *cursor = key->chain[i];
+        if (!readRecord(ps,rx,key->firstRecord+i,end))
+            continue;
+        candidate = rowField (ps,key->field);
+        if ( (candidate.len==len) && (memcmp(candidate.ptr,value,len)==0) )
+        {
+            if (row!=NULL)
+                *row = i;
+            return (true);
+        }
+    }   /* while (*cursor!=0) */
+
+    return (false);
+}
+
+
+/*****************************************************************************************/
+/* Release the hash index of a key column                                                */
+/*****************************************************************************************/
+static void closeKeyIndex (keyIndex *key)
+{
+    if (key->map!=NULL)
+        munmap (key->map,key->mapSize);
+    else
+    {
+        free (key->hashes);
+        free (key->chain);
+        free (key->buckets);
+    }
+    key->map = NULL;
+    key->hashes = NULL;
+    key->chain = NULL;
+    key->buckets = NULL;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Add the statistics collected by a worker thread to the global ones                    */
+/*****************************************************************************************/
+static void mergeStats (runStats *total, runStats *stats)
+{
+    total->readNs += stats->readNs;
+    total->removeNs += stats->removeNs;
+    total->scanNs += stats->scanNs;
+    total->renderNs += stats->renderNs;
+    total->writeNs += stats->writeNs;
+    total->rows += stats->rows;
+    total->reusedRows += stats->reusedRows;
+    total->filteredRows += stats->filteredRows;
+    total->missingKeys += stats->missingKeys;
+    total->commentLines += stats->commentLines;
+    total->emptyLines += stats->emptyLines;
+    total->multiLineRows += stats->multiLineRows;
+    total->chapters += stats->chapters;
+    total->outputFiles += stats->outputFiles;
+    total->reopenedFiles += stats->reopenedFiles;
+    total->bytesIn += stats->bytesIn;
+    total->bytesOut += stats->bytesOut;
+    if (stats->longestLine>total->longestLine)
+        total->longestLine = stats->longestLine;
+    if (stats->longestField>total->longestField)
+        total->longestField = stats->longestField;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Print the statistics collected during the run to the standard error (option --stats), */
+/* either in human readable form or as a single JSON object. With several threads, the   */
+/* time of each stage is the sum over all threads (so it can exceed the elapsed time)    */
+/*****************************************************************************************/
+static void printStats (runStats *stats, int statsFormat, uint64_t elapsedNs, int threadNo)
+{
+    if (statsFormat==STATSJSON)
+    {
+        fprintf (stderr,"{\"elapsed_s\":%.6f,\"threads\":%d,",elapsedNs/1e9,threadNo);
+        fprintf (stderr,"\"read_s\":%.6f,\"remove_double_s\":%.6f,\"scan_s\":%.6f,\"render_s\":%.6f,\"write_s\":%.6f,",
+                 stats->readNs/1e9,stats->removeNs/1e9,stats->scanNs/1e9,stats->renderNs/1e9,stats->writeNs/1e9);
+        fprintf (stderr,"\"rows\":%llu,\"reused_rows\":%llu,\"filtered_rows\":%llu,\"keys_not_found\":%llu,\"comment_lines\":%llu,\"empty_lines\":%llu,\"multiline_rows\":%llu,\"chapters\":%llu,\"output_files\":%llu,\"reopened_files\":%llu,",
+                 (unsigned long long)stats->rows,(unsigned long long)stats->reusedRows,(unsigned long long)stats->filteredRows,(unsigned long long)stats->missingKeys,(unsigned long long)stats->commentLines,(unsigned long long)stats->emptyLines,
+                 (unsigned long long)stats->multiLineRows,(unsigned long long)stats->chapters,(unsigned long long)stats->outputFiles,(unsigned long long)stats->reopenedFiles);
+        fprintf (stderr,"\"bytes_in\":%llu,\"bytes_out\":%llu,\"longest_line\":%zu,\"longest_field\":%zu}\n",
+                 (unsigned long long)stats->bytesIn,(unsigned long long)stats->bytesOut,stats->longestLine,stats->longestField);
+        return;
+    }   /* if (statsFormat==STATSJSON) */
+
+    fprintf (stderr,"csv2mdText statistics (%d thread%s):\n",threadNo,(threadNo>1)?"s, stage times summed over threads":"");
+    fprintf (stderr,"    elapsed time               %12.6f s\n",elapsedNs/1e9);
+    fprintf (stderr,"    reading input lines        %12.6f s\n",stats->readNs/1e9);
+    fprintf (stderr,"    removing double quotes     %12.6f s\n",stats->removeNs/1e9);
+    fprintf (stderr,"    splitting fields           %12.6f s\n",stats->scanNs/1e9);
+    fprintf (stderr,"    rendering templates        %12.6f s\n",stats->renderNs/1e9);
+    fprintf (stderr,"    writing output             %12.6f s\n",stats->writeNs/1e9);
+    fprintf (stderr,"    rows emitted               %12llu\n",(unsigned long long)stats->rows);
+    fprintf (stderr,"    rows reused (incremental)  %12llu\n",(unsigned long long)stats->reusedRows);
+    fprintf (stderr,"    rows filtered out          %12llu\n",(unsigned long long)stats->filteredRows);
+    fprintf (stderr,"    keys not found             %12llu\n",(unsigned long long)stats->missingKeys);
+    fprintf (stderr,"    comment lines skipped      %12llu\n",(unsigned long long)stats->commentLines);
+    fprintf (stderr,"    empty lines skipped        %12llu\n",(unsigned long long)stats->emptyLines);
+    fprintf (stderr,"    multi line rows            %12llu\n",(unsigned long long)stats->multiLineRows);
+    fprintf (stderr,"    chapters emitted           %12llu\n",(unsigned long long)stats->chapters);
+    fprintf (stderr,"    output files               %12llu\n",(unsigned long long)stats->outputFiles);
+    fprintf (stderr,"    output files reopened      %12llu\n",(unsigned long long)stats->reopenedFiles);
+    fprintf (stderr,"    bytes in                   %12llu\n",(unsigned long long)stats->bytesIn);
+    fprintf (stderr,"    bytes out                  %12llu\n",(unsigned long long)stats->bytesOut);
+    fprintf (stderr,"    longest line               %12zu\n",stats->longestLine);
+    fprintf (stderr,"    longest field              %12zu\n",stats->longestField);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Worker thread: it takes chunks of rows posted by the main thread and renders them    */
+/* into the in-memory output buffer of the job. Each worker has its own parser and its  */
+/* own copy of the renderer, so that the only shared data are the input file and the    */
+/* compiled templates (read only). Until a chapter level is found in the chunk, only    */
+/* the main thread knows whether its field changed: its heading (and the headings of    */
+/* the levels nested into it) is rendered anyway and recorded in the job, so that the   */
+/* main thread can drop it if the chapter is the same as at the end of the previous     */
+/* chunk                                                                                */
+/*****************************************************************************************/
+static void *renderWorker (void *arg)
+{
+    /* Local Variables */
+    renderPool *pool = arg;
+    renderJob  *job;
+    csvParser   ps = {0};
+    mdRenderer  rd;
+    fieldView   chapter,
+               *field;
+    runStats    stats = {0};
+    chapterHeading *heading;
+    int         level,
+                chapterFieldNo;
+    bool        deferred,
+                decided;
+
+    ps.in = pool->ps->in;
+    ps.separator = pool->ps->separator;
+    ps.multiLine = pool->ps->multiLine;
+    ps.comment = pool->ps->comment;
+    ps.rfc4180 = pool->ps->rfc4180;
+    ps.fieldWanted = pool->ps->fieldWanted;
+    ps.fieldLimit = pool->ps->fieldLimit;
+    ps.predicates = pool->ps->predicates;
+    ps.predicateNo = pool->ps->predicateNo;
+    ps.firstPredicate = pool->ps->firstPredicate;
+    initScanner (&ps,pool->scanner);
+    rd = *pool->rd;
+    memset (rd.lastChapter,0,sizeof(rd.lastChapter));
+    ps.stats = (pool->stats!=NULL) ? &stats : NULL;
+    rd.stats = ps.stats;
+
+    for (;;)
+    {
+        pthread_mutex_lock (&pool->lock);
+        while ( (pool->taken==pool->posted) && !pool->finished )
+            pthread_cond_wait (&pool->jobPosted,&pool->lock);
+        if (pool->taken==pool->posted)
+        {
+            pthread_mutex_unlock (&pool->lock);
+            break;
+        }
+        job = &pool->jobs[pool->taken%pool->jobNo];
+        pool->taken += 1;
+        pthread_mutex_unlock (&pool->lock);
+
+        seekCsv (&ps,job->start,job->end);
+        ps.skipHeader = job->skipHeader;
+        job->out.len = 0;
+        job->headingNo = 0;
+        memset (job->chapterSeen,0,sizeof(job->chapterSeen));
+        while ( readCsvRow(&ps) )
+        {
+            /* Look for the outermost level of the row not yet found in the chunk, unless */
+            /* an enclosing level (already found) changed, which decides for all of them: */
+            /* in that case the headings are left to renderCsvRow()                       */
+            deferred = false;
+            decided = false;
+            for (level=0; level<rd.levelNo; level++)
+            {
+                chapterFieldNo = rd.chapterFieldNo[level];
+                if ( (chapterFieldNo<1) || (chapterFieldNo>ps.fieldNo) )
+                    continue;
+                field = &ps.fields[chapterFieldNo-1];
+                if ( decided || (!deferred && job->chapterSeen[level]) )
+                {
+                    if ( !decided && !sameKeyString(&rd.lastChapter[level],field) )
+                        decided = true;
+                    job->chapterSeen[level] = true;
+                    continue;
+                }
+                heading = &job->headings[job->headingNo++];
+                heading->level = level;
+                heading->rowStart = !deferred;
+                if (!job->chapterSeen[level])
+                    heading->same = HEADINGUNKNOWN;
+                else
+                    heading->same = sameKeyString(&rd.lastChapter[level],field) ? HEADINGSAME : HEADINGCHANGED;
+                saveKeyString (&heading->key,field);
+                heading->start = job->out.len;
+                appendCsvRow2Output (&job->out,&rd.chapterTemplate[level],rd.placeHolder,ps.fieldNo,ps.fields);
+                heading->end = job->out.len;
+                saveKeyString (&rd.lastChapter[level],field);
+                job->chapterSeen[level] = true;
+                deferred = true;
+                if (rd.stats)
+                    rd.stats->chapters += 1;
+            }   /* for (level=0; level<rd.levelNo; level++) */
+            renderCsvRow (&rd,&job->out,ps.fieldNo,ps.fields);
+        }   /* while ( readCsvRow(&ps) ) */
+        for (level=0; level<rd.levelNo; level++)
+        {
+            if (job->chapterSeen[level])
+            {
+                chapter.ptr = rd.lastChapter[level].ptr;
+                chapter.len = rd.lastChapter[level].len;
+                saveKeyString (&job->lastChapter[level],&chapter);
+            }
+        }   /* for (level=0; level<rd.levelNo; level++) */
+
+        pthread_mutex_lock (&pool->lock);
+        job->state = JOBDONE;
+        pthread_cond_broadcast (&pool->jobDone);
+        pthread_mutex_unlock (&pool->lock);
+    }   /* for (;;) */
+
+    if (pool->stats)
+    {
+        pthread_mutex_lock (&pool->lock);
+        mergeStats (pool->stats,&stats);
+        pthread_mutex_unlock (&pool->lock);
+    }
+    freeCsvParser (&ps);
+    for (level=0; level<rd.levelNo; level++)
+        free (rd.lastChapter[level].ptr);
+
+    return (NULL);
+}
+
+
+/*****************************************************************************************/
+/* Render the whole input CSV file with threadNo worker threads (option -j). The main   */
+/* thread splits the input into chunks of whole rows (fields are not extracted, so this */
+/* is much faster than the actual parsing), posts them to the workers and writes the    */
+/* rendered chunks to the output file in the original order. The chapter headings that */
+/* the workers could not decide on are written only if they differ from the chapters   */
+/* at the end of the previous chunk, so that the output is identical to the one         */
+/* produced by a single thread. With a record index (option --record-index) the chunks */
+/* are cut at the record offsets, without reading the input at all                      */
+/*****************************************************************************************/
+static void renderParallel (csvParser *ps, mdRenderer *rd, outputBuffer *outputMd, int threadNo, int scanner, recordIndex *rx)
+{
+    /* Local Variables */
+    renderPool  pool;
+    renderJob  *job;
+    pthread_t   threads[MAXTHREADS];
+    chapterHeading *heading;
+    fieldView   chapter;
+    size_t      pos;
+    long        written = 0,
+                droppedChapters = 0;
+    int         i, j;
+    bool        changed = false,
+                same;
+
+    pthread_mutex_init (&pool.lock,NULL);
+    pthread_cond_init (&pool.jobPosted,NULL);
+    pthread_cond_init (&pool.jobDone,NULL);
+    pool.jobNo = 2*threadNo;
+    pool.posted = 0;
+    pool.taken = 0;
+    pool.finished = false;
+    pool.ps = ps;
+    pool.rd = rd;
+    pool.scanner = scanner;
+    pool.stats = ps->stats;
+    ps->stats = NULL;           /* Rows are counted by the workers, not while splitting */
+    if ( (pool.jobs=calloc(pool.jobNo,sizeof(renderJob)))==NULL )
+    {
+        printf ("Memory allocation failure... Aborting\n\n");
+        exit (-1);
+    }
+    for (i=0; i<pool.jobNo; i++)
+        openMemoryOutput (&pool.jobs[i].out,CHUNKSIZE);
+    for (i=0; i<threadNo; i++)
+    {
+        if (pthread_create(&threads[i],NULL,renderWorker,&pool)!=0)
+        {
+            printf ("Unable to create worker threads... Aborting\n\n");
+            exit (-1);
+        }
+    }   /* for (i=0; i<threadNo; i++) */
+
+    ps->skipFields = true;
+    for (;;)
+    {
+        /* Split the input into chunks, as long as there are free jobs */
+        while ( (ps->in.pos<ps->in.size) && (pool.posted-written<pool.jobNo) )
+        {
+            job = &pool.jobs[pool.posted%pool.jobNo];
+            job->start = ps->in.pos;
+            job->skipHeader = ps->skipHeader;
+            if (rx!=NULL)
+            {
+                ps->in.pos = recordOffset (rx,findRecord(rx,job->start+CHUNKSIZE),ps->in.size);
+                if ( (rx->recordNo>0) && (ps->in.pos>rx->offsets[0]) )
+                    ps->skipHeader = false;
+            }
+            else
+            {
+                while ( (ps->in.pos-job->start<CHUNKSIZE) && readCsvRow(ps) )
+                    ;
+            }
+            job->end = ps->in.pos;
+
+            pthread_mutex_lock (&pool.lock);
+            job->state = JOBPENDING;
+            pool.posted += 1;
+            pthread_cond_signal (&pool.jobPosted);
+            pthread_mutex_unlock (&pool.lock);
+        }   /* while ( (ps->in.pos<ps->in.size) && (pool.posted-written<pool.jobNo) ) */
+        if (written==pool.posted)
+            break;
+
+        /* Wait for the oldest chunk and write it to the output file */
+        job = &pool.jobs[written%pool.jobNo];
+        pthread_mutex_lock (&pool.lock);
+        while (job->state!=JOBDONE)
+            pthread_cond_wait (&pool.jobDone,&pool.lock);
+        pthread_mutex_unlock (&pool.lock);
+
+        pos = 0;
+        for (i=0; i<job->headingNo; i++)
+        {
+            heading = &job->headings[i];
+            if (heading->rowStart)
+                changed = false;
+            chapter.ptr = heading->key.ptr;
+            chapter.len = heading->key.len;
+            if (heading->same==HEADINGUNKNOWN)
+                same = sameKeyString (&rd->lastChapter[heading->level],&chapter);
+            else
+                same = (heading->same==HEADINGSAME);
+            outputWrite (outputMd,job->out.buffer+pos,heading->start-pos);
+            if ( changed || !same )
+            {
+                outputWrite (outputMd,job->out.buffer+heading->start,heading->end-heading->start);
+                changed = true;
+            }
+            else
+                droppedChapters += 1;
+            pos = heading->end;
+        }   /* for (i=0; i<job->headingNo; i++) */
+        outputWrite (outputMd,job->out.buffer+pos,job->out.len-pos);
+        for (i=0; i<rd->levelNo; i++)
+        {
+            if (job->chapterSeen[i])
+            {
+                chapter.ptr = job->lastChapter[i].ptr;
+                chapter.len = job->lastChapter[i].len;
+                saveKeyString (&rd->lastChapter[i],&chapter);
+            }
+        }   /* for (i=0; i<rd->levelNo; i++) */
+        job->state = JOBFREE;
+        written += 1;
+    }   /* for (;;) */
+
+    pthread_mutex_lock (&pool.lock);
+    pool.finished = true;
+    pthread_cond_broadcast (&pool.jobPosted);
+    pthread_mutex_unlock (&pool.lock);
+    for (i=0; i<threadNo; i++)
+        pthread_join (threads[i],NULL);
+    ps->stats = pool.stats;
+    if (ps->stats)
+        ps->stats->chapters -= droppedChapters;
+
+    for (i=0; i<pool.jobNo; i++)
+    {
+        free (pool.jobs[i].out.buffer);
+        for (j=0; j<MAXHEADINGS; j++)
+            free (pool.jobs[i].headings[j].key.ptr);
+        for (j=0; j<MAXLEVELS; j++)
+            free (pool.jobs[i].lastChapter[j].ptr);
+    }   /* for (i=0; i<pool.jobNo; i++) */
+    free (pool.jobs);
+    pthread_mutex_destroy (&pool.lock);
+    pthread_cond_destroy (&pool.jobPosted);
+    pthread_cond_destroy (&pool.jobDone);
+
+    return;
 }
 
 
 /***************************************************************************/
 /* This is a function written for debug purposes and reused with -d option */
 /***************************************************************************/
-static void currentRowPrintFields (int fieldNo, fieldString fields[])
+static void currentRowPrintFields (int fieldNo, fieldView fields[])
+{
+    int i;
+
+    for (i=0; i<fieldNo; i++)
+        printf ("Field %d:\t%.*s\n", i+1, (int)fields[i].len, fields[i].ptr);
+    printf ("\n");
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Set the default options (i.e. those used when an option is not given)                 */
+/*****************************************************************************************/
+static void initOptions (runOptions *opt)
+{
+    memset (opt,0,sizeof(runOptions));
+    opt->altSyntax = UNDEFINED;
+    opt->outBufSize = DEFOUTBUFSIZE;
+    opt->groupMemory = DEFGROUPMEM;
+    opt->syncPolicy = SYNCNONE;
+    opt->scanner = SCANAUTO;
+    opt->threadNo = DEFTHREADS;
+    opt->statsFormat = STATSNONE;
+    opt->groupOrder = GROUPNONE;
+    opt->maxOpen = DEFMAXOPEN;
+    opt->compress = CODECAUTO;
+    opt->asyncIo = ASYNCAUTO;
+    opt->keyOrder = KEYORDERKEYS;
+    opt->sampleStep = 1;
+    opt->skipHeader = DEFHEADER;
+    opt->appendMode = DEFAPPEND;
+    opt->rfc4180 = false;
+    opt->separator = DEFSEPARATOR;
+    opt->comment = DEFCOMMENT;
+    opt->placeHolder = DEFPLACEHLDR;
+    opt->multiLine = DEFMULTILINE;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Store the file name given to an option (e.g. -i) into one of the options, aborting if */
+/* it is longer than MAXFILENAMELEN (the options of a job may come from a manifest file) */
+/*****************************************************************************************/
+static void copyFileName (char *dest, char *option, char *fileName)
+{
+    if (strlen(fileName)>MAXFILENAMELEN)
+    {
+        printf ("File name too long (... %s <file>, at most %d characters)... Aborting\n\n",option,MAXFILENAMELEN);
+        exit (-1);
+    }
+    strcpy (dest,fileName);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Parse the command line options (or those of a job in the manifest, option -b) on top  */
+/* of the ones already stored in opt                                                     */
+/*****************************************************************************************/
+static void parseOptions (int argc, char *argv[], runOptions *opt)
+{
+    /* Local Variables */
+    char   *p;
+    int     i;
+
+    for (i=1;i<argc;i++)
+    {
+        if (argv[i][0]!='-')
+        {
+            printUsage();
+            exit (-1);
+        }   /* if (argv[i][0]!='-') */
+        switch (argv[i][1])
+        {
+            case 'd':
+            {
+                i +=1;
+                if ( (opt->altSyntax==STANDARD) || (i>=argc) )
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax = DECODEHDR;
+                opt->skipHeader = false;     /* reset in any case skipHeader flag */
+                copyFileName (opt->inputCsvFile,"-d",argv[i]);
+                break;
+            }   /* case 'd': */
+            case 'i':
+            {
+                i +=1;
+                if ( (opt->altSyntax==DECODEHDR) || (i>=argc) )
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax=STANDARD;
+                copyFileName (opt->inputCsvFile,"-i",argv[i]);
+                break;
+            }   /* case 'i': */
+            case 'o':
+            {
+                i +=1;
+                if ( (opt->altSyntax==DECODEHDR) || (i>=argc) )
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax=STANDARD;
+                copyFileName (opt->outputMdFile,"-o",argv[i]);
+                break;
+            }   /* case 'o': */
+            case 't':
+            {
+                i +=1;
+                if ( (opt->altSyntax==DECODEHDR) || (i>=argc) )
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax=STANDARD;
+                copyFileName (opt->inputMdTemplate,"-t",argv[i]);
+                break;
+            }   /* case 't': */
+            case 'n':
+            {
+                if (opt->altSyntax==DECODEHDR)
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax=STANDARD;
+                opt->skipHeader = false;
+                break;
+            }   /* case 'n': */
+            case 'a':
+            {
+                if (opt->altSyntax==DECODEHDR)
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax=STANDARD;
+                opt->appendMode = true;
+                break;
+            }   /* case 'a': */
+            case 's':
+            {
+                i +=1;
+                if ( (opt->altSyntax==DECODEHDR) || (i>=argc) )
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax=STANDARD;
+                opt->separator = argv[i][0];
+                break;
+            }   /* case 's': */
+            case 'p':
+            {
+                i +=1;
+                if ( (opt->altSyntax==DECODEHDR) || (i>=argc) )
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax=STANDARD;
+                opt->placeHolder = argv[i][0];
+                break;
+            }   /* case 'p': */
+            case 'r':
+            {
+                i +=1;
+                if ( (opt->altSyntax==DECODEHDR) || (i>=argc) )
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax=STANDARD;
+                opt->comment = argv[i][0];
+                break;
+            }   /* case 'r': */
+            case 'c':
+            {
+                i +=1;
+                if ( (opt->altSyntax==DECODEHDR) || (i>=argc) )
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax=STANDARD;
+                if (opt->levelNo>=MAXLEVELS)
+                {
+                    printf ("Too many chapter markdown templates (... -c <chapter_md_template>, at most %d)... Aborting\n\n",MAXLEVELS);
+                    exit (-1);
+                }
+                copyFileName (opt->inputMdChapterTemplate[opt->levelNo],"-c",argv[i]);
+                opt->levelNo += 1;
+                break;
+            }   /* case 'c': */
+            case 'b':
+            {
+                i +=1;
+                if ( (opt->altSyntax==DECODEHDR) || (i>=argc) )
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                copyFileName (opt->manifestFile,"-b",argv[i]);
+                break;
+            }   /* case 'b': */
+            case 'j':
+            {
+                i +=1;
+                if ( (opt->altSyntax==DECODEHDR) || (i>=argc) )
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                opt->altSyntax=STANDARD;
+                opt->threadNo = atoi(argv[i]);
+                if ( (opt->threadNo<1) || (opt->threadNo>MAXTHREADS) )
+                {
+                    printf ("Invalid number of threads (... -j <threads>, 1 to %d)... Aborting\n\n",MAXTHREADS);
+                    exit (-1);
+                }
+                break;
+            }   /* case 'j': */
+            case '-':
+            {   /* Long options (--skip, --record-index and --rfc4180 are accepted with -d as well) */
+                if (strcmp(argv[i],"--rfc4180")==0)
+                {   /* The only long option without argument */
+                    opt->rfc4180 = true;
+                    break;
+                }
+                i +=1;
+                if (i>=argc)
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                if ( (strcmp(argv[i-1],"--skip")!=0) && (strcmp(argv[i-1],"--record-index")!=0) )
+                {
+                    if (opt->altSyntax==DECODEHDR)
+                    {
+                        printUsage();
+                        exit (-1);
+                    }
+                    opt->altSyntax=STANDARD;
+                }
+                if (strcmp(argv[i-1],"--buffer-size")==0)
+                {
+                    if ( !parseSize(argv[i],&opt->outBufSize) || (opt->outBufSize==0) )
+                    {
+                        printf ("Invalid output buffer size (... --buffer-size <bytes>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--sync")==0)
+                {
+                    if (strcmp(argv[i],"none")==0)
+                        opt->syncPolicy = SYNCNONE;
+                    else if (strcmp(argv[i],"data")==0)
+                        opt->syncPolicy = SYNCDATA;
+                    else if (strcmp(argv[i],"direct")==0)
+                        opt->syncPolicy = SYNCDIRECT;
+                    else
+                    {
+                        printf ("Invalid sync policy (... --sync <none|data|direct>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--scanner")==0)
+                {
+                    if (strcmp(argv[i],"auto")==0)
+                        opt->scanner = SCANAUTO;
+                    else if (strcmp(argv[i],"scalar")==0)
+                        opt->scanner = SCANSCALAR;
+                    else if (strcmp(argv[i],"sse2")==0)
+                        opt->scanner = SCANSSE2;
+                    else if (strcmp(argv[i],"avx2")==0)
+                        opt->scanner = SCANAVX2;
+                    else
+                    {
+                        printf ("Invalid scanner (... --scanner <auto|scalar|sse2|avx2>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--stats")==0)
+                {
+                    if (strcmp(argv[i],"text")==0)
+                        opt->statsFormat = STATSTEXT;
+                    else if (strcmp(argv[i],"json")==0)
+                        opt->statsFormat = STATSJSON;
+                    else
+                    {
+                        printf ("Invalid statistics format (... --stats <text|json>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--group")==0)
+                {
+                    if (strcmp(argv[i],"first")==0)
+                        opt->groupOrder = GROUPFIRST;
+                    else if (strcmp(argv[i],"sorted")==0)
+                        opt->groupOrder = GROUPSORTED;
+                    else
+                    {
+                        printf ("Invalid chapter grouping (... --group <first|sorted>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--group-memory")==0)
+                {
+                    if ( !parseSize(argv[i],&opt->groupMemory) || (opt->groupMemory==0) )
+                    {
+                        printf ("Invalid memory budget for chapter grouping (... --group-memory <bytes>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--incremental")==0)
+                    copyFileName (opt->indexFile,argv[i-1],argv[i]);
+                else if (strcmp(argv[i-1],"--compress")==0)
+                {
+                    if (strcmp(argv[i],"auto")==0)
+                        opt->compress = CODECAUTO;
+                    else if (strcmp(argv[i],"none")==0)
+                        opt->compress = CODECNONE;
+                    else if (strcmp(argv[i],"gzip")==0)
+                        opt->compress = CODECGZIP;
+                    else if (strcmp(argv[i],"zstd")==0)
+                        opt->compress = CODECZSTD;
+                    else
+                    {
+                        printf ("Invalid compression (... --compress <auto|none|gzip|zstd>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--async-io")==0)
+                {
+                    if (strcmp(argv[i],"auto")==0)
+                        opt->asyncIo = ASYNCAUTO;
+                    else if (strcmp(argv[i],"uring")==0)
+                        opt->asyncIo = ASYNCURING;
+                    else if (strcmp(argv[i],"thread")==0)
+                        opt->asyncIo = ASYNCTHREAD;
+                    else if (strcmp(argv[i],"none")==0)
+                        opt->asyncIo = ASYNCNONE;
+                    else
+                    {
+                        printf ("Invalid asynchronous I/O (... --async-io <auto|uring|thread|none>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--max-open")==0)
+                {
+                    opt->maxOpen = atoi(argv[i]);
+                    if (opt->maxOpen<1)
+                    {
+                        printf ("Invalid number of open output files (... --max-open <files>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--record-index")==0)
+                    copyFileName (opt->recordIndexFile,argv[i-1],argv[i]);
+                else if (strcmp(argv[i-1],"--serve")==0)
+                    copyFileName (opt->serveSocket,argv[i-1],argv[i]);
+                else if (strcmp(argv[i-1],"--keys")==0)
+                    copyFileName (opt->keysFile,argv[i-1],argv[i]);
+                else if (strcmp(argv[i-1],"--key-column")==0)
+                {
+                    if ( ((p=parseCount(argv[i],&opt->keyColumn))==NULL) || (*p!='\0') || (opt->keyColumn==0) || (opt->keyColumn>INT_MAX) )
+                    {
+                        printf ("Invalid key column (... --key-column <column>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--key-order")==0)
+                {
+                    if (strcmp(argv[i],"keys")==0)
+                        opt->keyOrder = KEYORDERKEYS;
+                    else if (strcmp(argv[i],"input")==0)
+                        opt->keyOrder = KEYORDERINPUT;
+                    else
+                    {
+                        printf ("Invalid key order (... --key-order <keys|input>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--skip")==0)
+                {
+                    if ( ((p=parseCount(argv[i],&opt->skipRows))==NULL) || (*p!='\0') )
+                    {
+                        printf ("Invalid number of rows (... --skip <rows>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--head")==0)
+                {
+                    if ( ((p=parseCount(argv[i],&opt->headRows))==NULL) || (*p!='\0') || (opt->headRows==0) )
+                    {
+                        printf ("Invalid number of rows (... --head <rows>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--rows")==0)
+                {
+                    opt->lastRow = 0;
+                    if ( ((p=parseCount(argv[i],&opt->skipRows))==NULL) || (*p!='-') || (opt->skipRows==0) ||
+                         ((p[1]!='\0') && (((p=parseCount(p+1,&opt->lastRow))==NULL) || (*p!='\0') || (opt->lastRow<opt->skipRows))) )
+                    {
+                        printf ("Invalid range of rows (... --rows <first>-[<last>])... Aborting\n\n");
+                        exit (-1);
+                    }
+                    opt->skipRows -= 1;
+                }
+                else if (strcmp(argv[i-1],"--sample")==0)
+                {
+                    p = argv[i];
+                    if (strncmp(p,"1/",2)==0)
+                        p += 2;
+                    if ( ((p=parseCount(p,&opt->sampleStep))==NULL) || (*p!='\0') || (opt->sampleStep==0) )
+                    {
+                        printf ("Invalid sampling rate (... --sample 1/<step>)... Aborting\n\n");
+                        exit (-1);
+                    }
+                }
+                else if (strcmp(argv[i-1],"--where")==0)
+                {
+                    if (opt->whereNo>=MAXPREDICATES)
+                    {
+                        printf ("Too many row filters (... --where <predicate>, at most %d)... Aborting\n\n",MAXPREDICATES);
+                        exit (-1);
+                    }
+                    if ( (opt->where[opt->whereNo]=strdup(argv[i]))==NULL )
+                    {
+                        printf ("Memory allocation failure... Aborting\n\n");
+                        exit (-1);
+                    }
+                    opt->whereNo += 1;
+                }
+                else
+                {
+                    printUsage();
+                    exit (-1);
+                }
+                break;
+            }   /* case '-': */
+            default:
+            {   /* Unexpected option */
+                printUsage();
+                exit(-1);
+            }   /* default */
+        }   /* switch (argv[i][1]) */
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Check that the options are consistent and that mandatory parameters have been given   */
+/*****************************************************************************************/
+static void checkOptions (runOptions *opt)
 {
-    int i;
+    if (opt->manifestFile[0]!='\0')
+    {   /* Batch mode: input, output and templates are given by the manifest */
+        if ( (opt->altSyntax==DECODEHDR) || (opt->inputCsvFile[0]!='\0') || (opt->outputMdFile[0]!='\0') || (opt->inputMdTemplate[0]!='\0') ||
+             (opt->serveSocket[0]!='\0') )
+        {
+            printUsage();
+            exit (-1);
+        }
+        return;
+    }   /* if (opt->manifestFile[0]!='\0') */
+
+    if (opt->inputCsvFile[0]=='\0')
+    {
+        if (opt->altSyntax==DECODEHDR)
+            printf ("Missing mandatory input csv file (... -d <csv_input_file>)... Aborting\n\n");
+        else
+            printf ("Missing mandatory input csv file (... -i <csv_input_file>)... Aborting\n\n");
+        exit (-1);
+    }
+    if (opt->serveSocket[0]!='\0')
+    {   /* Server mode: rows are requested by the clients, and sent back to them */
+        if ( (strcmp(opt->inputCsvFile,"-")==0) || (opt->outputMdFile[0]!='\0') || opt->appendMode ||
+             (opt->groupOrder!=GROUPNONE) || (opt->indexFile[0]!='\0') || (opt->whereNo>0) ||
+             (opt->skipRows>0) || (opt->lastRow>0) || (opt->headRows>0) || (opt->sampleStep>1) ||
+             (opt->keysFile[0]!='\0') || (opt->keyColumn>0) )
+        {
+            printf ("Server mode requires a regular input csv file, and it cannot be used with -o, -a, --group,\n");
+            printf ("--incremental, --where, --skip, --head, --rows, --sample or --keys (... --serve <socket_file>)... Aborting\n\n");
+            exit (-1);
+        }
+    }
+    else if ( (opt->altSyntax==STANDARD) && (opt->outputMdFile[0]=='\0') )
+    {
+        printf ("Missing mandatory output markdown file (... -o <md_output_file>)... Aborting\n\n");
+        exit (-1);
+    }
+    if ( (opt->altSyntax==STANDARD) && (opt->inputMdTemplate[0]=='\0') )
+    {
+        printf ("Missing mandatory markdown teplate (... -t <md_template>)... Aborting\n\n");
+        exit (-1);
+    }
+    if ( (opt->groupOrder!=GROUPNONE) && (opt->levelNo==0) )
+    {
+        printf ("Chapter grouping requires a chapter markdown template (... --group <first|sorted> -c <chapter_md_template>)... Aborting\n\n");
+        exit (-1);
+    }
+    if ( (opt->keysFile[0]!='\0')!=(opt->keyColumn>0) )
+    {
+        printf ("Options --keys and --key-column shall be given together (... --key-column <column> --keys <keys_file>)... Aborting\n\n");
+        exit (-1);
+    }
+    if ( (opt->keysFile[0]!='\0') &&
+         ((strcmp(opt->inputCsvFile,"-")==0) || (opt->groupOrder!=GROUPNONE) ||
+          (opt->indexFile[0]!='\0') || (opt->whereNo>0) || (opt->skipRows>0) || (opt->lastRow>0) || (opt->headRows>0) || (opt->sampleStep>1)) )
+    {
+        printf ("Key lookups require a regular input csv file, and they cannot be used with --group, --incremental,\n");
+        printf ("--where, --skip, --head, --rows or --sample (... --key-column <column> --keys <keys_file>)... Aborting\n\n");
+        exit (-1);
+    }
+    if ( (opt->altSyntax==STANDARD) && isPathPattern(opt->outputMdFile,opt->placeHolder) &&
+         ((opt->groupOrder!=GROUPNONE) || (opt->indexFile[0]!='\0') || (opt->keysFile[0]!='\0')) )
+    {
+        printf ("An output path pattern cannot be used with --group, --incremental or --keys (... -o <md_output_pattern>)... Aborting\n\n");
+        exit (-1);
+    }
+    if ( (opt->indexFile[0]!='\0') && (opt->appendMode || (opt->groupOrder!=GROUPNONE) || (strcmp(opt->outputMdFile,"-")==0) ||
+                                        (outputCodec(opt->compress,opt->outputMdFile)!=CODECNONE)) )
+    {
+        printf ("Incremental mode requires a regular uncompressed output file, and it cannot be used with -a or --group (... --incremental <index_file>)... Aborting\n\n");
+        exit (-1);
+    }
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Tell whether the given row (1-based, counting the rows that satisfy --where) has been */
+/* selected by options --skip, --rows and --sample                                       */
+/*****************************************************************************************/
+static inline bool rowSelected (runOptions *opt, size_t rowNo)
+{
+    return ( (rowNo>opt->skipRows) && ((rowNo-opt->skipRows-1)%opt->sampleStep==0) );
+}
+
+
+/*****************************************************************************************/
+/* Compare two row numbers (qsort() callback)                                            */
+/*****************************************************************************************/
+static int compareRows (const void *a, const void *b)
+{
+    /* Local Variables */
+    size_t  rowA = *(const size_t *)a,
+            rowB = *(const size_t *)b;
+
+    return ( (rowA>rowB) - (rowA<rowB) );
+}
+
+
+/*****************************************************************************************/
+/* Render the rows whose key column is equal to one of the keys listed in the keys file  */
+/* (options --key-column and --keys, one key per line), through the hash index of the   */
+/* key column: rows are rendered in the order of the keys (all the rows of a key, in    */
+/* input order) or in input order (option --key-order). The parser is left at the end  */
+/* of the input                                                                          */
+/*****************************************************************************************/
+static void renderKeyRows (csvParser *ps, recordIndex *rx, mdRenderer *rd, outputBuffer *outputMd, runOptions *opt)
+{
+    /* Local Variables */
+    FILE       *keysFd;
+    keyIndex    key;
+    char       *line = NULL;
+    size_t      lineCap = 0,
+                end = ps->in.size,
+               *rows = NULL,
+                rowNo = 0,
+                rowCap = 0,
+                cursor, row, len, i;
+    ssize_t     lineLen;
+    bool        found;
+
+    if (strcmp(opt->keysFile,"-")==0)
+        keysFd = stdin;
+    else if ( (keysFd=fopen(opt->keysFile,"r"))==NULL )
+    {
+        printf ("Unable to open the keys file... Aborting\n\n");
+        exit (-1);
+    }
+    openKeyIndex (&key,ps,rx,end,opt->keyColumn-1,(ps->skipHeader && (rx->recordNo>0))?1:0,opt->recordIndexFile,opt->inputCsvFile);
+
+    while ( (lineLen=getline(&line,&lineCap,keysFd))>=0 )
+    {
+        len = lineLen;
+        while ( (len>0) && ((line[len-1]=='\n') || (line[len-1]=='\r')) )
+            len--;
+        if (len==0)
+            continue;                           /* Empty line */
+        found = false;
+        cursor = firstKeyRow (&key,line,len);
+        while ( nextKeyRecord(&key,ps,rx,end,line,len,&cursor,&row) )
+        {
+            found = true;
+            if (opt->keyOrder==KEYORDERKEYS)
+            {
+                renderCsvRow (rd,outputMd,ps->fieldNo,ps->fields);
+                continue;
+            }
+            if (rowNo==rowCap)
+            {
+                rowCap = (rowCap==0) ? 1024 : 2*rowCap;
+                if ( (rows=realloc(rows,rowCap*sizeof(size_t)))==NULL )
+                {
+                    printf ("Memory allocation failure... Aborting\n\n");
+                    exit (-1);
+                }
+            }   /* if (rowNo==rowCap) */
+            rows[rowNo++] = row;
+        }   /* while ( nextKeyRecord(&key,ps,rx,end,line,len,&cursor,&row) ) */
+        if ( !found && (ps->stats) )
+            ps->stats->missingKeys += 1;
+    }   /* while ( (lineLen=getline(&line,&lineCap,keysFd))>=0 ) */
+
+    /* Input order: each row is rendered once, even if its key is listed more than once */
+    qsort (rows,rowNo,sizeof(size_t),compareRows);
+    for (i=0; i<rowNo; i++)
+    {
+        if ( ((i==0) || (rows[i]!=rows[i-1])) && readRecord(ps,rx,key.firstRecord+rows[i],end) )
+            renderCsvRow (rd,outputMd,ps->fieldNo,ps->fields);
+    }   /* for (i=0; i<rowNo; i++) */
+
+    seekCsv (ps,end,end);
+    free (rows);
+    free (line);
+    if (keysFd!=stdin)
+        fclose (keysFd);
+    closeKeyIndex (&key);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Resolve the column names used by the templates of a run (${name}, {{#if name}})       */
+/* against the header row of the input CSV file. The templates that use names get their */
+/* own copy of the segments, since compiled templates are shared by the jobs of a batch */
+/* (see loadCachedTemplate()), which may read inputs with different headers             */
+/*****************************************************************************************/
+static void resolveRendererNames (csvParser *ps, mdRenderer *rd, runOptions *opt)
+{
+    /* Local Variables */
+    mdTemplate      *tmpl;
+    templateSegment *segments;
+    char            *file,
+                     error[256];
+    bool             headerRead = false;
+    int              level;
+
+    for (level=-1; level<rd->levelNo; level++)
+    {
+        tmpl = (level<0) ? &rd->rowTemplate : &rd->chapterTemplate[level];
+        file = (level<0) ? opt->inputMdTemplate : opt->inputMdChapterTemplate[level];
+        if (tmpl->namedRefNo==0)
+            continue;
+        if (!opt->skipHeader)
+        {
+            printf ("Invalid markdown template %s (column names cannot be used with option -n, the first line is not a header)... Aborting\n\n",file);
+            exit (-1);
+        }
+        if ( !headerRead && !(headerRead=readCsvHeader(ps)) )
+        {
+            printf ("The markdown template %s refers to columns by name, but the csv input file has no header row... Aborting\n\n",file);
+            exit (-1);
+        }
+        if ( (segments=malloc(tmpl->segmentNo*sizeof(templateSegment)))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+        memcpy (segments,tmpl->segments,tmpl->segmentNo*sizeof(templateSegment));
+        tmpl->segments = segments;
+        if (!resolveMdTemplate(tmpl,ps->fieldNo,ps->fields,error,sizeof(error)))
+        {
+            printf ("Invalid markdown template %s (%s)... Aborting\n\n",file,error);
+            exit (-1);
+        }
+    }   /* for (level=-1; level<rd->levelNo; level++) */
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Convert a csv input file into a markdown output file according to the given options  */
+/* (or print the fields of the first valid line, option -d). Templates are taken from   */
+/* the cache when one is given (option -b)                                               */
+/*****************************************************************************************/
+static void runConversion (runOptions *opt, templateCache *cache)
+{
+    /* Local Variables */
+    int             i,
+                    threadNo = opt->threadNo;
+    csvParser       ps = {0};
+    mdRenderer      rd = {0};
+    outputBuffer    outputMd;
+    groupIndex      gi;
+    rowIndex        ri;
+    recordIndex     rx;
+    fanOutput       fo;
+    runStats        stats = {0};
+    uint64_t        startNs = 0;
+    size_t          rowNo = 0,
+                    rendered = 0,
+                    firstRecord = 0,
+                    inputSize,
+                    rangeEnd;
+    bool            selectRows = ( (opt->skipRows>0) || (opt->lastRow>0) || (opt->headRows>0) || (opt->sampleStep>1) ),
+                    fanOut = ( (opt->altSyntax==STANDARD) && isPathPattern(opt->outputMdFile,opt->placeHolder) ),
+                    seekRows = false,
+                    selected,
+                    lastRow = false;
+
+    /* Open the Input File and set up the parser */
+    if (opt->statsFormat!=STATSNONE)
+        startNs = statsClock();
+    openInputCsv (&ps.in,opt->inputCsvFile);
+    startAsyncInput (&ps.in,opt->asyncIo);
+    ps.separator = opt->separator;
+    ps.multiLine = opt->multiLine;
+    ps.comment = opt->comment;
+    ps.rfc4180 = opt->rfc4180;
+    ps.skipHeader = opt->skipHeader;
+    if (!initScanner(&ps,opt->scanner))
+    {
+        printf ("The requested scanner is not supported by this CPU... Aborting\n\n");
+        exit (-1);
+    }
+
+    /* Load and compile the markdown template(s) once, and resolve the column names they  */
+    /* use against the header row, so that a bad template is reported before the output   */
+    /* is opened. For each chapter markdown template (one per chapter level, in the order  */
+    /* given by -c options), take the first placeholder found in it (we consider only the */
+    /* first in case that more than one are present in the file). Save this value to the  */
+    /* chapterFieldNo array, that will be used in conjunction with the lastChapter array  */
+    /* to print out the new chapters whenever needed                                       */
+    rd.placeHolder = opt->placeHolder;
+    rd.levelNo = opt->levelNo;
+    if (opt->altSyntax==STANDARD)
+    {
+        loadCachedTemplate (cache,&rd.rowTemplate,opt->inputMdTemplate,opt->placeHolder,"Unable to open input Markdown Template... Aborting\n\n");
+        for (i=0; i<rd.levelNo; i++)
+            loadCachedTemplate (cache,&rd.chapterTemplate[i],opt->inputMdChapterTemplate[i],opt->placeHolder,"Unable to open the input Markdown Chapter Template... Aborting\n\n");
+        resolveRendererNames (&ps,&rd,opt);
+        for (i=0; i<rd.levelNo; i++)
+        {
+            if (rd.chapterTemplate[i].firstFieldRef>0)
+                rd.chapterFieldNo[i] = rd.chapterTemplate[i].firstFieldRef;
+        }   /* for (i=0; i<rd.levelNo; i++) */
+    }   /* if (opt->altSyntax==STANDARD) */
+
+    /* Open the Output File(s) */
+    if (fanOut)
+        openFanOutput (&fo,opt);
+    else if ( (opt->altSyntax==STANDARD) && (opt->indexFile[0]=='\0') )
+    {
+        openOutputBuffer (&outputMd,opt->outputMdFile,opt->appendMode,opt->outBufSize,opt->syncPolicy,opt->compress);
+        startAsyncOutput (&outputMd,opt->asyncIo);
+    }
+    if (opt->statsFormat!=STATSNONE)
+    {
+        ps.stats = &stats;
+        rd.stats = &stats;
+        fo.stats = &stats;
+    }
+    if (opt->altSyntax==STANDARD)
+    {
+        if (opt->indexFile[0]!='\0')
+            openRowIndex (&ri,&outputMd,opt,&rd);
+        if ( (opt->statsFormat!=STATSNONE) && !fanOut )
+            outputMd.stats = &stats;
+    }   /* if (opt->altSyntax==STANDARD) */
+
+    /* Start Parsing CSV Input Row-by-Row */
+    if (opt->altSyntax==STANDARD)
+    {
+        compileRowFilter (&ps,opt);
+        projectFields (&ps,&rd,(fanOut)?&fo.pattern:NULL,(int)opt->keyColumn-1);
+    }
+    if (opt->recordIndexFile[0]!='\0')
+        openRecordIndex (&rx,&ps,opt->recordIndexFile,opt->inputCsvFile);
+    else if (opt->keysFile[0]!='\0')
+    {   /* Key lookups need the offset of each row, built in memory */
+        if (ps.in.codec!=NULL)
+        {
+            printf ("Key lookups require an uncompressed input csv file (... --key-column <column> --keys <keys_file>)... Aborting\n\n");
+            exit (-1);
+        }
+        memset (&rx,0,sizeof(recordIndex));
+        buildRecordIndex (&rx,&ps);
+    }
+    if ( ps.in.stream || (opt->groupOrder!=GROUPNONE) || (opt->indexFile[0]!='\0') || selectRows || (opt->keysFile[0]!='\0') || fanOut )
+        threadNo = 1;                           /* Rows are rendered by a single thread */
+    if (opt->groupOrder!=GROUPNONE)
+        openGroupIndex (&gi,opt->groupOrder,opt->groupMemory);
+    if ( (opt->altSyntax==STANDARD) && (threadNo>1) )
+        renderParallel (&ps,&rd,&outputMd,threadNo,opt->scanner,(opt->recordIndexFile[0]!='\0')?&rx:NULL);
+    if ( (opt->altSyntax==STANDARD) && (opt->keysFile[0]!='\0') )
+        renderKeyRows (&ps,&rx,&rd,&outputMd,opt);
+    inputSize = rangeEnd = ps.in.size;
+    if ( selectRows && (opt->whereNo==0) && (opt->recordIndexFile[0]!='\0') && ps.in.mapped )
+    {   /* The rows selected are read directly from their offset in the input, and the  */
+        /* input is not read beyond the last one                                        */
+        seekRows = true;
+        firstRecord = (ps.skipHeader) ? 1 : 0;
+        ps.skipHeader = false;
+        if (opt->lastRow>0)
+            rangeEnd = recordOffset (&rx,firstRecord+opt->lastRow,inputSize);
+        rowNo = opt->skipRows;
+        seekCsv (&ps,recordOffset(&rx,firstRecord+rowNo,rangeEnd),rangeEnd);
+    }
+    if ( selectRows && (opt->whereNo==0) )
+        ps.skipFields = !rowSelected (opt,rowNo+1); /* Rows not selected are not split at all */
+    while ( readCsvRow(&ps) )
+    {
+        if (selectRows)
+        {   /* Options --skip, --head, --rows and --sample: stop reading the input as */
+            /* soon as the requested rows have been rendered                          */
+            rowNo += 1;
+            selected = rowSelected (opt,rowNo);
+            if ( seekRows && selected && (opt->sampleStep>1) )
+            {   /* Jump to the next row sampled */
+                rowNo += opt->sampleStep-1;
+                seekCsv (&ps,recordOffset(&rx,firstRecord+rowNo,rangeEnd),rangeEnd);
+            }
+            if (opt->whereNo==0)
+                ps.skipFields = !rowSelected (opt,rowNo+1);
+            if ( selected && (opt->headRows>0) && (++rendered>=opt->headRows) )
+                lastRow = true;
+            if ( (opt->lastRow>0) && (rowNo>=opt->lastRow) )
+                lastRow = true;
+            if (!selected && lastRow)
+                break;
+            if (!selected)
+                continue;
+        }   /* if (selectRows) */
+
+        /* Write fields just extracted into the output file (using the template(s) and     */
+        /* substituting placeholders). Observe that in case opt->altSyntax==DECODEHDR, the       */
+        /* behaviour is different, since curent fields are printed to screen and then the   */
+        /* parsing is terminated (i.e. this is done only once for the first row selected)   */
+        if (opt->altSyntax==DECODEHDR)
+        {   /* option -d was specified and we have just isolated into fields[] array */
+            /* the content of the first valid line in the input csv file (or of the  */
+            /* first row after --skip). Print them once and exit                     */
+            currentRowPrintFields(ps.fieldNo,ps.fields);
+            break;
+        }   /* if (opt->altSyntax==DECODEHDR) */
+
+        if (opt->groupOrder!=GROUPNONE)
+            renderGroupedRow (&rd,&gi,ps.fieldNo,ps.fields);
+        else if (opt->indexFile[0]!='\0')
+            renderIndexedRow (&rd,&ri,&outputMd,ps.fieldNo,ps.fields);
+        else if (fanOut)
+            renderFanOutRow (&rd,&fo,ps.fieldNo,ps.fields);
+        else
+            renderCsvRow (&rd,&outputMd,ps.fieldNo,ps.fields);
+        if (lastRow)
+            break;
+    }   /* while ( readCsvRow(&ps) ) */
+    if (opt->groupOrder!=GROUPNONE)
+        writeChapterGroups (&gi,&outputMd);
+
+    /* Processing terminated           */
+    /* Close all files and free memory */
+    if (seekRows)
+        ps.in.size = inputSize;             /* Limited by seekCsv() to the rows selected */
+    closeInputCsv (&ps.in);
+    if ( (opt->recordIndexFile[0]!='\0') || (opt->keysFile[0]!='\0') )
+        closeRecordIndex (&rx);
+    if ( (opt->altSyntax==STANDARD) && (opt->indexFile[0]!='\0') )
+        closeRowIndex (&ri,&outputMd);
+    else if (fanOut)
+        closeFanOutput (&fo);
+    else if (opt->altSyntax==STANDARD)
+        closeOutputBuffer (&outputMd);
+    if (opt->statsFormat!=STATSNONE)
+        printStats (&stats,opt->statsFormat,statsClock()-startNs,threadNo);
+    freeCsvParser (&ps);
+    freeRowFilter (&ps);
+    for (i=0; i<rd.levelNo; i++)
+        free (rd.lastChapter[i].ptr);
+    if ( (opt->altSyntax==STANDARD) && (rd.rowTemplate.namedRefNo>0) )
+        free (rd.rowTemplate.segments);     /* Copies made by resolveRendererNames() */
+    for (i=0; (opt->altSyntax==STANDARD) && (i<rd.levelNo); i++)
+    {
+        if (rd.chapterTemplate[i].namedRefNo>0)
+            free (rd.chapterTemplate[i].segments);
+    }   /* for (i=0; (opt->altSyntax==STANDARD) && (i<rd.levelNo); i++) */
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Split a line of the manifest into arguments, separated by spaces or tabs. Arguments   */
+/* can be enclosed by double quotes (e.g. file names with spaces, or -s ";"). argv[0] is */
+/* set to the name of the tool, as for the command line. It returns the number of        */
+/* arguments, -1 if there are too many                                                   */
+/*****************************************************************************************/
+static int splitManifestLine (char *line, char *argv[], int argMax)
+{
+    /* Local Variables */
+    char   *p = line;
+    int     argc = 1;
+
+    argv[0] = "csv2mdText";
+    for (;;)
+    {
+        while ( (*p!='\0') && isspace((unsigned char)*p) )
+            p++;
+        if (*p=='\0')
+            break;
+        if (argc>=argMax)
+            return (-1);
+        if (*p=='"')
+        {
+            argv[argc++] = ++p;
+            while ( (*p!='\0') && (*p!='"') )
+                p++;
+        }
+        else
+        {
+            argv[argc++] = p;
+            while ( (*p!='\0') && !isspace((unsigned char)*p) )
+                p++;
+        }
+        if (*p=='\0')
+            break;
+        *p++ = '\0';
+    }   /* for (;;) */
+
+    return (argc);
+}
+
+
+/*****************************************************************************************/
+/* Worker thread of the batch mode (option -b): jobs writing the same output file form  */
+/* a chain, which is run by a single worker in manifest order, so that appends (-a) to  */
+/* the same output are done in the right order, while independent outputs are produced */
+/* in parallel                                                                          */
+/*****************************************************************************************/
+static void *batchWorker (void *arg)
+{
+    /* Local Variables */
+    batchPool  *pool = arg;
+    int         i;
+
+    for (;;)
+    {
+        pthread_mutex_lock (&pool->lock);
+        while ( (pool->next<pool->jobNo) && !pool->jobs[pool->next].chainHead )
+            pool->next += 1;
+        i = pool->next;
+        pool->next += 1;
+        pthread_mutex_unlock (&pool->lock);
+        if (i>=pool->jobNo)
+            break;
+
+        for (; i>=0; i=pool->jobs[i].nextSameOutput)
+            runConversion (&pool->jobs[i].opt,&pool->cache);
+    }   /* for (;;) */
+
+    return (NULL);
+}
+
+
+/*****************************************************************************************/
+/* Batch mode (option -b): read the manifest, one job per line with the same options of  */
+/* the command line (the options given on the command line apply to all jobs), and run  */
+/* the jobs with threadNo worker threads. Templates are compiled once and shared by all */
+/* the jobs that use them                                                                */
+/*****************************************************************************************/
+static void runBatch (runOptions *defaults)
+{
+    /* Local Variables */
+    FILE       *manifestFd;
+    batchPool   pool;
+    batchJob   *job;
+    pthread_t   threads[MAXTHREADS];
+    char       *line = NULL,
+               *jobArgv[MAXJOBARGS];
+    size_t      lineCap = 0;
+    int         jobArgc,
+                jobCap = 0,
+                lineNo = 0,
+                threadNo,
+                i, j;
+
+    if (strcmp(defaults->manifestFile,"-")==0)
+        manifestFd = stdin;
+    else if ( (manifestFd=fopen(defaults->manifestFile,"r"))==NULL )
+    {
+        printf ("Unable to open the manifest file... Aborting\n\n");
+        exit (-1);
+    }
+
+    memset (&pool,0,sizeof(batchPool));
+    pthread_mutex_init (&pool.lock,NULL);
+    pthread_mutex_init (&pool.cache.lock,NULL);
+    while (getline(&line,&lineCap,manifestFd)>=0)
+    {
+        lineNo += 1;
+        if ( (jobArgc=splitManifestLine(line,jobArgv,MAXJOBARGS))<0 )
+        {
+            printf ("Too many arguments in line %d of the manifest file... Aborting\n\n",lineNo);
+            exit (-1);
+        }
+        if ( (jobArgc==1) || (jobArgv[1][0]==defaults->comment) )
+            continue;                               /* Empty line or comment */
+
+        if (pool.jobNo==jobCap)
+        {
+            jobCap = (jobCap==0) ? 64 : 2*jobCap;
+            if ( (pool.jobs=realloc(pool.jobs,jobCap*sizeof(batchJob)))==NULL )
+            {
+                printf ("Memory allocation failure... Aborting\n\n");
+                exit (-1);
+            }
+        }   /* if (pool.jobNo==jobCap) */
+        job = &pool.jobs[pool.jobNo];
+        job->opt = *defaults;
+        job->opt.manifestFile[0] = '\0';
+        job->opt.threadNo = DEFTHREADS;
+        parseOptions (jobArgc,jobArgv,&job->opt);
+        if ( (job->opt.altSyntax!=STANDARD) || (job->opt.manifestFile[0]!='\0') || (job->opt.serveSocket[0]!='\0') ||
+             (strcmp(job->opt.inputCsvFile,"-")==0) || (strcmp(job->opt.outputMdFile,"-")==0) )
+        {
+            printf ("Invalid job in line %d of the manifest file (standard input and output, -d, -b and --serve are not allowed)... Aborting\n\n",lineNo);
+            exit (-1);
+        }
+        checkOptions (&job->opt);
+
+        /* Chain the job after the last one writing the same output file */
+        job->nextSameOutput = -1;
+        job->chainHead = true;
+        for (j=pool.jobNo-1; j>=0; j--)
+        {
+            if (strcmp(pool.jobs[j].opt.outputMdFile,job->opt.outputMdFile)==0)
+            {
+                pool.jobs[j].nextSameOutput = pool.jobNo;
+                job->chainHead = false;
+                break;
+            }
+        }   /* for (j=pool.jobNo-1; j>=0; j--) */
+        pool.jobNo += 1;
+    }   /* while (getline(&line,&lineCap,manifestFd)>=0) */
+    free (line);
+    if (manifestFd!=stdin)
+        fclose (manifestFd);
+
+    threadNo = (defaults->threadNo<pool.jobNo) ? defaults->threadNo : pool.jobNo;
+    for (i=0; i<threadNo; i++)
+    {
+        if (pthread_create(&threads[i],NULL,batchWorker,&pool)!=0)
+        {
+            printf ("Unable to create worker threads... Aborting\n\n");
+            exit (-1);
+        }
+    }   /* for (i=0; i<threadNo; i++) */
+    for (i=0; i<threadNo; i++)
+        pthread_join (threads[i],NULL);
+
+    free (pool.jobs);
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Signal handler of the server (SIGINT and SIGTERM): it stops at the next poll()        */
+/*****************************************************************************************/
+static void stopServer (int sig)
+{
+    (void)sig;
+    serverStop = 1;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Release the key indexes of the server                                                 */
+/*****************************************************************************************/
+static void freeKeyIndexes (csvServer *srv)
+{
+    /* Local Variables */
+    keyIndex   *key, *next;
+
+    for (key=srv->keys; key!=NULL; key=next)
+    {
+        next = key->next;
+        closeKeyIndex (key);
+        free (key);
+    }
+    srv->keys = NULL;
+
+    return;
+}
+
+
+/*****************************************************************************************/
+/* Load the input CSV file of the server and its record index, or reload them if the    */
+/* size or the modification time of the input changed since they were loaded (the key  */
+/* indexes are dropped, they are rebuilt on demand). It returns false if the input     */
+/* cannot be accessed, in which case the content loaded before (if any) is still used  */
+/*****************************************************************************************/
+static bool loadServerInput (csvServer *srv)
+{
+    /* Local Variables */
+    struct stat st;
+    char       *text;
+    size_t      len;
+    int         i;
+
+    if ( (stat(srv->opt->inputCsvFile,&st)<0) || !S_ISREG(st.st_mode) || (fileCodec(srv->opt->inputCsvFile)!=CODECNONE) )
+        return (false);
+    if ( (st.st_size==srv->inputStSize) && (st.st_mtim.tv_sec==srv->inputMtime.tv_sec) &&
+         (st.st_mtim.tv_nsec==srv->inputMtime.tv_nsec) )
+        return (true);
+
+    if (srv->inputStSize>=0)
+    {
+        srv->ps.in.size = srv->inputSize;
+        closeInputCsv (&srv->ps.in);
+        closeRecordIndex (&srv->rx);
+        freeKeyIndexes (srv);
+    }
+    openInputCsv (&srv->ps.in,srv->opt->inputCsvFile);
+    srv->ps.skipHeader = false;
+    if (srv->opt->recordIndexFile[0]!='\0')
+        openRecordIndex (&srv->rx,&srv->ps,srv->opt->recordIndexFile,srv->opt->inputCsvFile);
+    else
+    {
+        memset (&srv->rx,0,sizeof(recordIndex));
+        buildRecordIndex (&srv->rx,&srv->ps);
+    }
+    if (srv->ps.in.mapped)
+        madvise (srv->ps.in.data,srv->ps.in.size,MADV_RANDOM);
+    srv->inputSize = srv->ps.in.size;
+    srv->firstRecord = ( srv->opt->skipHeader && (srv->rx.recordNo>0) ) ? 1 : 0;
+    srv->inputStSize = st.st_size;
+    srv->inputMtime = st.st_mtim;
 
-    for (i=0; i<fieldNo; i++)
-        printf ("Field %d:\t%s\n", i+1, fields[i]);
-    printf ("\n");
+    /* Keep a copy of the header, used to resolve the column names of the templates */
+    free (srv->header);
+    srv->header = NULL;
+    srv->headerNo = -1;
+    if ( (srv->firstRecord>0) && readRecord(&srv->ps,&srv->rx,0,srv->inputSize) )
+    {
+        for (i=0, len=0; i<srv->ps.fieldNo; i++)
+            len += srv->ps.fields[i].len;
+        if ( (srv->header=malloc(srv->ps.fieldNo*sizeof(fieldView)+len+1))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+        text = (char *)(srv->header + srv->ps.fieldNo);
+        for (i=0; i<srv->ps.fieldNo; i++)
+        {
+            memcpy (text,srv->ps.fields[i].ptr,srv->ps.fields[i].len);
+            srv->header[i].ptr = text;
+            srv->header[i].len = srv->ps.fields[i].len;
+            text += srv->ps.fields[i].len;
+        }   /* for (i=0; i<srv->ps.fieldNo; i++) */
+        srv->headerNo = srv->ps.fieldNo;
+    }
+    srv->inputLoads += 1;
 
-    return;
+    return (true);
 }
 
 
-/*****************
- * Main Function *
- *****************/
-int main(int argc, char *argv[], char *envp[])
+/*****************************************************************************************/
+/* Compiled markdown template of the server, compiled again if the file changed since   */
+/* the last time; its column names are resolved again whenever the input is reloaded.  */
+/* It returns NULL if the file cannot be read, or if it is not valid or a column name   */
+/* cannot be resolved (in which case error is set to the reason). A template that is    */
+/* no longer valid does not replace the one compiled before                             */
+/*****************************************************************************************/
+static mdTemplate *loadServerTemplate (csvServer *srv, char *file, char **error)
 {
     /* Local Variables */
-    int             i,
-                    lineNo,
-                    fieldNo,
-                    chapterFieldNo,
-                    altSyntax = UNDEFINED;
-    filenameString  inputCsvFile = "",
-                    inputMdTemplate = "",
-                    outputMdFile = "",
-                    inputMdChapterTemplate = "";
-    lineString      currentLine;
-    fieldString     fields[MAXFIELDS],
-                    lastChapter = "";
-    FILE           *inputCsvFd,
-                   *outputMdFd,
-                   *inputMdChapterTemplateFd;
-    bool            skipHeader = DEFHEADER,
-                    appendMode = DEFAPPEND,
-                    firstLine,
-                    multiLineOpen;
-    char           *p,
-                    separator = DEFSEPARATOR,
-                    comment = DEFCOMMENT,
-                    placeHolder = DEFPLACEHLDR,
-                    multiLine = DEFMULTILINE;
+    serverTemplate *entry;
+    mdTemplate      tmpl;
+    struct stat     st;
+    char            reason[MAXFILENAMELEN+256];
 
-    /* Preliminary Checks - Check Command Layout & Parse Input Parameters */
-    if ( (argc==2) && (strcmp(argv[1],"-h")==0) )
+    if ( (strlen(file)>MAXFILENAMELEN) || (stat(file,&st)<0) || !S_ISREG(st.st_mode) || (access(file,R_OK)<0) )
+        return (NULL);
+    for (entry=srv->templates; entry!=NULL; entry=entry->next)
+        if (strcmp(entry->file,file)==0)
+            break;
+    if (entry==NULL)
     {
-        /* Print complete help and exit */
-        printHelp();
-        exit (0);
+        if ( (entry=calloc(1,sizeof(serverTemplate)))==NULL )
+        {
+            printf ("Memory allocation failure... Aborting\n\n");
+            exit (-1);
+        }
+        strcpy (entry->file,file);
+        entry->next = srv->templates;
+        srv->templates = entry;
+    }   /* if (entry==NULL) */
+    else if ( (st.st_size==entry->size) && (st.st_mtim.tv_sec==entry->mtime.tv_sec) &&
+              (st.st_mtim.tv_nsec==entry->mtime.tv_nsec) && (entry->inputLoad==srv->inputLoads) )
+        return (&entry->tmpl);
+    if ( (entry->tmpl.segments==NULL) || (st.st_size!=entry->size) || (st.st_mtim.tv_sec!=entry->mtime.tv_sec) ||
+         (st.st_mtim.tv_nsec!=entry->mtime.tv_nsec) )
+    {   /* New or changed template */
+        if (!compileMdTemplate(&tmpl,file,srv->opt->placeHolder,reason,sizeof(reason)))
+        {
+            if (reason[0]!='\0')
+            {
+                snprintf (srv->error,sizeof(srv->error),"invalid markdown template %s",reason);
+                *error = srv->error;
+            }
+            return (NULL);
+        }
+        freeMdTemplate (&entry->tmpl);
+        entry->tmpl = tmpl;
+        entry->size = st.st_size;
+        entry->mtime = st.st_mtim;
     }
+    entry->inputLoad = srv->inputLoads;
 
-    if ( (argc<3)||(argc>17) )
+    if ( (entry->tmpl.namedRefNo>0) && (srv->headerNo<0) )
     {
-        printUsage();
-        exit (-1);
+        snprintf (srv->error,sizeof(srv->error),"%s refers to columns by name, but the csv input file has no header row",file);
+        *error = srv->error;
+        entry->inputLoad = 0;
+        return (NULL);
     }
-    for (i=1;i<argc;i++)
+    if ( (entry->tmpl.namedRefNo>0) && !resolveMdTemplate(&entry->tmpl,srv->headerNo,srv->header,reason,sizeof(reason)) )
     {
-        if (argv[i][0]!='-')
+        snprintf (srv->error,sizeof(srv->error),"%s: %s",file,reason);
+        *error = srv->error;
+        entry->inputLoad = 0;
+        return (NULL);
+    }
+
+    return (&entry->tmpl);
+}
+
+
+/*****************************************************************************************/
+/* Parse the first row whose key column (0-based) is equal to the given value. The      */
+/* index of the key column is built (or loaded, see --record-index) when first used     */
+/*****************************************************************************************/
+static bool findServerRow (csvServer *srv, int field, char *value, size_t len)
+{
+    /* Local Variables */
+    keyIndex   *key;
+    size_t      cursor;
+
+    for (key=srv->keys; (key!=NULL) && (key->field!=field); key=key->next)
+        ;
+    if (key==NULL)
+    {
+        if ( (key=calloc(1,sizeof(keyIndex)))==NULL )
         {
-            printUsage();
+            printf ("Memory allocation failure... Aborting\n\n");
             exit (-1);
-        }   /* if (argv[i][0]!='-') */
-        switch (argv[i][1])
+        }
+        openKeyIndex (key,&srv->ps,&srv->rx,srv->inputSize,field,srv->firstRecord,srv->opt->recordIndexFile,srv->opt->inputCsvFile);
+        key->next = srv->keys;
+        srv->keys = key;
+    }   /* if (key==NULL) */
+    cursor = firstKeyRow (key,value,len);
+
+    return (nextKeyRecord(key,&srv->ps,&srv->rx,srv->inputSize,value,len,&cursor,NULL));
+}
+
+
+/*****************************************************************************************/
+/* Send len bytes to a client of the server. It returns false if the connection failed   */
+/*****************************************************************************************/
+static bool sendReply (int fd, char *data, size_t len)
+{
+    /* Local Variables */
+    ssize_t sent;
+
+    while (len>0)
+    {
+        if ( (sent=send(fd,data,len,MSG_NOSIGNAL))<0 )
         {
-            case 'd':
-            {
-                i +=1;
-                if ( (altSyntax==STANDARD) || (i>=argc) )
-                {
-                    printUsage();
-                    exit (-1);
-                }
-                altSyntax = DECODEHDR;
-                skipHeader = false;     /* reset in any case skipHeader flag */
-                strcpy (inputCsvFile,argv[i]);
-                break;
-            }   /* case 'd': */
-            case 'i':
-            {
-                i +=1;
-                if ( (altSyntax==DECODEHDR) || (i>=argc) )
-                {
-                    printUsage();
-                    exit (-1);
-                }
-                altSyntax=STANDARD;
-                strcpy (inputCsvFile,argv[i]);
-                break;
-            }   /* case 'i': */
-            case 'o':
-            {
-                i +=1;
-                if ( (altSyntax==DECODEHDR) || (i>=argc) )
-                {
-                    printUsage();
-                    exit (-1);
-                }
-                altSyntax=STANDARD;
-                strcpy (outputMdFile,argv[i]);
-                break;
-            }   /* case 'o': */
-            case 't':
-            {
-                i +=1;
-                if ( (altSyntax==DECODEHDR) || (i>=argc) )
-                {
-                    printUsage();
-                    exit (-1);
-                }
-                altSyntax=STANDARD;
-                strcpy (inputMdTemplate,argv[i]);
-                break;
-            }   /* case 't': */
-            case 'n':
-            {
-                if (altSyntax==DECODEHDR)
-                {
-                    printUsage();
-                    exit (-1);
-                }
-                altSyntax=STANDARD;
-                skipHeader = false;
-                break;
-            }   /* case 'n': */
-            case 'a':
-            {
-                if (altSyntax==DECODEHDR)
-                {
-                    printUsage();
-                    exit (-1);
-                }
-                altSyntax=STANDARD;
-                appendMode = true;
-                break;
-            }   /* case 'a': */
-            case 's':
-            {
-                i +=1;
-                if ( (altSyntax==DECODEHDR) || (i>=argc) )
-                {
-                    printUsage();
-                    exit (-1);
-                }
-                altSyntax=STANDARD;
-                separator = argv[i][0];
-                break;
-            }   /* case 's': */
-            case 'p':
-            {
-                i +=1;
-                if ( (altSyntax==DECODEHDR) || (i>=argc) )
-                {
-                    printUsage();
-                    exit (-1);
-                }
-                altSyntax=STANDARD;
-                placeHolder = argv[i][0];
-                break;
-            }   /* case 'p': */
-            case 'r':
-            {
-                i +=1;
-                if ( (altSyntax==DECODEHDR) || (i>=argc) )
-                {
-                    printUsage();
-                    exit (-1);
-                }
-                altSyntax=STANDARD;
-                comment = argv[i][0];
-                break;
-            }   /* case 'r': */
-            case 'c':
-            {
-                i +=1;
-                if ( (altSyntax==DECODEHDR) || (i>=argc) )
-                {
-                    printUsage();
-                    exit (-1);
-                }
-                altSyntax=STANDARD;
-                strcpy (inputMdChapterTemplate,argv[i]);
-                break;
-            }   /* case 'c': */
-            default:
-            {   /* Unexpected option */
-                printUsage();
-                exit(-1);
-            }   /* default */
-        }   /* switch (argv[i][1]) */
+            if (errno==EINTR)
+                continue;
+            return (false);
+        }
+        data += sent;
+        len -= sent;
+    }   /* while (len>0) */
+
+    return (true);
+}
+
+
+/*****************************************************************************************/
+/* Serve a request of a client (a line, without its newline):                            */
+/*     ROW <row> [<md_template>]              row number, from 1 (header excluded)       */
+/*     KEY <column> <value> [<md_template>]   first row whose column is equal to value   */
+/* The reply is either "OK <bytes>" followed by a newline and the markdown of the row    */
+/* (preceded by its chapter headings, see -c), or "ERR <message>" and a newline. Input   */
+/* file and templates are reloaded first if they changed. It returns false if the       */
+/* connection failed                                                                     */
+/*****************************************************************************************/
+static bool serveRequest (csvServer *srv, int fd, char *line)
+{
+    /* Local Variables */
+    char       *argv[MAXREQUESTARGS],
+               *templateFile = srv->opt->inputMdTemplate,
+               *error = NULL,
+               *p,
+                header[128];
+    mdTemplate *tmpl = NULL,
+               *chapter[MAXLEVELS];
+    size_t      rowNo = 0,
+                column = 0;
+    int         argc, level, headerLen;
+
+    if ( (argc=splitManifestLine(line,argv,MAXREQUESTARGS))==1 )
+        return (true);                      /* Empty request */
+    loadServerInput (srv);
+
+    /* Parse the row requested */
+    if ( (argc>=3) && (argc<=4) && (strcmp(argv[1],"ROW")==0) )
+    {
+        if (argc==4)
+            templateFile = argv[3];
+        if ( ((p=parseCount(argv[2],&rowNo))==NULL) || (*p!='\0') || (rowNo==0) )
+            error = "invalid row number";
+        else if ( (rowNo>srv->rx.recordNo-srv->firstRecord) || !readRecord(&srv->ps,&srv->rx,srv->firstRecord+rowNo-1,srv->inputSize) )
+            error = "row not found";
+    }
+    else if ( (argc>=4) && (argc<=5) && (strcmp(argv[1],"KEY")==0) )
+    {
+        if (argc==5)
+            templateFile = argv[4];
+        if ( ((p=parseCount(argv[2],&column))==NULL) || (*p!='\0') || (column==0) || (column>INT_MAX) )
+            error = "invalid key column";
+        else if (!findServerRow(srv,column-1,argv[3],strlen(argv[3])))
+            error = "key not found";
     }
+    else
+        error = "invalid request (ROW <row> [<md_template>] or KEY <column> <value> [<md_template>])";
 
-    /* Check that mandatory parameters have been specified */
-    if (inputCsvFile[0]=='\0')
+    /* Load the templates and check them against the row */
+    if ( (error==NULL) && ((tmpl=loadServerTemplate(srv,templateFile,&error))==NULL) && (error==NULL) )
+        error = "unable to read the markdown template";
+    for (level=0; (level<srv->opt->levelNo) && (error==NULL); level++)
     {
-        if (altSyntax==DECODEHDR)
-            printf ("Missing mandatory input csv file (... -d <csv_input_file>)... Aborting\n\n");
-        else
-            printf ("Missing mandatory input csv file (... -i <csv_input_file>)... Aborting\n\n");
+        chapter[level] = loadServerTemplate (srv,srv->opt->inputMdChapterTemplate[level],&error);
+        if ( (chapter[level]==NULL) && (error==NULL) )
+            error = "unable to read the markdown chapter template";
+        else if ( (chapter[level]!=NULL) && ((chapter[level]->firstFieldRef<1) || (chapter[level]->firstFieldRef>srv->ps.fieldNo)) )
+            chapter[level] = NULL;          /* Level skipped, as in renderCsvRow() */
+        else if ( (chapter[level]!=NULL) && !fitsMdTemplate(chapter[level],srv->ps.fieldNo) )
+            error = "the markdown chapter template refers to a non-existing field";
+    }   /* for (level=0; (level<srv->opt->levelNo) && (error==NULL); level++) */
+    if ( (error==NULL) && !fitsMdTemplate(tmpl,srv->ps.fieldNo) )
+        error = "the markdown template refers to a non-existing field";
+    if (error!=NULL)
+    {   /* The message is a single line (e.g. file names containing newlines) */
+        if (error!=srv->error)
+            snprintf (srv->error,sizeof(srv->error),"%s",error);
+        for (p=srv->error; (p=strpbrk(p,"\r\n"))!=NULL; p++)
+            *p = ' ';
+        return ( sendReply(fd,"ERR ",4) && sendReply(fd,srv->error,strlen(srv->error)) && sendReply(fd,"\n",1) );
+    }
+
+    /* Render the row, preceded by the headings of all its chapters */
+    srv->out.len = 0;
+    for (level=0; level<srv->opt->levelNo; level++)
+    {
+        if (chapter[level]!=NULL)
+            appendCsvRow2Output (&srv->out,chapter[level],srv->opt->placeHolder,srv->ps.fieldNo,srv->ps.fields);
+    }   /* for (level=0; level<srv->opt->levelNo; level++) */
+    appendCsvRow2Output (&srv->out,tmpl,srv->opt->placeHolder,srv->ps.fieldNo,srv->ps.fields);
+    headerLen = snprintf (header,sizeof(header),"OK %zu\n",srv->out.len);
+
+    return ( sendReply(fd,header,headerLen) && sendReply(fd,srv->out.buffer,srv->out.len) );
+}
+
+
+/*****************************************************************************************/
+/* Server mode (option --serve): listen on a Unix domain socket and render the rows     */
+/* requested by the clients (see serveRequest()). Input file, record index and compiled */
+/* templates are kept in memory, and reloaded when the files change. Several clients    */
+/* can be connected at once, each one sending any number of requests (one per line).   */
+/* The server stops on SIGINT or SIGTERM, removing the socket                           */
+/*****************************************************************************************/
+static void runServer (runOptions *opt)
+{
+    /* Local Variables */
+    csvServer           srv;
+    serverClient       *client;
+    struct sockaddr_un  addr;
+    struct pollfd       fds[MAXCLIENTS+1];
+    struct sigaction    sa;
+    int                 slots[MAXCLIENTS+1],
+                        listenFd, fd,
+                        level, i, n;
+    mode_t              mask;
+    ssize_t             got;
+    char               *line, *end,
+                       *error = NULL;
+    serverTemplate     *entry;
+    bool                bound,
+                        open;
+
+    memset (&srv,0,sizeof(csvServer));
+    srv.opt = opt;
+    srv.inputStSize = -1;
+    srv.ps.separator = opt->separator;
+    srv.ps.multiLine = opt->multiLine;
+    srv.ps.comment = opt->comment;
+    srv.ps.rfc4180 = opt->rfc4180;
+    if (!initScanner(&srv.ps,opt->scanner))
+    {
+        printf ("The requested scanner is not supported by this CPU... Aborting\n\n");
         exit (-1);
     }
-    if ( (altSyntax==STANDARD) && (outputMdFile[0]=='\0') )
+    if (!loadServerInput(&srv))
     {
-        printf ("Missing mandatory output markdown file (... -o <md_output_file>)... Aborting\n\n");
+        printf ("Unable to open input CSV File (server mode requires a regular uncompressed file)... Aborting\n\n");
         exit (-1);
     }
-    if ( (altSyntax==STANDARD) && (inputMdTemplate[0]=='\0') )
+    if (loadServerTemplate(&srv,opt->inputMdTemplate,&error)==NULL)
     {
-        printf ("Missing mandatory markdown teplate (... -t <md_template>)... Aborting\n\n");
+        if (error!=NULL)
+            printf ("Unable to use the input Markdown Template: %s... Aborting\n\n",error);
+        else
+            printf ("Unable to open input Markdown Template... Aborting\n\n");
         exit (-1);
     }
+    for (level=0; level<opt->levelNo; level++)
+    {
+        if (loadServerTemplate(&srv,opt->inputMdChapterTemplate[level],&error)==NULL)
+        {
+            if (error!=NULL)
+                printf ("Unable to use the input Markdown Chapter Template: %s... Aborting\n\n",error);
+            else
+                printf ("Unable to open the input Markdown Chapter Template... Aborting\n\n");
+            exit (-1);
+        }
+    }   /* for (level=0; level<opt->levelNo; level++) */
+    openMemoryOutput (&srv.out,DEFOUTBUFSIZE);
+    for (i=0; i<MAXCLIENTS; i++)
+        srv.clients[i].fd = -1;
 
-    /* Open Input and Output Files */
-    if ( (inputCsvFd=fopen(inputCsvFile,"r"))==NULL )
+    /* Create the socket, accessible by the owner only. A socket left behind by a server */
+    /* that is no longer running is replaced                                             */
+    memset (&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(opt->serveSocket)>=sizeof(addr.sun_path))
     {
-        printf ("Unable to open input CSV File... Aborting\n\n");
+        printf ("Socket path too long (... --serve <socket_file>)... Aborting\n\n");
         exit (-1);
     }
-    if (altSyntax==STANDARD)
+    strcpy (addr.sun_path,opt->serveSocket);
+    if ( (listenFd=socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0))<0 )
     {
-        if (appendMode)
-            outputMdFd=fopen(outputMdFile,"a");
-        else
-            outputMdFd=fopen(outputMdFile,"w");
-        if (outputMdFd==NULL)
+        printf ("Unable to create the socket (%s)... Aborting\n\n",strerror(errno));
+        exit (-1);
+    }
+    mask = umask (077);
+    bound = (bind(listenFd,(struct sockaddr *)&addr,sizeof(addr))==0);
+    if ( !bound && (errno==EADDRINUSE) )
+    {
+        if ( ((fd=socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0))>=0) && (connect(fd,(struct sockaddr *)&addr,sizeof(addr))==0) )
         {
-            printf ("Unable to open output Markdown File... Aborting\n\n");
+            printf ("Another server is listening on the socket (... --serve <socket_file>)... Aborting\n\n");
             exit (-1);
         }
-    }   /* if (altSyntax==STANDARD) */
+        if (fd>=0)
+            close (fd);
+        unlink (opt->serveSocket);
+        bound = (bind(listenFd,(struct sockaddr *)&addr,sizeof(addr))==0);
+    }
+    umask (mask);
+    if ( !bound || (listen(listenFd,MAXCLIENTS)<0) )
+    {
+        printf ("Unable to listen on the socket (%s)... Aborting\n\n",strerror(errno));
+        exit (-1);
+    }
 
+    memset (&sa,0,sizeof(sa));
+    sa.sa_handler = stopServer;
+    sigemptyset (&sa.sa_mask);
+    sigaction (SIGINT,&sa,NULL);
+    sigaction (SIGTERM,&sa,NULL);
 
-    /* If a chapter markdown template has been specified, extract the corresponding placeholder */
-    /* from it (we consider only the first in case that more than one are present in the file). */
-    /* Save this value to the chapterFieldNo variable, that will be used in conjunction with    */
-    /* lastChapter variable to print out the new chapter whenever needed                        */
-    chapterFieldNo = 0;
-    if ( (altSyntax==STANDARD) &&(inputMdChapterTemplate[0]!='\0') )
+    while (!serverStop)
     {
-        if ( (inputMdChapterTemplateFd=fopen(inputMdChapterTemplate,"r"))==NULL )
+        n = 0;
+        fds[n].fd = listenFd;
+        fds[n++].events = POLLIN;
+        for (i=0; i<MAXCLIENTS; i++)
+        {
+            if (srv.clients[i].fd>=0)
+            {
+                slots[n] = i;
+                fds[n].fd = srv.clients[i].fd;
+                fds[n++].events = POLLIN;
+            }
+        }   /* for (i=0; i<MAXCLIENTS; i++) */
+        if (poll(fds,n,-1)<0)
         {
-            printf ("Unable to open the input Markdown Chapter Template... Aborting\n\n");
+            if (errno==EINTR)
+                continue;
+            printf ("Unable to wait for requests (%s)... Aborting\n\n",strerror(errno));
             exit (-1);
         }
-        while (fgets(currentLine,MAXLINELEN,inputMdChapterTemplateFd))
+
+        /* New connections (closed at once if there are too many) */
+        if ( (fds[0].revents&POLLIN) && ((fd=accept4(listenFd,NULL,NULL,SOCK_CLOEXEC))>=0) )
         {
-            if ( (p=strchr(currentLine,placeHolder))==NULL)
+            for (i=0; (i<MAXCLIENTS) && (srv.clients[i].fd>=0); i++)
+                ;
+            if (i<MAXCLIENTS)
+            {
+                srv.clients[i].fd = fd;
+                srv.clients[i].len = 0;
+            }
+            else
+                close (fd);
+        }   /* if ( (fds[0].revents&POLLIN) && ... ) */
+
+        /* Requests of the clients, served as soon as their line is complete */
+        for (i=1; i<n; i++)
+        {
+            if ( (fds[i].revents&(POLLIN|POLLHUP|POLLERR))==0 )
                 continue;
-            p += 1;
-            while ( ((*p)!='\0') && isdigit(*p) )
+            client = &srv.clients[slots[i]];
+            if ( (got=read(client->fd,client->request+client->len,MAXREQUEST-client->len))<0 && (errno==EINTR) )
+                continue;
+            open = (got>0);
+            if (open)
+                client->len += got;
+            line = client->request;
+            while ( open && ((end=memchr(line,'\n',client->request+client->len-line))!=NULL) )
             {
-                chapterFieldNo = 10*chapterFieldNo + (int)(*p -'0');
-                p += 1;
-            }   /* while ( ((*p)!='\0') && isdigit(*p) ) */
-            break;
-        }   /* while (fgets(currentLine,MAXLINELEN,inputMdChapterTemplateFd)) */
-        fclose (inputMdChapterTemplateFd);
-    }   /* if ( (altSyntax==STANDARD) &&(inputMdChapterTemplate[0]!='\0') ) */
+                *end = '\0';
+                if ( (end>line) && (end[-1]=='\r') )
+                    end[-1] = '\0';
+                open = serveRequest (&srv,client->fd,line);
+                line = end+1;
+            }   /* while ( open && ... ) */
+            if (open)
+            {
+                client->len -= line - client->request;
+                memmove (client->request,line,client->len);
+                if (client->len==MAXREQUEST)
+                {
+                    sendReply (client->fd,"ERR request too long\n",strlen("ERR request too long\n"));
+                    open = false;
+                }
+            }   /* if (open) */
+            if (!open)
+            {
+                close (client->fd);
+                client->fd = -1;
+            }
+        }   /* for (i=1; i<n; i++) */
+    }   /* while (!serverStop) */
 
-    /* Start Parsing CSV Input Line-by-Line */
-    lineNo = 0;
-    firstLine= true;
-    multiLineOpen = false;
-    while ( fgets(currentLine,MAXLINELEN,inputCsvFd) )
+    /* Stopped by a signal */
+    for (i=0; i<MAXCLIENTS; i++)
+        if (srv.clients[i].fd>=0)
+            close (srv.clients[i].fd);
+    close (listenFd);
+    unlink (opt->serveSocket);
+    srv.ps.in.size = srv.inputSize;
+    closeInputCsv (&srv.ps.in);
+    closeRecordIndex (&srv.rx);
+    freeKeyIndexes (&srv);
+    free (srv.header);
+    while ( (entry=srv.templates)!=NULL )
     {
-        lineNo += 1;
-        currentLine[strcspn(currentLine, "\r\n")] = '\0';   /* Remove trailing CR, LF, CRLF, LFCR, etc.    */
-        removeDoubleMultiLineChar (currentLine,multiLine);  /* Remove double occurences of multi line char */
-
-        p = currentLine;
-
-        if (multiLineOpen==false)
-        {   /* The line we just started parsing is not part of a multi line */
-            fieldNo = 0;                        /* Reset the current field counter */
-            while ( (*p==' ') || (*p=='\t') )   /* Skip leading spaces and tabs (if any) */
-                p++;
-            if ( (*p=='\0') || (*p==comment) )  /* Check whether this is an empty line or a */
-                continue ;                      /* comment and, if so, skip this line       */
+        srv.templates = entry->next;
+        freeMdTemplate (&entry->tmpl);
+        free (entry);
+    }
+    free (srv.out.buffer);
+    freeCsvParser (&srv.ps);
 
-            if ( (firstLine) && (skipHeader) )
-            {   /* skipHeader flag is enabled and this is the first valid line, so skip it */
-                /* (note that if altSyntax==DECODEHDR, then skipHeader is forced to false, */
-                /* so that we never enter here if option -d was specified on command line) */
-                firstLine = false;
-                continue;
-            }   /* if ( (firstLine) && (skipHeader) ) */
-            firstLine = false;
-        }   /* if (multiLineOpen==false) */
-        else
-        {   /* here multiLineOpen==true */
-            if ((p==NULL) || (*p=='\0'))
-            {   /* Bug fixing - if the multiline starts with an empty line, it means that we */
-                /* have to add this empty line in the current field, otherwise some markdown */
-                /* format may not be properly reproduced in the output (e.g. bullets, etc.)  */
-                strcat (fields[fieldNo],"\n");
-            }   /* if (*p=='\0') */
-        }   /* else if (multiLineOpen==false) */
+    return;
+}
 
 
-        /* Here p points to the first valid character in the current csv input line */
-        /* It may either be the first non-space character of a single line or the   */
-        /* first character of a multi line (note that space characters are allowed  */
-        /* at the beginning of a line that is part of a multi line)                 */
-        /* Scan the line char-by-char until the end and handle it differently based */
-        /* on being or not being within a multi line (observe that a multi line may)*/
-        /* begin and end in the same line)                                          */
+/*****************
+ * Main Function *
+ *****************/
+int main(int argc, char *argv[], char *envp[])
+{
+    /* Local Variables */
+    runOptions      opt;
 
-        while ( (p!=NULL) && (*p!='\0') )
-        {
-            if (multiLineOpen)
-                multiLineOpen = scanMultiLine(&p,separator,multiLine,lineNo,&fieldNo,fields);
-            else
-                multiLineOpen = scanSingleLine(&p,separator,multiLine,lineNo,&fieldNo,fields);
-        }   /* while ( (p!=NULL) && (*p!='\0') ) */
-
-        /* The row is terminated. If there is no multi line ongoing, write fields just extracted */
-        /* into the output file (using the template(s) and substituting placeholders). Observe   */
-        /* that in case altSyntax==DECODEHDR, the behaviour is different, since curent fields    */
-        /* are printed to screen and then the execution is terminated (i.e. this is done only    */
-        /* once for the the first line)                                                          */
-        if (multiLineOpen == false)
-        {   /* The csv row is terminated and this is not a multi line */
-            if (altSyntax==DECODEHDR)
-            {   /* option -d was specified and we have just isolated into fields[] array */
-                /* the content of the first valid line in the input csv file             */
-                /* Print them once and exit                                              */
-                currentRowPrintFields(fieldNo,fields);
-                fclose (inputCsvFd);
-                exit (0);
-            }   /* if (decodeHeader) */
-
-            if ( (chapterFieldNo>=1) && (chapterFieldNo<=fieldNo) && (strcmp(lastChapter,fields[chapterFieldNo-1])) )
-            {   /* if a valid chapterFieldNo was extracted before from inputMdChapterTemplate file  */
-                /* and in the current row this field changed with respect to the previous row, then */
-                /* add a new chapter formatted according to the inputMdChapterTemplate              */
-                appendCsvRow2Output (outputMdFd,inputMdChapterTemplate,placeHolder,fieldNo,fields);
-                strcpy (lastChapter,fields[chapterFieldNo-1]);
-            }
-            appendCsvRow2Output (outputMdFd, inputMdTemplate, placeHolder,fieldNo,fields);
-        }   /* if (multiLineOpen == false) */
+    /* Preliminary Checks - Check Command Layout & Parse Input Parameters */
+    if ( (argc==2) && (strcmp(argv[1],"-h")==0) )
+    {
+        /* Print complete help and exit */
+        printHelp();
+        exit (0);
+    }
 
-    }   /* while ( fgets(currentLine,MAXLINELEN,inputCsvFd) ) */
+    if (argc<3)
+    {
+        printUsage();
+        exit (-1);
+    }
+    initOptions (&opt);
+    parseOptions (argc,argv,&opt);
+    checkOptions (&opt);
 
-    /* Processing terminated    */
-    /* Close all files and exit */
-    fclose (inputCsvFd);
-    fclose (outputMdFd);
+    if (opt.manifestFile[0]!='\0')
+        runBatch (&opt);
+    else if (opt.serveSocket[0]!='\0')
+        runServer (&opt);
+    else
+        runConversion (&opt,NULL);
 
     exit (0);
 }